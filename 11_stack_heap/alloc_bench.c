@@ -0,0 +1,107 @@
+/*
+ * Allocation Benchmark
+ * Allocation-heavy load for measuring heap profiler overhead: each thread
+ * keeps a ring of live blocks and replaces one per operation (free + malloc
+ * of a random size), which is the worst case for an interposed allocator.
+ *
+ *   ./alloc_bench
+ *   LD_PRELOAD=./libheapprof.so ./alloc_bench
+ *
+ * Usage: alloc_bench [-t threads] [-n ops per thread] [-s max size] [-l live blocks]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    long ops;
+    size_t max_size;
+    int live;
+    unsigned seed;
+    uint64_t checksum;
+} bench_arg_t;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sizes skewed towards small blocks, like most services: uniform in
+// 1..2^bits with bits uniform in 4..11 (so at most 2 KB), capped at max_size
+static size_t pick_size(uint32_t *state, size_t max_size) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    int bits = 4 + *state % 8;
+    size_t size = 1 + ((*state >> 8) & ((1u << bits) - 1));
+    return size < max_size ? size : max_size;
+}
+
+static void *bench_thread(void *p) {
+    bench_arg_t *a = p;
+    char **ring = calloc(a->live, sizeof(char *));
+    uint32_t state = a->seed | 1;
+    uint64_t sum = 0;
+
+    for (long i = 0; i < a->ops; i++) {
+        int slot = i % a->live;
+        free(ring[slot]);
+        size_t size = pick_size(&state, a->max_size);
+        ring[slot] = malloc(size);
+        ring[slot][0] = (char)i;      // Touch it, as a real user would
+        sum += (uintptr_t)ring[slot] & 0xff;
+    }
+    for (int i = 0; i < a->live; i++) free(ring[i]);
+    free(ring);
+    a->checksum = sum;
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = 1, live = 1024, opt;
+    long ops = 10000000;
+    size_t max_size = 4096;
+
+    while ((opt = getopt(argc, argv, "t:n:s:l:h")) != -1) {
+        switch (opt) {
+        case 't': threads = atoi(optarg); break;
+        case 'n': ops = atol(optarg); break;
+        case 's': max_size = strtoul(optarg, NULL, 0); break;
+        case 'l': live = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-t threads] [-n ops per thread] [-s max size] [-l live blocks]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (threads < 1 || ops < 1 || live < 1 || max_size < 1) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    bench_arg_t *args = calloc(threads, sizeof(bench_arg_t));
+    double t0 = now_s();
+    for (int t = 0; t < threads; t++) {
+        args[t] = (bench_arg_t){ .ops = ops, .max_size = max_size, .live = live, .seed = 0x9e3779b9u * (t + 1) };
+        pthread_create(&tids[t], NULL, bench_thread, &args[t]);
+    }
+    uint64_t checksum = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        checksum += args[t].checksum;
+    }
+    double elapsed = now_s() - t0;
+
+    printf("%s: %d thread(s) x %ld ops, max %zu bytes: %.2f s, %.1f ns/op (checksum %llu)\n",
+           getenv("LD_PRELOAD") ? "preloaded" : "baseline", threads, ops, max_size, elapsed,
+           elapsed * 1e9 / ((double)ops * threads), (unsigned long long)(checksum & 0xffff));
+    free(tids);
+    free(args);
+    return 0;
+}
@@ -0,0 +1,689 @@
+/*
+ * Sampling Heap Profiler (LD_PRELOAD)
+ * Attributes heap usage of an unmodified process to allocation stacks,
+ * with a cost per malloc()/free() of a few instructions:
+ *
+ *   LD_PRELOAD=./libheapprof.so ./hello &
+ *   kill -USR2 $!        # writes heapprof.<pid>.<n>.heap and .txt
+ *
+ * - Sampling by bytes: each thread counts down a byte budget drawn from an
+ *   exponential distribution (mean HEAPPROF_RATE). Only the allocation that
+ *   exhausts it is recorded, so a 512 KB default samples ~2 allocations
+ *   per MB allocated regardless of their sizes, and each sample of s bytes
+ *   stands for s / (1 - exp(-s / rate)) bytes.
+ * - Stacks are walked through frame pointers: no unwinder, no allocation.
+ *   The walk stops at code built without them (glibc's strdup, for one),
+ *   so build the target with -fno-omit-frame-pointer for complete stacks.
+ * - Each thread aggregates into its own stack table (single writer, no
+ *   locks). An exiting thread hands its table, counts included, to the next
+ *   new thread, so there are never more tables than threads alive at once.
+ *   Sampled pointers go into one global lock-free table so that a free() on
+ *   any thread can retire them; a counter filter in front of it keeps the
+ *   free() fast path to a single load.
+ * - A dump (signal, timer or exit) is written by a background thread:
+ *   .heap is the gperftools/pprof heap_v2 text format (live and total
+ *   samples per stack, followed by /proc/self/maps), .txt is a readable
+ *   report of the top stacks by live bytes and by allocation rate since
+ *   the previous dump.
+ *
+ * Environment:
+ *   HEAPPROF_RATE      Mean sampling interval in bytes (default 524288; 1 = every allocation)
+ *   HEAPPROF_PREFIX    Output path prefix (default "heapprof")
+ *   HEAPPROF_SIGNAL    Signal number that triggers a dump (default SIGUSR2; 0 = none)
+ *   HEAPPROF_INTERVAL  Also dump every N seconds (default 0 = off)
+ *   HEAPPROF_AT_EXIT   Dump when the process exits (default 1)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define HP_DEFAULT_RATE 524288
+#define HP_MAX_DEPTH 32
+#define HP_BUCKETS 2048               // Stacks per thread, power of two
+#define HP_SAMPLE_SLOTS (1 << 17)     // Live sampled allocations, power of two
+#define HP_FILTER_BITS 20             // 4 MB of per-granule counters
+#define HP_TOP 20                     // Stacks listed per section of the report
+
+#define HP_SLOT_EMPTY 0
+#define HP_SLOT_DEAD 1
+#define HP_SLOT_BUSY 2
+
+// glibc's allocator entry points, so no dlsym() bootstrapping is needed
+extern void *__libc_malloc(size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+// Counters are raw samples (count, requested bytes) plus the unsampled
+// byte estimate; all updated with relaxed atomics
+typedef struct {
+    uint64_t hash;                    // 0 = empty; stored last
+    uint32_t depth;
+    uintptr_t pcs[HP_MAX_DEPTH];
+    uint64_t alloc_count;
+    uint64_t alloc_bytes;
+    uint64_t alloc_est;
+    uint64_t live_count;
+    uint64_t live_bytes;
+    uint64_t live_est;
+    uint64_t prev_alloc_est;          // Dumper only: alloc_est at the last dump
+} hp_bucket_t;
+
+typedef struct hp_table {
+    hp_bucket_t buckets[HP_BUCKETS];
+    struct hp_table *next;            // Global list, newest first
+    struct hp_table *free_next;       // Free list of tables left by exited threads
+    uint64_t dropped;                 // Samples lost to a full table
+} hp_table_t;
+
+typedef struct {
+    uintptr_t ptr;                    // HP_SLOT_* or the sampled address
+    hp_bucket_t *bucket;
+    uint64_t bytes;
+    uint64_t est;
+} hp_slot_t;
+
+typedef struct {
+    uint32_t depth;
+    uintptr_t pcs[HP_MAX_DEPTH];
+    uint64_t alloc_count, alloc_bytes, alloc_est, alloc_delta;
+    uint64_t live_count, live_bytes, live_est;
+} hp_record_t;
+
+static struct {
+    int64_t rate;                     // 0 until initialised
+    char prefix[256];
+    int signal;
+    int interval;
+    int at_exit;
+    int wake[2];                      // Signal handler -> dumper thread
+    hp_table_t *tables;
+    hp_table_t *free_tables;          // Under table_lock
+    pthread_mutex_t table_lock;
+    pthread_key_t table_key;          // Destructor returns the table to free_tables
+    int have_key;
+    hp_slot_t *slots;
+    uint32_t *filter;                 // Wide enough for every sample slot: never wraps
+    uint64_t slots_dropped;
+    pthread_mutex_t dump_lock;
+    double start_s, last_dump_s;
+    unsigned seq;
+} hp = { .dump_lock = PTHREAD_MUTEX_INITIALIZER, .table_lock = PTHREAD_MUTEX_INITIALIZER, .wake = { -1, -1 } };
+
+// Initial-exec TLS: one %fs-relative access on the malloc() fast path
+#define HP_TLS __thread __attribute__((tls_model("initial-exec")))
+static HP_TLS int64_t t_until;        // Bytes left before the next sample
+static HP_TLS int t_busy;             // Inside the profiler: allocations pass through
+static HP_TLS hp_table_t *t_table;
+static HP_TLS uintptr_t t_stack_lo, t_stack_hi;
+static HP_TLS uint64_t t_rng;
+
+static double hp_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline uint64_t hp_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// One counter per 256-byte granule (aliasing every 256 MB): frees of
+// neighbouring blocks hit the same cache line, unlike a hashed index
+static inline uint32_t *hp_filter_slot(const void *p) {
+    return &hp.filter[((uintptr_t)p >> 8) & ((1u << HP_FILTER_BITS) - 1)];
+}
+
+// Next byte budget: exponential with mean rate, so sampling is memoryless
+static int64_t hp_next_interval(void) {
+    if (hp.rate <= 1) return hp.rate;
+    if (t_rng == 0) t_rng = hp_mix((uintptr_t)&t_rng ^ (uint64_t)(hp_now() * 1e9)) | 1;
+    t_rng ^= t_rng << 13;
+    t_rng ^= t_rng >> 7;
+    t_rng ^= t_rng << 17;
+    double u = ((t_rng >> 11) + 1) * (1.0 / 9007199254740992.0);   // (0, 1]
+    int64_t n = (int64_t)(-log(u) * hp.rate);
+    return n > 0 ? n : 1;
+}
+
+// ============================================================================
+// Sampling
+// ============================================================================
+
+static hp_table_t *hp_thread_init(void) {
+    pthread_attr_t attr;
+    void *lo;
+    size_t size;
+
+    // Reuse a table left by an exited thread. Its buckets stay where they
+    // are: sampled pointers that are still live refer to them
+    pthread_mutex_lock(&hp.table_lock);
+    hp_table_t *t = hp.free_tables;
+    if (t) hp.free_tables = t->free_next;
+    pthread_mutex_unlock(&hp.table_lock);
+    if (!t) {
+        t = mmap(NULL, sizeof(hp_table_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (t == MAP_FAILED) return NULL;
+        t->next = __atomic_load_n(&hp.tables, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&hp.tables, &t->next, t, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+    if (hp.have_key) pthread_setspecific(hp.table_key, t);
+    // Bounds for the frame-pointer walk (pthread_getattr_np may allocate,
+    // t_busy lets that through)
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        if (pthread_attr_getstack(&attr, &lo, &size) == 0) {
+            t_stack_lo = (uintptr_t)lo;
+            t_stack_hi = (uintptr_t)lo + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return t;
+}
+
+// Thread exit (key destructor): give the table to the next new thread. Any
+// allocation this thread still makes passes through unsampled
+static void hp_thread_exit(void *arg) {
+    hp_table_t *t = arg;
+
+    t_busy++;
+    t_table = NULL;
+    pthread_mutex_lock(&hp.table_lock);
+    t->free_next = hp.free_tables;
+    hp.free_tables = t;
+    pthread_mutex_unlock(&hp.table_lock);
+}
+
+// Return addresses of the callers of malloc() & co., innermost first
+static __attribute__((noinline)) int hp_backtrace(uintptr_t *pcs, int max) {
+    uintptr_t *fp = __builtin_frame_address(0);
+    int n = 0, skip = 2;              // hp_backtrace <- hp_sample <- hook
+
+    while (n < max && (uintptr_t)fp >= t_stack_lo && (uintptr_t)(fp + 2) <= t_stack_hi &&
+           ((uintptr_t)fp & 7) == 0) {
+        uintptr_t ret = fp[1];
+        uintptr_t *next = (uintptr_t *)fp[0];
+        if (ret == 0) break;
+        if (skip > 0) {
+            skip--;
+        } else {
+            pcs[n++] = ret;
+        }
+        if (next <= fp) break;        // Stacks grow down: callers are above
+        fp = next;
+    }
+    return n;
+}
+
+static hp_bucket_t *hp_bucket(hp_table_t *t, const uintptr_t *pcs, int depth) {
+    uint64_t h = 0x84222325cbf29ce4ULL ^ depth;
+    for (int i = 0; i < depth; i++) h = hp_mix(h ^ pcs[i]);
+    if (h == 0) h = 1;
+
+    for (uint32_t i = h & (HP_BUCKETS - 1), n = 0; n < HP_BUCKETS; n++, i = (i + 1) & (HP_BUCKETS - 1)) {
+        hp_bucket_t *b = &t->buckets[i];
+        uint64_t bh = __atomic_load_n(&b->hash, __ATOMIC_ACQUIRE);
+        if (bh == 0) {
+            // Only this thread inserts: fill, then publish the hash
+            b->depth = depth;
+            memcpy(b->pcs, pcs, depth * sizeof(uintptr_t));
+            __atomic_store_n(&b->hash, h, __ATOMIC_RELEASE);
+            return b;
+        }
+        if (bh == h && b->depth == (uint32_t)depth && memcmp(b->pcs, pcs, depth * sizeof(uintptr_t)) == 0) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+static void hp_track(void *p, hp_bucket_t *b, uint64_t bytes, uint64_t est) {
+    uint64_t mask = HP_SAMPLE_SLOTS - 1;
+    for (uint64_t i = hp_mix((uintptr_t)p) & mask, n = 0; n < HP_SAMPLE_SLOTS; n++, i = (i + 1) & mask) {
+        hp_slot_t *s = &hp.slots[i];
+        uintptr_t cur = __atomic_load_n(&s->ptr, __ATOMIC_RELAXED);
+        if ((cur == HP_SLOT_EMPTY || cur == HP_SLOT_DEAD) &&
+            __atomic_compare_exchange_n(&s->ptr, &cur, HP_SLOT_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            s->bucket = b;
+            s->bytes = bytes;
+            s->est = est;
+            __atomic_fetch_add(hp_filter_slot(p), 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&s->ptr, (uintptr_t)p, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+    __atomic_fetch_add(&hp.slots_dropped, 1, __ATOMIC_RELAXED);
+}
+
+static __attribute__((noinline)) void hp_sample(void *p, size_t size) {
+    uintptr_t pcs[HP_MAX_DEPTH];
+
+    if (hp.rate == 0 || t_busy) {
+        t_until = hp.rate ? hp_next_interval() : INT64_MAX;
+        return;
+    }
+    t_busy = 1;
+    t_until = hp_next_interval();
+    if (!t_table) {
+        t_table = hp_thread_init();
+        // A new thread starts with no budget: draw one instead of always
+        // sampling its first allocation
+        if (hp.rate > 1) {
+            t_busy = 0;
+            return;
+        }
+    }
+    if (t_table) {
+        int depth = hp_backtrace(pcs, HP_MAX_DEPTH);
+        hp_bucket_t *b = hp_bucket(t_table, pcs, depth);
+        if (b) {
+            double w = hp.rate <= 1 ? 1.0 : 1.0 / -expm1(-(double)size / hp.rate);
+            uint64_t est = (uint64_t)(size * w + 0.5);
+            __atomic_fetch_add(&b->alloc_count, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&b->alloc_bytes, size, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&b->alloc_est, est, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&b->live_count, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&b->live_bytes, size, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&b->live_est, est, __ATOMIC_RELAXED);
+            hp_track(p, b, size, est);
+        } else {
+            t_table->dropped++;
+        }
+    }
+    t_busy = 0;
+}
+
+// p is about to be freed: retire it if it was sampled
+static __attribute__((noinline)) void hp_untrack(void *p) {
+    uint64_t mask = HP_SAMPLE_SLOTS - 1;
+    for (uint64_t i = hp_mix((uintptr_t)p) & mask, n = 0; n < HP_SAMPLE_SLOTS; n++, i = (i + 1) & mask) {
+        hp_slot_t *s = &hp.slots[i];
+        uintptr_t cur = __atomic_load_n(&s->ptr, __ATOMIC_ACQUIRE);
+        if (cur == HP_SLOT_EMPTY) return;
+        if (cur == (uintptr_t)p &&
+            __atomic_compare_exchange_n(&s->ptr, &cur, HP_SLOT_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            hp_bucket_t *b = s->bucket;
+            __atomic_fetch_sub(&b->live_count, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_sub(&b->live_bytes, s->bytes, __ATOMIC_RELAXED);
+            __atomic_fetch_sub(&b->live_est, s->est, __ATOMIC_RELAXED);
+            __atomic_fetch_sub(hp_filter_slot(p), 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&s->ptr, HP_SLOT_DEAD, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+}
+
+static inline void hp_on_alloc(void *p, size_t size) {
+    if (__builtin_expect((t_until -= (int64_t)size) > 0, 1) || !p) return;
+    hp_sample(p, size);
+}
+
+static inline void hp_on_free(void *p) {
+    // Before the block is released: afterwards another thread could get the
+    // same address back and have it sampled
+    if (p && hp.filter && __builtin_expect(*hp_filter_slot(p) != 0, 0)) hp_untrack(p);
+}
+
+// ============================================================================
+// Interposed allocator
+// ============================================================================
+
+void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    hp_on_alloc(p, size);
+    return p;
+}
+
+void free(void *ptr) {
+    hp_on_free(ptr);
+    __libc_free(ptr);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    void *p = __libc_calloc(nmemb, size);
+    hp_on_alloc(p, nmemb * size);     // No overflow when p != NULL
+    return p;
+}
+
+void *realloc(void *ptr, size_t size) {
+    // The old block is retired first; a failed realloc() under-counts it
+    hp_on_free(ptr);
+    void *p = __libc_realloc(ptr, size);
+    hp_on_alloc(p, size);
+    return p;
+}
+
+void *memalign(size_t alignment, size_t size) {
+    void *p = __libc_memalign(alignment, size);
+    hp_on_alloc(p, size);
+    return p;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0) {
+        return EINVAL;
+    }
+    void *p = __libc_memalign(alignment, size);
+    if (!p) return ENOMEM;
+    hp_on_alloc(p, size);
+    *memptr = p;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    void *p = __libc_valloc(size);
+    hp_on_alloc(p, size);
+    return p;
+}
+
+void *pvalloc(size_t size) {
+    void *p = __libc_pvalloc(size);
+    hp_on_alloc(p, size);
+    return p;
+}
+
+// ============================================================================
+// Dumps
+// ============================================================================
+
+typedef struct {
+    int fd;
+    size_t len;
+    char buf[16384];
+} hp_out_t;
+
+static void hp_flush(hp_out_t *o) {
+    for (size_t off = 0; off < o->len;) {
+        ssize_t n = write(o->fd, o->buf + off, o->len - off);
+        if (n <= 0 && errno != EINTR) break;
+        if (n > 0) off += n;
+    }
+    o->len = 0;
+}
+
+static __attribute__((format(printf, 2, 3))) void hp_printf(hp_out_t *o, const char *fmt, ...) {
+    va_list ap;
+    if (o->len > sizeof(o->buf) - 1024) hp_flush(o);
+    va_start(ap, fmt);
+    int n = vsnprintf(o->buf + o->len, sizeof(o->buf) - o->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) o->len += (size_t)n < sizeof(o->buf) - o->len ? (size_t)n : sizeof(o->buf) - o->len - 1;
+}
+
+static int hp_cmp_stack(const void *a, const void *b) {
+    const hp_record_t *x = a, *y = b;
+    if (x->depth != y->depth) return x->depth < y->depth ? -1 : 1;
+    return memcmp(x->pcs, y->pcs, x->depth * sizeof(uintptr_t));
+}
+
+static int hp_cmp_live(const void *a, const void *b) {
+    const hp_record_t *x = a, *y = b;
+    return x->live_est < y->live_est ? 1 : x->live_est > y->live_est ? -1 : 0;
+}
+
+static int hp_cmp_rate(const void *a, const void *b) {
+    const hp_record_t *x = a, *y = b;
+    return x->alloc_delta < y->alloc_delta ? 1 : x->alloc_delta > y->alloc_delta ? -1 : 0;
+}
+
+// Snapshot every thread's buckets, merged by stack
+static hp_record_t *hp_collect(size_t *count) {
+    size_t n = 0, cap = 0;
+    for (hp_table_t *t = __atomic_load_n(&hp.tables, __ATOMIC_ACQUIRE); t; t = t->next) cap += HP_BUCKETS;
+    hp_record_t *recs = malloc((cap ? cap : 1) * sizeof(hp_record_t));
+    if (!recs) return NULL;
+
+    for (hp_table_t *t = __atomic_load_n(&hp.tables, __ATOMIC_ACQUIRE); t && n < cap; t = t->next) {
+        for (int i = 0; i < HP_BUCKETS && n < cap; i++) {
+            hp_bucket_t *b = &t->buckets[i];
+            if (__atomic_load_n(&b->hash, __ATOMIC_ACQUIRE) == 0) continue;
+            hp_record_t *r = &recs[n++];
+            r->depth = b->depth;
+            memcpy(r->pcs, b->pcs, sizeof(r->pcs));
+            r->alloc_count = __atomic_load_n(&b->alloc_count, __ATOMIC_RELAXED);
+            r->alloc_bytes = __atomic_load_n(&b->alloc_bytes, __ATOMIC_RELAXED);
+            r->alloc_est = __atomic_load_n(&b->alloc_est, __ATOMIC_RELAXED);
+            r->live_count = __atomic_load_n(&b->live_count, __ATOMIC_RELAXED);
+            r->live_bytes = __atomic_load_n(&b->live_bytes, __ATOMIC_RELAXED);
+            r->live_est = __atomic_load_n(&b->live_est, __ATOMIC_RELAXED);
+            r->alloc_delta = r->alloc_est - b->prev_alloc_est;
+            b->prev_alloc_est = r->alloc_est;
+        }
+    }
+
+    qsort(recs, n, sizeof(hp_record_t), hp_cmp_stack);
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (m > 0 && hp_cmp_stack(&recs[m - 1], &recs[i]) == 0) {
+            hp_record_t *d = &recs[m - 1];
+            d->alloc_count += recs[i].alloc_count;
+            d->alloc_bytes += recs[i].alloc_bytes;
+            d->alloc_est += recs[i].alloc_est;
+            d->alloc_delta += recs[i].alloc_delta;
+            d->live_count += recs[i].live_count;
+            d->live_bytes += recs[i].live_bytes;
+            d->live_est += recs[i].live_est;
+        } else {
+            recs[m++] = recs[i];
+        }
+    }
+    *count = m;
+    return recs;
+}
+
+static void hp_symbol(hp_out_t *o, uintptr_t pc) {
+    Dl_info info;
+    // pc - 1: the call instruction, not the one after it
+    if (dladdr((void *)(pc - 1), &info) && info.dli_sname) {
+        hp_printf(o, "%s+0x%lx", info.dli_sname, (unsigned long)(pc - (uintptr_t)info.dli_saddr));
+    } else if (info.dli_fname) {
+        const char *base = strrchr(info.dli_fname, '/');
+        hp_printf(o, "%s+0x%lx", base ? base + 1 : info.dli_fname, (unsigned long)(pc - (uintptr_t)info.dli_fbase));
+    } else {
+        hp_printf(o, "0x%lx", (unsigned long)pc);
+    }
+}
+
+static void hp_write_stack(hp_out_t *o, const hp_record_t *r) {
+    if (r->depth == 0) hp_printf(o, "(no frame pointers)");
+    for (uint32_t i = 0; i < r->depth && i < 8; i++) {
+        if (i) hp_printf(o, " <- ");
+        hp_symbol(o, r->pcs[i]);
+    }
+    hp_printf(o, "\n");
+}
+
+static void hp_dump(const char *reason) {
+    char path[512];
+    size_t n = 0;
+    hp_out_t *o;
+
+    if (hp.rate == 0) return;
+    pthread_mutex_lock(&hp.dump_lock);
+    t_busy++;                         // Own allocations are not sampled
+    o = malloc(sizeof(hp_out_t));
+    hp_record_t *recs = o ? hp_collect(&n) : NULL;
+    if (!recs) goto out;
+
+    double now = hp_now(), since = now - hp.last_dump_s;
+    unsigned seq = hp.seq++;
+    hp.last_dump_s = now;
+    uint64_t live_count = 0, live_bytes = 0, live_est = 0, alloc_count = 0, alloc_bytes = 0, delta = 0;
+    uint64_t dropped = __atomic_load_n(&hp.slots_dropped, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < n; i++) {
+        live_count += recs[i].live_count;
+        live_bytes += recs[i].live_bytes;
+        live_est += recs[i].live_est;
+        alloc_count += recs[i].alloc_count;
+        alloc_bytes += recs[i].alloc_bytes;
+        delta += recs[i].alloc_delta;
+    }
+    for (hp_table_t *t = __atomic_load_n(&hp.tables, __ATOMIC_ACQUIRE); t; t = t->next) dropped += t->dropped;
+
+    // pprof heap_v2: raw sample counts, pprof applies the unsampling
+    snprintf(path, sizeof(path), "%s.%d.%u.heap", hp.prefix, (int)getpid(), seq);
+    o->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    o->len = 0;
+    if (o->fd >= 0) {
+        hp_printf(o, "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%lld\n", (unsigned long long)live_count,
+                  (unsigned long long)live_bytes, (unsigned long long)alloc_count, (unsigned long long)alloc_bytes,
+                  (long long)hp.rate);
+        for (size_t i = 0; i < n; i++) {
+            const hp_record_t *r = &recs[i];
+            hp_printf(o, "%llu: %llu [%llu: %llu] @", (unsigned long long)r->live_count,
+                      (unsigned long long)r->live_bytes, (unsigned long long)r->alloc_count,
+                      (unsigned long long)r->alloc_bytes);
+            for (uint32_t k = 0; k < r->depth; k++) hp_printf(o, " 0x%lx", (unsigned long)r->pcs[k]);
+            hp_printf(o, "\n");
+        }
+        hp_printf(o, "\nMAPPED_LIBRARIES:\n");
+        hp_flush(o);
+        int maps = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+        ssize_t got;
+        while (maps >= 0 && (got = read(maps, o->buf, sizeof(o->buf))) > 0) {
+            o->len = got;
+            hp_flush(o);
+        }
+        if (maps >= 0) close(maps);
+        close(o->fd);
+    }
+
+    snprintf(path, sizeof(path), "%s.%d.%u.txt", hp.prefix, (int)getpid(), seq);
+    o->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    o->len = 0;
+    if (o->fd >= 0) {
+        hp_printf(o, "heapprof dump %u (%s), pid %d, %.1f s after start, %.1f s since the previous dump\n", seq,
+                  reason, (int)getpid(), now - hp.start_s, since);
+        hp_printf(o, "Sampling every %lld bytes on average: %llu samples, %llu dropped, %zu stacks\n",
+                  (long long)hp.rate, (unsigned long long)alloc_count, (unsigned long long)dropped, n);
+        hp_printf(o, "Live heap (est.): %.3f MB in %llu sampled objects\n", live_est / 1e6,
+                  (unsigned long long)live_count);
+        hp_printf(o, "Allocation rate (est.): %.2f MB/s since the previous dump\n\n",
+                  since > 0 ? delta / 1e6 / since : 0.0);
+
+        qsort(recs, n, sizeof(hp_record_t), hp_cmp_live);
+        hp_printf(o, "Top live stacks:\n%10s %8s  %s\n", "live MB", "samples", "stack");
+        for (size_t i = 0; i < n && i < HP_TOP && recs[i].live_est; i++) {
+            hp_printf(o, "%10.3f %8llu  ", recs[i].live_est / 1e6, (unsigned long long)recs[i].live_count);
+            hp_write_stack(o, &recs[i]);
+        }
+        qsort(recs, n, sizeof(hp_record_t), hp_cmp_rate);
+        hp_printf(o, "\nTop allocating stacks since the previous dump:\n%10s %8s  %s\n", "MB/s", "total MB",
+                  "stack");
+        for (size_t i = 0; i < n && i < HP_TOP && recs[i].alloc_delta; i++) {
+            hp_printf(o, "%10.3f %8.1f  ", since > 0 ? recs[i].alloc_delta / 1e6 / since : 0.0,
+                      recs[i].alloc_est / 1e6);
+            hp_write_stack(o, &recs[i]);
+        }
+        hp_flush(o);
+        close(o->fd);
+    }
+
+out:
+    free(recs);
+    free(o);
+    t_busy--;
+    pthread_mutex_unlock(&hp.dump_lock);
+}
+
+static void hp_on_signal(int sig) {
+    int saved = errno;
+    char c = (char)sig;
+    if (write(hp.wake[1], &c, 1) < 0) {
+        // Pipe full: a dump is already pending
+    }
+    errno = saved;
+}
+
+static void *hp_dumper(void *arg) {
+    (void)arg;
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    struct pollfd pfd = { .fd = hp.wake[0], .events = POLLIN };
+    for (;;) {
+        int r = poll(&pfd, 1, hp.interval > 0 ? hp.interval * 1000 : -1);
+        if (r < 0 && errno != EINTR) break;
+        if (r > 0) {
+            char buf[64];
+            if (read(hp.wake[0], buf, sizeof(buf)) <= 0) break;
+            hp_dump("signal");
+        } else if (r == 0) {
+            hp_dump("interval");
+        }
+    }
+    return NULL;
+}
+
+static long hp_env(const char *name, long fallback) {
+    const char *v = getenv(name);
+    return v && *v ? strtol(v, NULL, 0) : fallback;
+}
+
+__attribute__((constructor)) static void hp_init(void) {
+    const char *prefix = getenv("HEAPPROF_PREFIX");
+    long rate = hp_env("HEAPPROF_RATE", HP_DEFAULT_RATE);
+
+    t_busy++;
+    hp.signal = (int)hp_env("HEAPPROF_SIGNAL", SIGUSR2);
+    hp.interval = (int)hp_env("HEAPPROF_INTERVAL", 0);
+    hp.at_exit = (int)hp_env("HEAPPROF_AT_EXIT", 1);
+    snprintf(hp.prefix, sizeof(hp.prefix), "%s", prefix && *prefix ? prefix : "heapprof");
+    hp.slots = mmap(NULL, HP_SAMPLE_SLOTS * sizeof(hp_slot_t), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    hp.filter = mmap(NULL, sizeof(uint32_t) << HP_FILTER_BITS, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (rate < 1 || hp.slots == MAP_FAILED || hp.filter == MAP_FAILED) {
+        hp.filter = NULL;
+        t_busy--;
+        return;                       // Profiling off: hooks just forward
+    }
+    hp.start_s = hp.last_dump_s = hp_now();
+    hp.have_key = pthread_key_create(&hp.table_key, hp_thread_exit) == 0;
+
+    if ((hp.signal > 0 || hp.interval > 0) && pipe2(hp.wake, O_CLOEXEC | O_NONBLOCK) == 0) {
+        pthread_t tid;
+        if (hp.signal > 0) {
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = hp_on_signal;
+            sa.sa_flags = SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            sigaction(hp.signal, &sa, NULL);
+        }
+        // The dumper blocks in poll(): make its end of the pipe blocking
+        fcntl(hp.wake[0], F_SETFL, 0);
+        if (pthread_create(&tid, NULL, hp_dumper, NULL) == 0) pthread_detach(tid);
+    }
+    __atomic_store_n(&hp.rate, rate, __ATOMIC_RELEASE);
+    t_until = hp_next_interval();
+    t_busy--;
+}
+
+__attribute__((destructor)) static void hp_fini(void) {
+    if (hp.at_exit) hp_dump("exit");
+}
@@ -0,0 +1,630 @@
+/*
+ * Native Process Memory Scanner
+ * Searches the memory of a running process for one or more byte strings
+ * and optionally patches the first match in place, like analyse.py, but
+ * without pulling the whole heap into one buffer.
+ *
+ * - Mappings come from /proc/<pid>/maps: [heap] by default, or any mix of
+ *   heap, stack, anon (private writable anonymous memory), all (every
+ *   readable mapping) and path substrings (e.g. libc).
+ * - Each mapping is cut into fixed-size windows that overlap by the
+ *   longest pattern minus one byte, and the windows are shared out to
+ *   worker threads. Each thread reads its window with process_vm_readv()
+ *   into a private buffer, so memory use is threads x window whatever the
+ *   size of the target.
+ * - All patterns are matched in a single pass over each window. For every
+ *   32-byte block (16 without AVX2) the first and last byte of each pattern
+ *   are compared at once, and only the positions where both match are
+ *   checked with memcmp().
+ * - A match belongs to the window in which it starts, so matches in the
+ *   overlap are not reported twice.
+ *
+ * Patching keeps analyse.py's semantics: one pattern, the match at the
+ * lowest address is overwritten with the replacement, which may not be
+ * longer than the pattern and is padded with NUL bytes. -a patches every
+ * match instead. Writes go through /proc/<pid>/mem, which works on
+ * read-only mappings too.
+ *
+ * Usage: heap_scan [-p pid | -n name] [-m maps] [-j threads] [-w KB]
+ *                  [-l limit] [-x] [-S] [-r replace [-a]] pattern ...
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HS_HAVE_SIMD 1
+#else
+#define HS_HAVE_SIMD 0
+#endif
+
+#define MAX_PATTERNS 16
+#define MAX_PATTERN_LEN 256
+#define MAX_THREADS 64
+#define MAX_MAP_SPECS 16
+
+typedef struct {
+    uint8_t bytes[MAX_PATTERN_LEN];
+    size_t len;
+    const char *text;           // As given on the command line
+} pattern_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    char name[256];
+} mapping_t;
+
+typedef struct {
+    uint64_t addr;
+    int pattern;
+    int mapping;
+} match_t;
+
+typedef struct {
+    int mapping;
+    uint64_t start;             // Matches must start in [start, end)
+    uint64_t end;
+} window_t;
+
+typedef struct scanner scanner_t;
+
+typedef struct {
+    scanner_t *s;
+    uint8_t *buf;
+    uint64_t counts[MAX_PATTERNS];
+    uint64_t first[MAX_PATTERNS];   // Lowest matching address, UINT64_MAX if none
+    uint64_t bytes;
+    uint64_t faults;                // Pages that could not be read
+    uint64_t patched;
+    match_t *matches;
+    size_t nmatches;
+    size_t cap;
+} worker_t;
+
+struct scanner {
+    pid_t pid;
+    int mem_fd;                     // /proc/<pid>/mem, patch mode only
+    pattern_t patterns[MAX_PATTERNS];
+    int npatterns;
+    size_t max_len;
+    const uint8_t *replace;         // patterns[0].len bytes, NUL-padded
+    int patch_all;
+    mapping_t *maps;
+    int nmaps;
+    window_t *windows;
+    size_t nwindows;
+    size_t next;                    // Work queue head (atomic)
+    size_t window;                  // Bytes per window, without overlap
+    size_t limit;                   // Matches to list
+    size_t listed;                  // Matches kept for listing (atomic)
+    int gone;                       // Target exited during the scan
+    size_t page;
+};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// ============================================================================
+// Target and mappings
+// ============================================================================
+
+// Same lookup as analyse.py: first process whose comm equals name
+static pid_t find_pid_by_name(const char *name) {
+    DIR *dir = opendir("/proc");
+    struct dirent *de;
+    pid_t found = -1;
+
+    if (!dir) return -1;
+    while (found < 0 && (de = readdir(dir)) != NULL) {
+        char path[300], comm[64];
+        if (de->d_name[0] < '0' || de->d_name[0] > '9') continue;
+        snprintf(path, sizeof(path), "/proc/%s/comm", de->d_name);
+        FILE *fp = fopen(path, "r");
+        if (!fp) continue;
+        if (fgets(comm, sizeof(comm), fp)) {
+            comm[strcspn(comm, "\n")] = '\0';
+            if (strcmp(comm, name) == 0) found = atoi(de->d_name);
+        }
+        fclose(fp);
+    }
+    closedir(dir);
+    return found;
+}
+
+static int map_selected(const char *spec, const char *perms, const char *name) {
+    if (strcmp(spec, "all") == 0) return 1;
+    if (strcmp(spec, "heap") == 0) return strcmp(name, "[heap]") == 0;
+    if (strcmp(spec, "stack") == 0) return strncmp(name, "[stack", 6) == 0;
+    if (strcmp(spec, "anon") == 0) {
+        return perms[1] == 'w' && perms[3] == 'p' &&
+               (name[0] == '\0' || strcmp(name, "[heap]") == 0 || strncmp(name, "[stack", 6) == 0);
+    }
+    return strstr(name, spec) != NULL;
+}
+
+// Readable mappings of pid matching any of specs. Returns the count, or -1.
+static int load_mappings(pid_t pid, char **specs, int nspecs, mapping_t **out) {
+    char path[64], line[512];
+    mapping_t *maps = NULL;
+    int n = 0, cap = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long long start, end;
+        char perms[8], name[256] = "";
+        if (sscanf(line, "%llx-%llx %7s %*s %*s %*s %255[^\n]", &start, &end, perms, name) < 3) continue;
+        // vvar/vsyscall cannot be read through process_vm_readv
+        if (perms[0] != 'r' || strcmp(name, "[vvar]") == 0 || strcmp(name, "[vsyscall]") == 0) continue;
+        int selected = 0;
+        for (int i = 0; i < nspecs && !selected; i++) selected = map_selected(specs[i], perms, name);
+        if (!selected) continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            mapping_t *grown = realloc(maps, cap * sizeof(mapping_t));
+            if (!grown) {
+                free(maps);
+                fclose(fp);
+                return -1;
+            }
+            maps = grown;
+        }
+        maps[n].start = start;
+        maps[n].end = end;
+        snprintf(maps[n].name, sizeof(maps[n].name), "%s", name[0] ? name : "[anon]");
+        n++;
+    }
+    fclose(fp);
+    *out = maps;
+    return n;
+}
+
+static int build_windows(scanner_t *s) {
+    size_t n = 0;
+    for (int m = 0; m < s->nmaps; m++) {
+        n += (s->maps[m].end - s->maps[m].start + s->window - 1) / s->window;
+    }
+    s->windows = malloc((n ? n : 1) * sizeof(window_t));
+    if (!s->windows) return -1;
+    for (int m = 0; m < s->nmaps; m++) {
+        for (uint64_t a = s->maps[m].start; a < s->maps[m].end; a += s->window) {
+            window_t *w = &s->windows[s->nwindows++];
+            w->mapping = m;
+            w->start = a;
+            w->end = a + s->window < s->maps[m].end ? a + s->window : s->maps[m].end;
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// Matching
+// ============================================================================
+
+static void record_match(worker_t *w, int p, uint64_t addr, int mapping) {
+    scanner_t *s = w->s;
+
+    w->counts[p]++;
+    if (addr < w->first[p]) w->first[p] = addr;
+    if (s->replace && s->patch_all) {
+        if (pwrite(s->mem_fd, s->replace, s->patterns[0].len, addr) == (ssize_t)s->patterns[0].len) w->patched++;
+    }
+    if (__atomic_fetch_add(&s->listed, 1, __ATOMIC_RELAXED) >= s->limit) return;
+    if (w->nmatches == w->cap) {
+        size_t ncap = w->cap ? w->cap * 2 : 64;
+        match_t *grown = realloc(w->matches, ncap * sizeof(match_t));
+        if (!grown) return;
+        w->matches = grown;
+        w->cap = ncap;
+    }
+    w->matches[w->nmatches++] = (match_t){ .addr = addr, .pattern = p, .mapping = mapping };
+}
+
+// Check every pattern at data[i], for i with base + i < limit
+static inline void check_at(worker_t *w, const uint8_t *data, size_t n, size_t i, uint64_t base, int mapping) {
+    const scanner_t *s = w->s;
+    for (int p = 0; p < s->npatterns; p++) {
+        const pattern_t *pat = &s->patterns[p];
+        if (i + pat->len <= n && data[i] == pat->bytes[0] && memcmp(data + i, pat->bytes, pat->len) == 0) {
+            record_match(w, p, base + i, mapping);
+        }
+    }
+}
+
+static void scan_scalar(worker_t *w, const uint8_t *data, size_t n, size_t from, size_t to, uint64_t base,
+                        int mapping) {
+    for (size_t i = from; i < to; i++) check_at(w, data, n, i, base, mapping);
+}
+
+#if HS_HAVE_SIMD
+// Candidates are positions where some pattern's first and last byte both
+// match; one compare pair per pattern per 32 bytes
+__attribute__((target("avx2")))
+static size_t scan_avx2(worker_t *w, const uint8_t *data, size_t n, size_t to, uint64_t base, int mapping) {
+    const scanner_t *s = w->s;
+    __m256i first[MAX_PATTERNS], last[MAX_PATTERNS];
+    size_t i = 0;
+
+    for (int p = 0; p < s->npatterns; p++) {
+        first[p] = _mm256_set1_epi8((char)s->patterns[p].bytes[0]);
+        last[p] = _mm256_set1_epi8((char)s->patterns[p].bytes[s->patterns[p].len - 1]);
+    }
+    // Loads at i + len - 1 stay inside data while i + 32 + max_len - 1 <= n
+    for (; i + 32 + s->max_len - 1 <= n && i < to; i += 32) {
+        __m256i blk = _mm256_loadu_si256((const __m256i *)(data + i));
+        uint32_t any = 0;
+        for (int p = 0; p < s->npatterns; p++) {
+            __m256i end = _mm256_loadu_si256((const __m256i *)(data + i + s->patterns[p].len - 1));
+            __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(blk, first[p]), _mm256_cmpeq_epi8(end, last[p]));
+            any |= (uint32_t)_mm256_movemask_epi8(hit);
+        }
+        while (any) {
+            size_t j = i + __builtin_ctz(any);
+            any &= any - 1;
+            if (j < to) check_at(w, data, n, j, base, mapping);
+        }
+    }
+    return i;
+}
+
+static size_t scan_sse2(worker_t *w, const uint8_t *data, size_t n, size_t to, uint64_t base, int mapping) {
+    const scanner_t *s = w->s;
+    __m128i first[MAX_PATTERNS], last[MAX_PATTERNS];
+    size_t i = 0;
+
+    for (int p = 0; p < s->npatterns; p++) {
+        first[p] = _mm_set1_epi8((char)s->patterns[p].bytes[0]);
+        last[p] = _mm_set1_epi8((char)s->patterns[p].bytes[s->patterns[p].len - 1]);
+    }
+    for (; i + 16 + s->max_len - 1 <= n && i < to; i += 16) {
+        __m128i blk = _mm_loadu_si128((const __m128i *)(data + i));
+        uint32_t any = 0;
+        for (int p = 0; p < s->npatterns; p++) {
+            __m128i end = _mm_loadu_si128((const __m128i *)(data + i + s->patterns[p].len - 1));
+            any |= (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blk, first[p]),
+                                                             _mm_cmpeq_epi8(end, last[p])));
+        }
+        while (any) {
+            size_t j = i + __builtin_ctz(any);
+            any &= any - 1;
+            if (j < to) check_at(w, data, n, j, base, mapping);
+        }
+    }
+    return i;
+}
+
+static int have_avx2(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2");
+    }
+    return cached;
+}
+#endif
+
+// Report matches starting at data[0 .. to) (to <= n; bytes past `to` are
+// the overlap and only complete matches that start before it)
+static void scan_buffer(worker_t *w, const uint8_t *data, size_t n, size_t to, uint64_t base, int mapping) {
+    size_t done = 0;
+#if HS_HAVE_SIMD
+    done = have_avx2() ? scan_avx2(w, data, n, to, base, mapping) : scan_sse2(w, data, n, to, base, mapping);
+#endif
+    scan_scalar(w, data, n, done, to, base, mapping);
+}
+
+// ============================================================================
+// Workers
+// ============================================================================
+
+static ssize_t read_remote(pid_t pid, uint64_t addr, void *buf, size_t len) {
+    struct iovec local = { .iov_base = buf, .iov_len = len };
+    struct iovec remote = { .iov_base = (void *)(uintptr_t)addr, .iov_len = len };
+    return process_vm_readv(pid, &local, 1, &remote, 1, 0);
+}
+
+// Read [start, end) and scan it, reporting matches that start before limit.
+// A region that cannot be read in one go (unpopulated or protected pages)
+// is read page by page and scanned as separate readable runs.
+static void scan_range(worker_t *w, int mapping, uint64_t start, uint64_t end, uint64_t limit) {
+    scanner_t *s = w->s;
+    size_t len = end - start;
+    ssize_t got = read_remote(s->pid, start, w->buf, len);
+
+    if (got == (ssize_t)len) {
+        w->bytes += len;
+        scan_buffer(w, w->buf, len, limit - start, start, mapping);
+        return;
+    }
+    if (got < 0 && errno == ESRCH) {
+        __atomic_store_n(&s->gone, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    size_t run = 0;                 // Start of the current readable run
+    for (size_t off = 0; off < len;) {
+        size_t chunk = s->page - (start + off) % s->page;
+        if (chunk > len - off) chunk = len - off;
+        if (read_remote(s->pid, start + off, w->buf + off, chunk) == (ssize_t)chunk) {
+            w->bytes += chunk;
+            off += chunk;
+            continue;
+        }
+        if (off > run && start + run < limit) {
+            uint64_t stop = limit < start + off ? limit : start + off;
+            scan_buffer(w, w->buf + run, off - run, stop - start - run, start + run, mapping);
+        }
+        w->faults++;
+        off += chunk;
+        run = off;
+    }
+    if (len > run && start + run < limit) {
+        scan_buffer(w, w->buf + run, len - run, limit - start - run, start + run, mapping);
+    }
+}
+
+static void *scan_worker(void *arg) {
+    worker_t *w = arg;
+    scanner_t *s = w->s;
+
+    for (;;) {
+        size_t i = __atomic_fetch_add(&s->next, 1, __ATOMIC_RELAXED);
+        if (i >= s->nwindows || __atomic_load_n(&s->gone, __ATOMIC_RELAXED)) break;
+        const window_t *win = &s->windows[i];
+        uint64_t map_end = s->maps[win->mapping].end;
+        uint64_t end = win->end + s->max_len - 1 < map_end ? win->end + s->max_len - 1 : map_end;
+        scan_range(w, win->mapping, win->start, end, win->end);
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static int parse_hex(pattern_t *p, const char *hex) {
+    size_t n = strlen(hex);
+    if (n == 0 || n % 2 || n / 2 > MAX_PATTERN_LEN) return -1;
+    for (size_t i = 0; i < n / 2; i++) {
+        unsigned v;
+        if (sscanf(hex + 2 * i, "%2x", &v) != 1) return -1;
+        p->bytes[i] = (uint8_t)v;
+    }
+    p->len = n / 2;
+    return 0;
+}
+
+static int cmp_match(const void *a, const void *b) {
+    const match_t *x = a, *y = b;
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-p pid | -n name] [options] pattern ...\n", prog);
+    fprintf(stderr, "  -p PID      Target process\n");
+    fprintf(stderr, "  -n NAME     Target process by name (/proc/*/comm, like analyse.py)\n");
+    fprintf(stderr, "  -m MAPS     Comma-separated: heap, stack, anon, all, or a path substring (default: heap)\n");
+    fprintf(stderr, "  -j N        Worker threads (default: 0 = one per CPU)\n");
+    fprintf(stderr, "  -w KB       Window per read (default: 1024)\n");
+    fprintf(stderr, "  -l N        Matches to list (default: 32)\n");
+    fprintf(stderr, "  -x          Patterns (and -r) are hex bytes\n");
+    fprintf(stderr, "  -S          Stop the target (SIGSTOP) while scanning and patching\n");
+    fprintf(stderr, "  -r REPLACE  Overwrite the first match (one pattern, NUL-padded)\n");
+    fprintf(stderr, "  -a          With -r, overwrite every match\n");
+    fprintf(stderr, "Up to %d patterns of at most %d bytes.\n", MAX_PATTERNS, MAX_PATTERN_LEN);
+}
+
+int main(int argc, char *argv[]) {
+    scanner_t s;
+    const char *name = NULL, *maps_arg = "heap", *replace_arg = NULL;
+    int threads = 0, hex = 0, stop = 0, opt;
+    size_t window_kb = 1024;
+    pattern_t replace;
+
+    memset(&s, 0, sizeof(s));
+    s.pid = -1;
+    s.mem_fd = -1;
+    s.limit = 32;
+    while ((opt = getopt(argc, argv, "p:n:m:j:w:l:xSr:ah")) != -1) {
+        switch (opt) {
+        case 'p': s.pid = atoi(optarg); break;
+        case 'n': name = optarg; break;
+        case 'm': maps_arg = optarg; break;
+        case 'j': threads = atoi(optarg); break;
+        case 'w': window_kb = strtoul(optarg, NULL, 0); break;
+        case 'l': s.limit = strtoul(optarg, NULL, 0); break;
+        case 'x': hex = 1; break;
+        case 'S': stop = 1; break;
+        case 'r': replace_arg = optarg; break;
+        case 'a': s.patch_all = 1; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    s.npatterns = argc - optind;
+    if ((s.pid <= 0) == !name || s.npatterns < 1 || s.npatterns > MAX_PATTERNS || window_kb < 4 ||
+        (replace_arg && s.npatterns != 1) || (s.patch_all && !replace_arg)) {
+        usage(argv[0]);
+        return 2;
+    }
+    for (int i = 0; i < s.npatterns; i++) {
+        pattern_t *p = &s.patterns[i];
+        const char *arg = argv[optind + i];
+        p->text = arg;
+        if (hex ? parse_hex(p, arg) != 0 : (p->len = strlen(arg)) == 0 || p->len > MAX_PATTERN_LEN) {
+            fprintf(stderr, "Invalid pattern: %s\n", arg);
+            return 2;
+        }
+        if (!hex) memcpy(p->bytes, arg, p->len);
+        if (p->len > s.max_len) s.max_len = p->len;
+    }
+    if (replace_arg) {
+        memset(&replace, 0, sizeof(replace));
+        if (hex ? replace_arg[0] != '\0' && parse_hex(&replace, replace_arg) != 0
+                : (replace.len = strlen(replace_arg)) > MAX_PATTERN_LEN) {
+            fprintf(stderr, "Invalid replacement: %s\n", replace_arg);
+            return 2;
+        }
+        if (!hex) memcpy(replace.bytes, replace_arg, replace.len);
+        if (replace.len > s.patterns[0].len) {
+            fprintf(stderr, "Replacement string cannot be longer than the search string.\n");
+            return 2;
+        }
+        // Shorter replacements are padded with NULs: bytes past len are zero
+        s.replace = replace.bytes;
+    }
+
+    if (name && (s.pid = find_pid_by_name(name)) < 0) {
+        fprintf(stderr, "Process '%s' not found.\n", name);
+        return 1;
+    }
+
+    char *specs[MAX_MAP_SPECS], *maps_copy = strdup(maps_arg);
+    int nspecs = 0;
+    for (char *save = NULL, *tok = strtok_r(maps_copy, ",", &save); tok && nspecs < MAX_MAP_SPECS;
+         tok = strtok_r(NULL, ",", &save)) {
+        specs[nspecs++] = tok;
+    }
+    s.nmaps = load_mappings(s.pid, specs, nspecs, &s.maps);
+    if (s.nmaps <= 0) {
+        if (s.nmaps == 0) fprintf(stderr, "No mappings matching '%s' in process %d.\n", maps_arg, (int)s.pid);
+        return 1;
+    }
+    s.page = (size_t)sysconf(_SC_PAGESIZE);
+    s.window = (window_kb * 1024 + s.page - 1) / s.page * s.page;
+    if (build_windows(&s) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    if (s.replace) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/mem", (int)s.pid);
+        s.mem_fd = open(path, O_RDWR | O_CLOEXEC);
+        if (s.mem_fd < 0) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            return 1;
+        }
+    }
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if ((size_t)threads > s.nwindows) threads = s.nwindows ? (int)s.nwindows : 1;
+
+    worker_t workers[MAX_THREADS];
+    pthread_t tids[MAX_THREADS];
+    memset(workers, 0, sizeof(workers));
+    for (int t = 0; t < threads; t++) {
+        workers[t].s = &s;
+        workers[t].buf = malloc(s.window + s.max_len);
+        memset(workers[t].first, 0xff, sizeof(workers[t].first));
+        if (!workers[t].buf) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+    }
+
+    if (stop && kill(s.pid, SIGSTOP) != 0) {
+        fprintf(stderr, "SIGSTOP %d: %s\n", (int)s.pid, strerror(errno));
+        return 1;
+    }
+    double t0 = now_ms();
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, scan_worker, &workers[started]) != 0) break;
+    }
+    if (started == 0) scan_worker(&workers[0]);
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    double scan_ms = now_ms() - t0;
+
+    // Merge per-thread results
+    uint64_t counts[MAX_PATTERNS] = {0}, first[MAX_PATTERNS], bytes = 0, faults = 0, patched = 0;
+    size_t nlisted = 0;
+    memset(first, 0xff, sizeof(first));
+    for (int t = 0; t < threads; t++) {
+        worker_t *w = &workers[t];
+        for (int p = 0; p < s.npatterns; p++) {
+            counts[p] += w->counts[p];
+            if (w->first[p] < first[p]) first[p] = w->first[p];
+        }
+        bytes += w->bytes;
+        faults += w->faults;
+        patched += w->patched;
+        nlisted += w->nmatches;
+    }
+    match_t *listed = malloc((nlisted ? nlisted : 1) * sizeof(match_t));
+    size_t k = 0;
+    for (int t = 0; t < threads && listed; t++) {
+        memcpy(listed + k, workers[t].matches, workers[t].nmatches * sizeof(match_t));
+        k += workers[t].nmatches;
+    }
+    if (listed) qsort(listed, k, sizeof(match_t), cmp_match);
+
+    int rc = 0;
+    if (s.replace && !s.patch_all && first[0] != UINT64_MAX) {
+        if (pwrite(s.mem_fd, s.replace, s.patterns[0].len, first[0]) == (ssize_t)s.patterns[0].len) {
+            patched = 1;
+        } else {
+            fprintf(stderr, "Write at 0x%llx: %s\n", (unsigned long long)first[0], strerror(errno));
+            rc = 1;
+        }
+    }
+    if (stop) kill(s.pid, SIGCONT);
+
+    for (size_t i = 0; i < k; i++) {
+        const match_t *m = &listed[i];
+        const mapping_t *map = &s.maps[m->mapping];
+        printf("0x%llx  %s+0x%llx  pattern %d (%s)\n", (unsigned long long)m->addr, map->name,
+               (unsigned long long)(m->addr - map->start), m->pattern, s.patterns[m->pattern].text);
+    }
+    for (int p = 0; p < s.npatterns; p++) {
+        printf("Pattern %d (%s): %llu match(es)\n", p, s.patterns[p].text, (unsigned long long)counts[p]);
+    }
+    if (s.replace) {
+        if (counts[0] == 0) {
+            printf("String not found in the selected mappings.\n");
+        } else if (s.patch_all) {
+            printf("String '%s' replaced with '%s' at %llu location(s).\n", s.patterns[0].text,
+                   replace_arg, (unsigned long long)patched);
+        } else if (patched) {
+            printf("String '%s' replaced with '%s' at position %llu.\n", s.patterns[0].text, replace_arg,
+                   (unsigned long long)first[0]);
+        }
+    }
+    fprintf(stderr, "Scanned %.1f MB in %d mapping(s), %zu window(s), %d thread(s): %.1f ms (%.2f GB/s)%s\n",
+            bytes / 1e6, s.nmaps, s.nwindows, started ? started : 1, scan_ms,
+            scan_ms > 0 ? bytes / 1e6 / scan_ms : 0.0, s.gone ? " - target exited" : "");
+    if (faults) fprintf(stderr, "%llu unreadable page(s) skipped\n", (unsigned long long)faults);
+
+    free(listed);
+    for (int t = 0; t < threads; t++) {
+        free(workers[t].buf);
+        free(workers[t].matches);
+    }
+    free(s.windows);
+    free(s.maps);
+    free(maps_copy);
+    if (s.mem_fd >= 0) close(s.mem_fd);
+    return rc ? rc : s.gone;
+}
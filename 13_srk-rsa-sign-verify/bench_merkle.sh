@@ -0,0 +1,59 @@
+#!/bin/bash
+# Copyright (c) 2025 Senthil Kumar
+# Author: Senthil Kumar
+# Permission required for commercial use. Please acknowledge the author.
+# This program is free for personal and educational use.
+# Contact: senthil4321 (GitHub)
+# Signing throughput: rsa_sign_verify.sh (openssl dgst, one core) versus
+# rsa_merkle at 1, 2, 4, ... threads
+# Usage: bench_merkle.sh [size_mb] [chunk_size]
+set -e
+
+SIZE_MB="${1:-1024}"
+CHUNK="${2:-4M}"
+BENCH_DIR="bench_merkle"
+PRIVKEY="$BENCH_DIR/bench_private.pem"
+PUBKEY="$BENCH_DIR/bench_public.pem"
+DATAFILE="$BENCH_DIR/image.bin"
+
+SCRIPT_DIR="$(dirname "$0")"
+MERKLE="$SCRIPT_DIR/rsa_merkle"
+[ -x "$MERKLE" ] || make -C "$SCRIPT_DIR" rsa_merkle > /dev/null
+
+mkdir -p "$BENCH_DIR"
+[ -f "$PRIVKEY" ] || bash "$SCRIPT_DIR/rsa_gen_keys.sh" 2048 "$PRIVKEY" "$PUBKEY" > /dev/null 2>&1
+if [ "$(stat -c %s "$DATAFILE" 2> /dev/null)" != "$((SIZE_MB * 1048576))" ]; then
+    echo "Creating ${SIZE_MB} MB test file..."
+    head -c $((SIZE_MB * 1048576)) /dev/urandom > "$DATAFILE"
+fi
+cat "$DATAFILE" > /dev/null   # Warm the page cache so every run hashes from memory
+
+now_ns() { date +%s%N; }
+report() {   # name start_ns end_ns
+    local ms=$(( ($3 - $2) / 1000000 ))
+    [ "$ms" -gt 0 ] || ms=1
+    awk -v n="$1" -v ms="$ms" -v mb="$SIZE_MB" 'BEGIN { printf "%-28s %8d ms %8.2f GB/s\n", n, ms, mb * 1.048576 / ms }'
+}
+
+echo "=== Signing ${SIZE_MB} MB, chunk $CHUNK ==="
+t0=$(now_ns)
+bash "$SCRIPT_DIR/rsa_sign_verify.sh" sign "$PRIVKEY" "$DATAFILE" "$BENCH_DIR/image.sig" > /dev/null
+t1=$(now_ns)
+report "rsa_sign_verify.sh" "$t0" "$t1"
+
+NCPU=$(nproc)
+threads=1
+while :; do
+    t0=$(now_ns)
+    "$MERKLE" sign -k "$PRIVKEY" -c "$CHUNK" -j $threads "$DATAFILE" > /dev/null
+    t1=$(now_ns)
+    report "rsa_merkle -j $threads" "$t0" "$t1"
+    [ $threads -ge "$NCPU" ] && break
+    threads=$((threads * 2))
+    [ $threads -gt "$NCPU" ] && threads=$NCPU
+done
+
+t0=$(now_ns)
+"$MERKLE" verify -k "$PUBKEY" -i 0 "$DATAFILE" > /dev/null
+t1=$(now_ns)
+printf "%-28s %8d ms\n" "single-chunk verify" $(( (t1 - t0) / 1000000 ))
@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2025 Senthil Kumar
+ * Author: Senthil Kumar
+ * Permission required for commercial use. Please acknowledge the author.
+ * This program is free for personal and educational use.
+ * Contact: senthil4321 (GitHub)
+ *
+ * Batch RSA Sign / Verify
+ * Signs or verifies every file of a manifest in one process: the PEM key
+ * is parsed once, each file is mmap'd straight into SHA-256, and files are
+ * spread over a thread pool. Signatures are the same bytes as
+ * `openssl dgst -sha256 -sign` (rsa_sign_verify.sh), so either tool can
+ * verify what the other signed.
+ *
+ * Manifest: one file per line, optionally followed by a TAB and the
+ * signature path (default: file + suffix). Empty lines and lines starting
+ * with '#' are ignored; "-" reads the manifest from stdin. Files may also
+ * be given as arguments.
+ *
+ * Verify can keep a persistent cache (-C, see verify_cache.h): files whose
+ * identity, signature and key are unchanged since they last verified are
+ * not read again, and files that were only touched skip the RSA step.
+ *
+ * Usage: rsa_batch sign|verify -k key.pem [-m manifest] [-j threads]
+ *                  [-s suffix] [-o summary.json] [-C cache] [file ...]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "rsa_common.h"
+#include "verify_cache.h"
+
+#define RSA_BATCH_VERSION "1.0.0"
+#define MAX_THREADS 256
+
+typedef struct {
+    char *path;
+    char *sig_path;
+    uint64_t bytes;
+    double hash_ms;
+    double rsa_ms;              // Sign or verify time
+    int ok;
+    vc_status_t cache;          // Verify with -C only
+    char error[160];
+} job_t;
+
+typedef struct {
+    int sign;
+    EVP_PKEY *pkey;
+    job_t *jobs;
+    size_t njobs;
+    size_t next;                // Work queue head (atomic)
+    vcache_t *cache;            // NULL without -C
+    uint8_t key_id[8];          // Identifies pkey in cache entries
+} batch_t;
+
+// ============================================================================
+// Manifest
+// ============================================================================
+
+static int add_job(job_t **jobs, size_t *n, size_t *cap, const char *path, const char *sig,
+                   const char *suffix) {
+    if (*n == *cap) {
+        size_t ncap = *cap ? *cap * 2 : 64;
+        job_t *grown = realloc(*jobs, ncap * sizeof(job_t));
+        if (!grown) return -1;
+        *jobs = grown;
+        *cap = ncap;
+    }
+    job_t *j = &(*jobs)[*n];
+    memset(j, 0, sizeof(*j));
+    j->path = strdup(path);
+    if (sig && *sig) {
+        j->sig_path = strdup(sig);
+    } else if (j->path && asprintf(&j->sig_path, "%s%s", path, suffix) < 0) {
+        j->sig_path = NULL;
+    }
+    if (!j->path || !j->sig_path) return -1;
+    (*n)++;
+    return 0;
+}
+
+static int read_manifest(const char *manifest, job_t **jobs, size_t *n, size_t *cap, const char *suffix) {
+    FILE *fp = strcmp(manifest, "-") == 0 ? stdin : fopen(manifest, "r");
+    char *line = NULL;
+    size_t len = 0;
+    ssize_t got;
+    int lineno = 0, rc = 0;
+
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", manifest, strerror(errno));
+        return -1;
+    }
+    while ((got = getline(&line, &len, fp)) != -1) {
+        lineno++;
+        while (got > 0 && (line[got - 1] == '\n' || line[got - 1] == '\r')) line[--got] = '\0';
+        if (got == 0 || line[0] == '#') continue;
+        char *tab = strchr(line, '\t');
+        if (tab) *tab++ = '\0';
+        if (add_job(jobs, n, cap, line, tab, suffix) != 0) {
+            fprintf(stderr, "%s:%d: out of memory\n", manifest, lineno);
+            rc = -1;
+            break;
+        }
+    }
+    free(line);
+    if (fp != stdin) fclose(fp);
+    return rc;
+}
+
+// ============================================================================
+// Workers
+// ============================================================================
+
+// SHA-256 of the public key (DER), truncated: cache entries made with
+// another key never match
+static int public_key_id(EVP_PKEY *pkey, uint8_t id[8]) {
+    uint8_t *der = NULL, md[RC_DIGEST_LEN];
+    int len = i2d_PUBKEY(pkey, &der);
+    int ok = len > 0 && EVP_Digest(der, len, md, NULL, EVP_sha256(), NULL) == 1;
+    OPENSSL_free(der);
+    if (ok) memcpy(id, md, 8);
+    return ok ? 0 : -1;
+}
+
+// Verify one file through the cache. Cheapest check first: unchanged
+// identity, then the fs-verity measurement, then a re-hash; RSA only when
+// the content or the signature is new.
+static void run_cached_verify(const batch_t *b, job_t *j) {
+    rc_file_t f;
+    uint8_t md[RC_DIGEST_LEN];
+    uint8_t sig[RC_MAX_SIG];
+    uint8_t verity[VC_DIGEST_LEN];
+    vc_entry_t cur, old;
+    char err[128];
+
+    j->cache = VC_MISS;
+    double t0 = rc_now_ms();
+    ssize_t len = rc_read_small(j->sig_path, sig, sizeof(sig));
+    if (len < 0) {
+        snprintf(j->error, sizeof(j->error), "read signature: %s", strerror(errno));
+        return;
+    }
+    if (rc_file_open(&f, j->path) != 0) {
+        snprintf(j->error, sizeof(j->error), "open: %s", strerror(errno));
+        return;
+    }
+
+    // Identity is taken before hashing: a write racing with this run leaves
+    // a newer ctime behind, so the next run misses instead of trusting it
+    vc_identity(&cur, &f.st);
+    EVP_Digest(sig, len, cur.sig_hash, NULL, EVP_sha256(), NULL);
+    memcpy(cur.key_id, b->key_id, sizeof(cur.key_id));
+    int has_verity = vc_verity_digest(f.fd, verity) == 0;
+    if (has_verity) {
+        memcpy(cur.verity, verity, sizeof(verity));
+        cur.state |= VC_HAS_VERITY;
+    }
+
+    int known = S_ISREG(f.st.st_mode) && vc_lookup(b->cache, &f.st, &old) &&
+                memcmp(old.sig_hash, cur.sig_hash, sizeof(cur.sig_hash)) == 0 &&
+                memcmp(old.key_id, cur.key_id, sizeof(cur.key_id)) == 0;
+    if (known && vc_same_identity(&old, &cur)) {
+        j->cache = VC_HIT;
+    } else if (known && has_verity && (old.state & VC_HAS_VERITY) &&
+               memcmp(old.verity, verity, sizeof(verity)) == 0) {
+        j->cache = VC_VERITY;
+    }
+    if (j->cache != VC_MISS) {
+        j->bytes = f.st.st_size;
+        j->hash_ms = rc_now_ms() - t0;
+        rc_file_close(&f);
+        if (j->cache == VC_VERITY) {
+            memcpy(cur.content, old.content, sizeof(cur.content));
+            vc_store(b->cache, &cur);
+        }
+        j->ok = 1;
+        return;
+    }
+
+    int hashed = rc_file_sha256(&f, md, &j->bytes);
+    rc_file_close(&f);
+    double t1 = rc_now_ms();
+    j->hash_ms = t1 - t0;
+    if (hashed != 0) {
+        snprintf(j->error, sizeof(j->error), "read: %s", strerror(errno));
+        return;
+    }
+    memcpy(cur.content, md, sizeof(md));
+    if (known && memcmp(old.content, md, sizeof(md)) == 0) {
+        j->cache = VC_REHASH;
+        vc_store(b->cache, &cur);
+        j->ok = 1;
+        return;
+    }
+
+    int r = rc_verify_digest(b->pkey, md, sig, len);
+    j->rsa_ms = rc_now_ms() - t1;
+    if (r != 1) {
+        snprintf(j->error, sizeof(j->error), "%s",
+                 r == 0 ? "signature mismatch" : rc_ssl_error(err, sizeof(err), "verification error"));
+        ERR_clear_error();
+        vc_remove(b->cache, &f.st);
+        return;
+    }
+    if (S_ISREG(f.st.st_mode)) vc_store(b->cache, &cur);
+    j->ok = 1;
+}
+
+static void run_job(const batch_t *b, job_t *j) {
+    rc_file_t f;
+    uint8_t md[RC_DIGEST_LEN];
+    uint8_t sig[RC_MAX_SIG];
+    char err[128];
+
+    double t0 = rc_now_ms();
+    if (rc_file_open(&f, j->path) != 0) {
+        snprintf(j->error, sizeof(j->error), "open: %s", strerror(errno));
+        return;
+    }
+    int hashed = rc_file_sha256(&f, md, &j->bytes);
+    rc_file_close(&f);
+    double t1 = rc_now_ms();
+    j->hash_ms = t1 - t0;
+    if (hashed != 0) {
+        snprintf(j->error, sizeof(j->error), "read: %s", strerror(errno));
+        return;
+    }
+
+    if (b->sign) {
+        int len = rc_sign_digest(b->pkey, md, sig, sizeof(sig));
+        j->rsa_ms = rc_now_ms() - t1;
+        if (len < 0) {
+            snprintf(j->error, sizeof(j->error), "sign: %s", rc_ssl_error(err, sizeof(err), "failed"));
+            return;
+        }
+        if (rc_write_atomic(j->sig_path, sig, len) != 0) {
+            snprintf(j->error, sizeof(j->error), "write signature: %s", strerror(errno));
+            return;
+        }
+    } else {
+        ssize_t len = rc_read_small(j->sig_path, sig, sizeof(sig));
+        if (len < 0) {
+            snprintf(j->error, sizeof(j->error), "read signature: %s", strerror(errno));
+            return;
+        }
+        int r = rc_verify_digest(b->pkey, md, sig, len);
+        j->rsa_ms = rc_now_ms() - t1;
+        if (r != 1) {
+            snprintf(j->error, sizeof(j->error), "%s",
+                     r == 0 ? "signature mismatch" : rc_ssl_error(err, sizeof(err), "verification error"));
+            ERR_clear_error();
+            return;
+        }
+    }
+    j->ok = 1;
+}
+
+static void *batch_worker(void *arg) {
+    batch_t *b = arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->njobs) break;
+        if (b->cache) {
+            run_cached_verify(b, &b->jobs[i]);
+        } else {
+            run_job(b, &b->jobs[i]);
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Summary
+// ============================================================================
+
+static void write_summary(FILE *out, const batch_t *b, const char *key_path, int threads,
+                          double wall_ms, size_t failed, uint64_t bytes, const size_t *cache_counts) {
+    fprintf(out, "{\n  \"tool\": \"rsa_batch\",\n  \"version\": \"%s\",\n", RSA_BATCH_VERSION);
+    fprintf(out, "  \"mode\": \"%s\",\n  \"key\": ", b->sign ? "sign" : "verify");
+    rc_json_string(out, key_path);
+    fprintf(out, ",\n  \"threads\": %d,\n  \"files\": %zu,\n  \"ok\": %zu,\n  \"failed\": %zu,\n",
+            threads, b->njobs, b->njobs - failed, failed);
+    fprintf(out, "  \"bytes\": %llu,\n  \"wall_ms\": %.3f,\n  \"mb_per_s\": %.1f,\n  \"files_per_s\": %.1f,\n",
+            (unsigned long long)bytes, wall_ms, wall_ms > 0 ? bytes / 1e3 / wall_ms : 0.0,
+            wall_ms > 0 ? b->njobs * 1e3 / wall_ms : 0.0);
+    if (b->cache) {
+        fprintf(out, "  \"cache\": {\"hit\": %zu, \"verity\": %zu, \"rehash\": %zu, \"miss\": %zu},\n",
+                cache_counts[VC_HIT], cache_counts[VC_VERITY], cache_counts[VC_REHASH], cache_counts[VC_MISS]);
+    }
+    fprintf(out, "  \"results\": [");
+    for (size_t i = 0; i < b->njobs; i++) {
+        const job_t *j = &b->jobs[i];
+        fprintf(out, "%s\n    {\"path\": ", i ? "," : "");
+        rc_json_string(out, j->path);
+        fprintf(out, ", \"signature\": ");
+        rc_json_string(out, j->sig_path);
+        fprintf(out, ", \"bytes\": %llu, \"hash_ms\": %.3f, \"%s_ms\": %.3f, \"status\": \"%s\"",
+                (unsigned long long)j->bytes, j->hash_ms, b->sign ? "sign" : "verify", j->rsa_ms,
+                j->ok ? "ok" : "error");
+        if (b->cache) {
+            fprintf(out, ", \"cache\": \"%s\"", vc_status_name(j->cache));
+        }
+        if (!j->ok) {
+            fprintf(out, ", \"error\": ");
+            rc_json_string(out, j->error);
+        }
+        fputc('}', out);
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s sign|verify -k key.pem [-m manifest] [-j threads] [-s suffix] [-o summary.json] [-C cache] [file ...]\n", prog);
+    fprintf(stderr, "  -k KEY   Private key (sign) or public key (verify), PEM\n");
+    fprintf(stderr, "  -m FILE  Manifest: one path per line, optional TAB + signature path (- = stdin)\n");
+    fprintf(stderr, "  -j N     Worker threads (default: 0 = one per CPU)\n");
+    fprintf(stderr, "  -s SUF   Signature path suffix when the manifest gives none (default: .sig)\n");
+    fprintf(stderr, "  -o FILE  Write the JSON summary to FILE (- = stdout, report to stderr)\n");
+    fprintf(stderr, "  -C FILE  Verify only: persistent cache of verified files (created 0600)\n");
+    fprintf(stderr, "  -q       Only report failures\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *key_path = NULL, *manifest = NULL, *suffix = ".sig", *summary = NULL;
+    const char *cache_path = NULL;
+    int threads = 0, quiet = 0, opt;
+    job_t *jobs = NULL;
+    size_t njobs = 0, cap = 0;
+
+    if (argc < 2 || (strcmp(argv[1], "sign") != 0 && strcmp(argv[1], "verify") != 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+    int sign = strcmp(argv[1], "sign") == 0;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "k:m:j:s:o:C:qh")) != -1) {
+        switch (opt) {
+        case 'k': key_path = optarg; break;
+        case 'm': manifest = optarg; break;
+        case 'j': threads = atoi(optarg); break;
+        case 's': suffix = optarg; break;
+        case 'o': summary = optarg; break;
+        case 'C': cache_path = optarg; break;
+        case 'q': quiet = 1; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (!key_path) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (cache_path && sign) {
+        fprintf(stderr, "-C only applies to verify\n");
+        return 2;
+    }
+
+    if (manifest && read_manifest(manifest, &jobs, &njobs, &cap, suffix) != 0) {
+        return 2;
+    }
+    for (int i = optind; i < argc; i++) {
+        if (add_job(&jobs, &njobs, &cap, argv[i], NULL, suffix) != 0) {
+            fprintf(stderr, "Out of memory\n");
+            return 2;
+        }
+    }
+    if (njobs == 0) {
+        fprintf(stderr, "No files to %s\n", sign ? "sign" : "verify");
+        return 2;
+    }
+
+    EVP_PKEY *pkey = rc_load_key(key_path, sign);
+    if (!pkey) return 2;
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if ((size_t)threads > njobs) threads = (int)njobs;
+
+    batch_t batch = { .sign = sign, .pkey = pkey, .jobs = jobs, .njobs = njobs, .next = 0 };
+    vcache_t cache;
+    if (cache_path) {
+        if (public_key_id(pkey, batch.key_id) != 0) {
+            fprintf(stderr, "%s: cannot encode public key\n", key_path);
+            EVP_PKEY_free(pkey);
+            return 2;
+        }
+        if (vc_open(&cache, cache_path, njobs) != 0) {
+            EVP_PKEY_free(pkey);
+            return 2;
+        }
+        batch.cache = &cache;
+    }
+    pthread_t tids[MAX_THREADS];
+    double t0 = rc_now_ms();
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, batch_worker, &batch) != 0) break;
+    }
+    if (started == 0) {
+        batch_worker(&batch);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double wall_ms = rc_now_ms() - t0;
+
+    if (batch.cache) vc_close(&cache);
+
+    // With the JSON summary on stdout, the human-readable report goes to stderr
+    FILE *report = summary && strcmp(summary, "-") == 0 ? stderr : stdout;
+    size_t failed = 0, cache_counts[4] = {0};
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < njobs; i++) {
+        const job_t *j = &jobs[i];
+        bytes += j->bytes;
+        cache_counts[j->cache]++;
+        if (!j->ok) {
+            failed++;
+            fprintf(stderr, "FAIL %s: %s\n", j->path, j->error);
+        } else if (!quiet) {
+            fprintf(report, "%s %s -> %s\n", sign ? "Signed" : "Verified", j->path, j->sig_path);
+        }
+    }
+    fprintf(report, "%s %zu/%zu files (%.1f MB) in %.1f ms with %d thread(s)\n",
+            sign ? "Signed" : "Verified", njobs - failed, njobs, bytes / 1e6, wall_ms, started ? started : 1);
+    if (batch.cache) {
+        fprintf(report, "Cache: %zu hit, %zu verity, %zu rehash, %zu miss\n", cache_counts[VC_HIT],
+                cache_counts[VC_VERITY], cache_counts[VC_REHASH], cache_counts[VC_MISS]);
+    }
+
+    if (summary) {
+        FILE *out = strcmp(summary, "-") == 0 ? stdout : fopen(summary, "w");
+        if (!out) {
+            fprintf(stderr, "%s: %s\n", summary, strerror(errno));
+        } else {
+            write_summary(out, &batch, key_path, started ? started : 1, wall_ms, failed, bytes, cache_counts);
+            if (out != stdout) fclose(out);
+        }
+    }
+
+    for (size_t i = 0; i < njobs; i++) {
+        free(jobs[i].path);
+        free(jobs[i].sig_path);
+    }
+    free(jobs);
+    EVP_PKEY_free(pkey);
+    return failed ? 1 : 0;
+}
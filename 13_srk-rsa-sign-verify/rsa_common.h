@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2025 Senthil Kumar
+ * Author: Senthil Kumar
+ * Permission required for commercial use. Please acknowledge the author.
+ * This program is free for personal and educational use.
+ * Contact: senthil4321 (GitHub)
+ *
+ * Shared helpers for the native signing tools: PEM key loading, mmap'd
+ * file access, SHA-256 over a mapping, digest sign/verify compatible with
+ * `openssl dgst -sha256 -sign/-verify`, timing and JSON string output.
+ */
+
+#ifndef RSA_COMMON_H
+#define RSA_COMMON_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+
+#define RC_DIGEST_LEN 32          // SHA-256
+#define RC_MAX_SIG 1024           // Up to 8192-bit RSA
+#define RC_READ_CHUNK (1 << 20)
+
+static inline double rc_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Most recent OpenSSL error of this thread as text, or fallback
+static inline const char *rc_ssl_error(char *buf, size_t len, const char *fallback) {
+    unsigned long e = ERR_get_error();
+    if (e == 0) {
+        snprintf(buf, len, "%s", fallback);
+    } else {
+        ERR_error_string_n(e, buf, len);
+    }
+    ERR_clear_error();
+    return buf;
+}
+
+// ============================================================================
+// Keys
+// ============================================================================
+
+// Private key for signing, or public key for verifying (a private key file
+// is accepted for verifying too, like `openssl dgst -prverify`)
+static inline EVP_PKEY *rc_load_key(const char *path, int private_key) {
+    FILE *fp = fopen(path, "r");
+    EVP_PKEY *pkey = NULL;
+
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if (private_key) {
+        pkey = PEM_read_PrivateKey(fp, NULL, NULL, NULL);
+    } else {
+        pkey = PEM_read_PUBKEY(fp, NULL, NULL, NULL);
+        if (!pkey) {
+            rewind(fp);
+            ERR_clear_error();
+            pkey = PEM_read_PrivateKey(fp, NULL, NULL, NULL);
+        }
+    }
+    fclose(fp);
+    if (!pkey) {
+        char err[256];
+        fprintf(stderr, "%s: cannot load %s key: %s\n", path, private_key ? "private" : "public",
+                rc_ssl_error(err, sizeof(err), "unknown error"));
+    }
+    return pkey;
+}
+
+// ============================================================================
+// Files
+// ============================================================================
+
+typedef struct {
+    int fd;
+    const uint8_t *data;      // NULL for empty files or when mmap failed
+    size_t size;
+    struct stat st;
+} rc_file_t;
+
+// Open and map a file read-only. Returns 0, or -1 with errno set.
+static inline int rc_file_open(rc_file_t *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+    f->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (f->fd < 0) return -1;
+    if (fstat(f->fd, &f->st) != 0) {
+        int saved = errno;
+        close(f->fd);
+        errno = saved;
+        return -1;
+    }
+    if (S_ISREG(f->st.st_mode) && f->st.st_size > 0) {
+        f->size = f->st.st_size;
+        void *p = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+        if (p != MAP_FAILED) {
+            f->data = p;
+            madvise(p, f->size, MADV_SEQUENTIAL);
+        }
+    }
+    return 0;
+}
+
+static inline void rc_file_close(rc_file_t *f) {
+    if (f->data) munmap((void *)f->data, f->size);
+    if (f->fd >= 0) close(f->fd);
+    f->data = NULL;
+    f->fd = -1;
+}
+
+// SHA-256 of a whole file: straight from the mapping, or read() for
+// files that could not be mapped (pipes, special files). Returns 0 or -1.
+static inline int rc_file_sha256(rc_file_t *f, uint8_t md[RC_DIGEST_LEN], uint64_t *bytes) {
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    int ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1;
+    uint64_t total = 0;
+
+    if (ok && f->data) {
+        ok = EVP_DigestUpdate(ctx, f->data, f->size) == 1;
+        total = f->size;
+    } else if (ok) {
+        uint8_t *buf = malloc(RC_READ_CHUNK);
+        ssize_t n;
+        ok = buf != NULL;
+        while (ok && (n = read(f->fd, buf, RC_READ_CHUNK)) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ok = 0;
+                break;
+            }
+            ok = EVP_DigestUpdate(ctx, buf, n) == 1;
+            total += n;
+        }
+        free(buf);
+    }
+    ok = ok && EVP_DigestFinal_ex(ctx, md, NULL) == 1;
+    EVP_MD_CTX_free(ctx);
+    if (bytes) *bytes = total;
+    return ok ? 0 : -1;
+}
+
+// ============================================================================
+// Digest signatures
+// ============================================================================
+
+// Sign / verify an existing SHA-256 digest. The result is byte-identical
+// to `openssl dgst -sha256 -sign` (PKCS#1 v1.5 for RSA keys).
+static inline EVP_PKEY_CTX *rc_pkey_ctx(EVP_PKEY *pkey, int sign) {
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    if (!ctx) return NULL;
+    if ((sign ? EVP_PKEY_sign_init(ctx) : EVP_PKEY_verify_init(ctx)) != 1 ||
+        EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha256()) != 1 ||
+        (EVP_PKEY_is_a(pkey, "RSA") && EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) != 1)) {
+        EVP_PKEY_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+// Returns the signature length, or -1
+static inline int rc_sign_digest(EVP_PKEY *pkey, const uint8_t md[RC_DIGEST_LEN], uint8_t *sig, size_t cap) {
+    EVP_PKEY_CTX *ctx = rc_pkey_ctx(pkey, 1);
+    size_t len = cap;
+    int ok = ctx && EVP_PKEY_sign(ctx, sig, &len, md, RC_DIGEST_LEN) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    return ok ? (int)len : -1;
+}
+
+// Returns 1 if valid, 0 if not, -1 on error
+static inline int rc_verify_digest(EVP_PKEY *pkey, const uint8_t md[RC_DIGEST_LEN], const uint8_t *sig, size_t len) {
+    EVP_PKEY_CTX *ctx = rc_pkey_ctx(pkey, 0);
+    int r = ctx ? EVP_PKEY_verify(ctx, sig, len, md, RC_DIGEST_LEN) : -1;
+    EVP_PKEY_CTX_free(ctx);
+    return r == 1 ? 1 : (r == 0 ? 0 : -1);
+}
+
+// Whole small file into buf. Returns bytes read, or -1.
+static inline ssize_t rc_read_small(const char *path, uint8_t *buf, size_t cap) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t total = 0, n;
+    while ((size_t)total < cap && (n = read(fd, buf + total, cap - total)) > 0) total += n;
+    close(fd);
+    return total;
+}
+
+// Write via a temporary file and rename(), so readers never see a partial file
+static inline int rc_write_atomic(const char *path, const void *data, size_t len) {
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp.%d", path, (int)getpid()) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    const uint8_t *p = data;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            int saved = errno;
+            close(fd);
+            unlink(tmp);
+            errno = saved;
+            return -1;
+        }
+        p += n;
+        left -= n;
+    }
+    if (close(fd) != 0 || rename(tmp, path) != 0) {
+        int saved = errno;
+        unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// JSON
+// ============================================================================
+
+static inline void rc_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        switch (*p) {
+        case '"': fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        default:
+            if (*p < 0x20) {
+                fprintf(out, "\\u%04x", *p);
+            } else {
+                fputc(*p, out);
+            }
+        }
+    }
+    fputc('"', out);
+}
+
+static inline void rc_hex(char *out, const uint8_t *data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = digits[data[i] >> 4];
+        out[2 * i + 1] = digits[data[i] & 15];
+    }
+    out[2 * len] = '\0';
+}
+
+// Parse exactly len bytes of hex. Returns 0, or -1 on bad input.
+static inline int rc_unhex(uint8_t *out, const char *hex, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        int v = 0;
+        for (int k = 0; k < 2; k++) {
+            char c = hex[2 * i + k];
+            int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                    c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            if (d < 0) return -1;
+            v = v * 16 + d;
+        }
+        out[i] = (uint8_t)v;
+    }
+    return 0;
+}
+
+#endif // RSA_COMMON_H
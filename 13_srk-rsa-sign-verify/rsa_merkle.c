@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2025 Senthil Kumar
+ * Author: Senthil Kumar
+ * Permission required for commercial use. Please acknowledge the author.
+ * This program is free for personal and educational use.
+ * Contact: senthil4321 (GitHub)
+ *
+ * Merkle-Tree Sign / Verify for Large Files
+ * Splits a file into fixed-size chunks, hashes the chunks in parallel,
+ * builds a SHA-256 Merkle tree and signs only the root. The detached
+ * manifest lists every leaf hash, so one chunk can be checked against the
+ * signature without reading the rest of the file.
+ *
+ *   leaf  = SHA-256(0x00 || chunk)
+ *   node  = SHA-256(0x01 || left || right)      (RFC 6962 tree shape:
+ *           an odd node at the end of a level moves up unchanged)
+ *   empty file: root = SHA-256("")
+ *
+ * The signature covers SHA-256("MERKLE-SHA256-V1" || file_size || chunk_size
+ * || root) with the sizes as 64-bit big-endian, so a manifest cannot be
+ * replayed with a different chunking or length.
+ *
+ * Usage: rsa_merkle sign   -k private.pem [-c chunk] [-j threads] [-o manifest] file
+ *        rsa_merkle verify -k public.pem  [-m manifest] [-j threads] [-i chunk_index] file
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "rsa_common.h"
+
+#define MERKLE_MAGIC "MERKLE-SHA256-V1"
+#define MERKLE_HEADER "merkle-sha256 v1"
+#define DEFAULT_CHUNK (4u << 20)
+#define MIN_CHUNK 4096
+#define MAX_THREADS 256
+
+typedef uint8_t digest_t[RC_DIGEST_LEN];
+
+typedef struct {
+    uint64_t file_size;
+    uint64_t chunk_size;
+    uint64_t nchunks;
+    digest_t root;
+    digest_t *leaves;
+    uint8_t sig[RC_MAX_SIG];
+    size_t sig_len;
+} manifest_t;
+
+// ============================================================================
+// Tree
+// ============================================================================
+
+static int hash_prefixed(EVP_MD_CTX *ctx, uint8_t prefix, const void *a, size_t alen,
+                         const void *b, size_t blen, uint8_t *out) {
+    return EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1 &&
+           EVP_DigestUpdate(ctx, &prefix, 1) == 1 &&
+           EVP_DigestUpdate(ctx, a, alen) == 1 &&
+           (blen == 0 || EVP_DigestUpdate(ctx, b, blen) == 1) &&
+           EVP_DigestFinal_ex(ctx, out, NULL) == 1 ? 0 : -1;
+}
+
+static int merkle_root(const digest_t *leaves, uint64_t n, digest_t root) {
+    if (n == 0) {
+        return EVP_Digest("", 0, root, NULL, EVP_sha256(), NULL) == 1 ? 0 : -1;
+    }
+    digest_t *level = malloc(n * sizeof(digest_t));
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    int rc = level && ctx ? 0 : -1;
+
+    if (rc == 0) memcpy(level, leaves, n * sizeof(digest_t));
+    while (rc == 0 && n > 1) {
+        uint64_t half = 0;
+        for (uint64_t i = 0; i + 1 < n && rc == 0; i += 2) {
+            rc = hash_prefixed(ctx, 0x01, level[i], RC_DIGEST_LEN, level[i + 1], RC_DIGEST_LEN, level[half++]);
+        }
+        if (n & 1) memcpy(level[half++], level[n - 1], RC_DIGEST_LEN);
+        n = half;
+    }
+    if (rc == 0) memcpy(root, level[0], RC_DIGEST_LEN);
+    EVP_MD_CTX_free(ctx);
+    free(level);
+    return rc;
+}
+
+// Digest that is actually signed: binds the root to the chunking
+static int signed_digest(const manifest_t *m, digest_t out) {
+    uint8_t msg[sizeof(MERKLE_MAGIC) - 1 + 16 + RC_DIGEST_LEN];
+    size_t off = sizeof(MERKLE_MAGIC) - 1;
+    memcpy(msg, MERKLE_MAGIC, off);
+    for (int i = 0; i < 8; i++) msg[off + i] = (uint8_t)(m->file_size >> (56 - 8 * i));
+    for (int i = 0; i < 8; i++) msg[off + 8 + i] = (uint8_t)(m->chunk_size >> (56 - 8 * i));
+    memcpy(msg + off + 16, m->root, RC_DIGEST_LEN);
+    return EVP_Digest(msg, sizeof(msg), out, NULL, EVP_sha256(), NULL) == 1 ? 0 : -1;
+}
+
+// ============================================================================
+// Parallel leaf hashing
+// ============================================================================
+
+typedef struct {
+    const uint8_t *data;
+    uint64_t size;
+    uint64_t chunk;
+    uint64_t nchunks;
+    digest_t *leaves;
+    uint64_t next;              // Work queue head (atomic)
+    int failed;
+} leaf_work_t;
+
+static void *leaf_worker(void *arg) {
+    leaf_work_t *w = arg;
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    if (!ctx) {
+        __atomic_store_n(&w->failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    for (;;) {
+        uint64_t i = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+        if (i >= w->nchunks) break;
+        uint64_t off = i * w->chunk;
+        uint64_t len = w->size - off < w->chunk ? w->size - off : w->chunk;
+        if (hash_prefixed(ctx, 0x00, w->data + off, len, NULL, 0, w->leaves[i]) != 0) {
+            __atomic_store_n(&w->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+    EVP_MD_CTX_free(ctx);
+    return NULL;
+}
+
+static int hash_leaves(const rc_file_t *f, uint64_t chunk, int threads, digest_t *leaves) {
+    leaf_work_t w = {
+        .data = f->data, .size = f->size, .chunk = chunk,
+        .nchunks = (f->size + chunk - 1) / chunk, .leaves = leaves,
+    };
+    pthread_t tids[MAX_THREADS];
+    int started = 0;
+
+    if ((uint64_t)threads > w.nchunks) threads = (int)w.nchunks;
+    for (; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, leaf_worker, &w) != 0) break;
+    }
+    if (started == 0) leaf_worker(&w);
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    return w.failed ? -1 : 0;
+}
+
+static int open_mapped(rc_file_t *f, const char *path) {
+    if (rc_file_open(f, path) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (!S_ISREG(f->st.st_mode) || (f->size > 0 && !f->data)) {
+        fprintf(stderr, "%s: not a regular file that can be mapped\n", path);
+        rc_file_close(f);
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// Manifest I/O
+// ============================================================================
+
+static int write_manifest(const char *path, const manifest_t *m) {
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&buf, &len);
+    char hex[2 * RC_MAX_SIG + 1];
+
+    if (!out) return -1;
+    fprintf(out, "%s\n", MERKLE_HEADER);
+    fprintf(out, "file_size %llu\n", (unsigned long long)m->file_size);
+    fprintf(out, "chunk_size %llu\n", (unsigned long long)m->chunk_size);
+    fprintf(out, "chunks %llu\n", (unsigned long long)m->nchunks);
+    rc_hex(hex, m->root, RC_DIGEST_LEN);
+    fprintf(out, "root %s\n", hex);
+    rc_hex(hex, m->sig, m->sig_len);
+    fprintf(out, "signature %s\n", hex);
+    for (uint64_t i = 0; i < m->nchunks; i++) {
+        rc_hex(hex, m->leaves[i], RC_DIGEST_LEN);
+        fprintf(out, "%s\n", hex);
+    }
+    fclose(out);
+    int rc = rc_write_atomic(path, buf, len);
+    free(buf);
+    return rc;
+}
+
+static int read_manifest(const char *path, manifest_t *m) {
+    FILE *fp = fopen(path, "r");
+    char line[2 * RC_MAX_SIG + 32];
+    char hex[2 * RC_MAX_SIG + 1];
+    unsigned long long fs, cs, n;
+
+    memset(m, 0, sizeof(*m));
+    if (!fp) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, MERKLE_HEADER, strlen(MERKLE_HEADER)) != 0 ||
+        !fgets(line, sizeof(line), fp) || sscanf(line, "file_size %llu", &fs) != 1 ||
+        !fgets(line, sizeof(line), fp) || sscanf(line, "chunk_size %llu", &cs) != 1 ||
+        !fgets(line, sizeof(line), fp) || sscanf(line, "chunks %llu", &n) != 1 ||
+        !fgets(line, sizeof(line), fp) || sscanf(line, "root %64s", hex) != 1 ||
+        strlen(hex) != 2 * RC_DIGEST_LEN || rc_unhex(m->root, hex, RC_DIGEST_LEN) != 0 ||
+        !fgets(line, sizeof(line), fp) || sscanf(line, "signature %2048s", hex) != 1 ||
+        strlen(hex) % 2 != 0 || rc_unhex(m->sig, hex, strlen(hex) / 2) != 0 ||
+        cs < MIN_CHUNK || n != (fs + cs - 1) / cs) {
+        goto bad;
+    }
+    m->file_size = fs;
+    m->chunk_size = cs;
+    m->nchunks = n;
+    m->sig_len = strlen(hex) / 2;
+    m->leaves = malloc((n ? n : 1) * sizeof(digest_t));
+    if (!m->leaves) goto bad;
+    for (uint64_t i = 0; i < n; i++) {
+        if (!fgets(line, sizeof(line), fp) || strlen(line) < 2 * RC_DIGEST_LEN ||
+            rc_unhex(m->leaves[i], line, RC_DIGEST_LEN) != 0) {
+            goto bad;
+        }
+    }
+    fclose(fp);
+    return 0;
+
+bad:
+    fprintf(stderr, "%s: malformed Merkle manifest\n", path);
+    free(m->leaves);
+    m->leaves = NULL;
+    fclose(fp);
+    return -1;
+}
+
+// Signature over the header, and the listed leaves really produce the root
+static int check_manifest(EVP_PKEY *pkey, manifest_t *m) {
+    digest_t md, root;
+    if (signed_digest(m, md) != 0 || rc_verify_digest(pkey, md, m->sig, m->sig_len) != 1) {
+        fprintf(stderr, "Manifest signature is invalid\n");
+        return -1;
+    }
+    if (merkle_root(m->leaves, m->nchunks, root) != 0 || memcmp(root, m->root, RC_DIGEST_LEN) != 0) {
+        fprintf(stderr, "Manifest leaves do not match the signed root\n");
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// Commands
+// ============================================================================
+
+static int cmd_sign(EVP_PKEY *pkey, const char *file, const char *out_path, uint64_t chunk, int threads) {
+    rc_file_t f;
+    manifest_t m = { .chunk_size = chunk };
+    char root_hex[2 * RC_DIGEST_LEN + 1];
+    digest_t md;
+    int rc = 1;
+
+    if (open_mapped(&f, file) != 0) return 1;
+    m.file_size = f.size;
+    m.nchunks = (f.size + chunk - 1) / chunk;
+    m.leaves = malloc((m.nchunks ? m.nchunks : 1) * sizeof(digest_t));
+    if (!m.leaves) goto out;
+
+    double t0 = rc_now_ms();
+    if (hash_leaves(&f, chunk, threads, m.leaves) != 0 || merkle_root(m.leaves, m.nchunks, m.root) != 0) {
+        fprintf(stderr, "%s: hashing failed\n", file);
+        goto out;
+    }
+    double t1 = rc_now_ms();
+    int len = signed_digest(&m, md) == 0 ? rc_sign_digest(pkey, md, m.sig, sizeof(m.sig)) : -1;
+    double t2 = rc_now_ms();
+    if (len < 0) {
+        char err[256];
+        fprintf(stderr, "Signing failed: %s\n", rc_ssl_error(err, sizeof(err), "unknown error"));
+        goto out;
+    }
+    m.sig_len = len;
+    if (write_manifest(out_path, &m) != 0) {
+        fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+        goto out;
+    }
+
+    rc_hex(root_hex, m.root, RC_DIGEST_LEN);
+    printf("Signed %s -> %s\n", file, out_path);
+    printf("  %llu bytes, %llu chunks of %llu, root %s\n", (unsigned long long)m.file_size,
+           (unsigned long long)m.nchunks, (unsigned long long)chunk, root_hex);
+    printf("  hash %.1f ms (%.2f GB/s, %d thread(s)), sign %.1f ms\n", t1 - t0,
+           t1 > t0 ? m.file_size / 1e6 / (t1 - t0) : 0.0, threads, t2 - t1);
+    rc = 0;
+
+out:
+    free(m.leaves);
+    rc_file_close(&f);
+    return rc;
+}
+
+static int cmd_verify(EVP_PKEY *pkey, const char *file, const char *manifest_path, int threads) {
+    rc_file_t f;
+    manifest_t m;
+    digest_t *leaves = NULL;
+    int rc = 1;
+
+    if (read_manifest(manifest_path, &m) != 0) return 1;
+    if (check_manifest(pkey, &m) != 0) goto out_manifest;
+    if (open_mapped(&f, file) != 0) goto out_manifest;
+    if (f.size != m.file_size) {
+        fprintf(stderr, "%s: size %llu, manifest says %llu\n", file, (unsigned long long)f.size,
+                (unsigned long long)m.file_size);
+        goto out;
+    }
+
+    leaves = malloc((m.nchunks ? m.nchunks : 1) * sizeof(digest_t));
+    double t0 = rc_now_ms();
+    if (!leaves || hash_leaves(&f, m.chunk_size, threads, leaves) != 0) {
+        fprintf(stderr, "%s: hashing failed\n", file);
+        goto out;
+    }
+    double t1 = rc_now_ms();
+
+    uint64_t bad = 0;
+    for (uint64_t i = 0; i < m.nchunks; i++) {
+        if (memcmp(leaves[i], m.leaves[i], RC_DIGEST_LEN) != 0) {
+            if (bad++ < 10) {
+                fprintf(stderr, "Chunk %llu (offset %llu) does not match\n", (unsigned long long)i,
+                        (unsigned long long)(i * m.chunk_size));
+            }
+        }
+    }
+    if (bad) {
+        fprintf(stderr, "Verification failed for %s: %llu of %llu chunks differ\n", file,
+                (unsigned long long)bad, (unsigned long long)m.nchunks);
+        goto out;
+    }
+    printf("Verified %s (%llu chunks, hash %.1f ms, %.2f GB/s, %d thread(s))\n", file,
+           (unsigned long long)m.nchunks, t1 - t0, t1 > t0 ? m.file_size / 1e6 / (t1 - t0) : 0.0, threads);
+    rc = 0;
+
+out:
+    free(leaves);
+    rc_file_close(&f);
+out_manifest:
+    free(m.leaves);
+    return rc;
+}
+
+// One chunk: signature and leaf list are checked, then only that chunk is read
+static int cmd_verify_chunk(EVP_PKEY *pkey, const char *file, const char *manifest_path, uint64_t index) {
+    rc_file_t f;
+    manifest_t m;
+    digest_t leaf;
+    int rc = 1;
+
+    if (read_manifest(manifest_path, &m) != 0) return 1;
+    if (check_manifest(pkey, &m) != 0) goto out_manifest;
+    if (index >= m.nchunks) {
+        fprintf(stderr, "Chunk %llu out of range (%llu chunks)\n", (unsigned long long)index,
+                (unsigned long long)m.nchunks);
+        goto out_manifest;
+    }
+    if (open_mapped(&f, file) != 0) goto out_manifest;
+    if (f.size != m.file_size) {
+        fprintf(stderr, "%s: size %llu, manifest says %llu\n", file, (unsigned long long)f.size,
+                (unsigned long long)m.file_size);
+        goto out;
+    }
+
+    uint64_t off = index * m.chunk_size;
+    uint64_t len = f.size - off < m.chunk_size ? f.size - off : m.chunk_size;
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    double t0 = rc_now_ms();
+    int hashed = ctx ? hash_prefixed(ctx, 0x00, f.data + off, len, NULL, 0, leaf) : -1;
+    double t1 = rc_now_ms();
+    EVP_MD_CTX_free(ctx);
+    if (hashed != 0 || memcmp(leaf, m.leaves[index], RC_DIGEST_LEN) != 0) {
+        fprintf(stderr, "Chunk %llu of %s does not match the signed manifest\n", (unsigned long long)index, file);
+        goto out;
+    }
+    printf("Verified chunk %llu of %s (offset %llu, %llu bytes, %.2f ms)\n", (unsigned long long)index, file,
+           (unsigned long long)off, (unsigned long long)len, t1 - t0);
+    rc = 0;
+
+out:
+    rc_file_close(&f);
+out_manifest:
+    free(m.leaves);
+    return rc;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s sign   -k private.pem [-c chunk_size] [-j threads] [-o manifest] file\n", prog);
+    fprintf(stderr, "       %s verify -k public.pem  [-m manifest] [-j threads] [-i chunk_index] file\n", prog);
+    fprintf(stderr, "  -c N     Chunk size in bytes, K/M/G suffix allowed (default: 4M, min 4096)\n");
+    fprintf(stderr, "  -j N     Hashing threads (default: 0 = one per CPU)\n");
+    fprintf(stderr, "  -o/-m    Manifest path (default: file.merkle)\n");
+    fprintf(stderr, "  -i N     Verify only chunk N\n");
+}
+
+static uint64_t parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+    case 'k': case 'K': v <<= 10; break;
+    case 'm': case 'M': v <<= 20; break;
+    case 'g': case 'G': v <<= 30; break;
+    }
+    return v;
+}
+
+int main(int argc, char *argv[]) {
+    const char *key_path = NULL, *manifest = NULL;
+    uint64_t chunk = DEFAULT_CHUNK;
+    long long index = -1;
+    int threads = 0, opt;
+
+    if (argc < 2 || (strcmp(argv[1], "sign") != 0 && strcmp(argv[1], "verify") != 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+    int sign = strcmp(argv[1], "sign") == 0;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "k:c:j:o:m:i:h")) != -1) {
+        switch (opt) {
+        case 'k': key_path = optarg; break;
+        case 'c': chunk = parse_size(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        case 'o': case 'm': manifest = optarg; break;
+        case 'i': index = atoll(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (!key_path || optind != argc - 1 || chunk < MIN_CHUNK) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char *file = argv[optind];
+    char default_manifest[4096];
+    if (!manifest) {
+        snprintf(default_manifest, sizeof(default_manifest), "%s.merkle", file);
+        manifest = default_manifest;
+    }
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    EVP_PKEY *pkey = rc_load_key(key_path, sign);
+    if (!pkey) return 2;
+
+    int rc;
+    if (sign) {
+        rc = cmd_sign(pkey, file, manifest, chunk, threads);
+    } else if (index >= 0) {
+        rc = cmd_verify_chunk(pkey, file, manifest, (uint64_t)index);
+    } else {
+        rc = cmd_verify(pkey, file, manifest, threads);
+    }
+    EVP_PKEY_free(pkey);
+    return rc;
+}
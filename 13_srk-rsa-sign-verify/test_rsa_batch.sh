@@ -0,0 +1,149 @@
+#!/bin/bash
+# Copyright (c) 2025 Senthil Kumar
+# Author: Senthil Kumar
+# Permission required for commercial use. Please acknowledge the author.
+# This program is free for personal and educational use.
+# Contact: senthil4321 (GitHub)
+# Unit tests for rsa_batch (native batch sign/verify)
+set -e
+
+TEST_LOG="test_rsa_batch.log"
+TEST_DIR="test_rsa_batch"
+KEYSIZE=2048
+PRIVKEY="$TEST_DIR/test_private.pem"
+PUBKEY="$TEST_DIR/test_public.pem"
+MANIFEST="$TEST_DIR/manifest.txt"
+SUMMARY="$TEST_DIR/summary.json"
+CACHE="$TEST_DIR/verify.cache"
+NUM_FILES=20
+
+SCRIPT_DIR="$(dirname "$0")"
+BATCH="$SCRIPT_DIR/rsa_batch"
+
+pass() { echo "$1: PASS" | tee -a "$TEST_LOG"; }
+fail() { echo "$1: FAIL" | tee -a "$TEST_LOG"; exit 1; }
+
+rm -rf "$TEST_DIR" "$TEST_LOG"
+mkdir -p "$TEST_DIR"
+
+if [ ! -x "$BATCH" ]; then
+    make -C "$SCRIPT_DIR" rsa_batch > /dev/null
+fi
+
+# Key pair and test files (including an empty one and one with a space)
+bash "$SCRIPT_DIR/rsa_gen_keys.sh" $KEYSIZE "$PRIVKEY" "$PUBKEY" > /dev/null 2>&1 || fail "Key generation"
+pass "Key generation"
+
+: > "$MANIFEST"
+for i in $(seq 1 $NUM_FILES); do
+    head -c $((i * 4099)) /dev/urandom > "$TEST_DIR/file_$i.bin"
+    echo "$TEST_DIR/file_$i.bin" >> "$MANIFEST"
+done
+: > "$TEST_DIR/empty.bin"
+echo "Hello, RSA Test!" > "$TEST_DIR/with space.txt"
+echo "# comment lines are ignored" >> "$MANIFEST"
+echo "$TEST_DIR/empty.bin" >> "$MANIFEST"
+printf '%s\t%s\n' "$TEST_DIR/with space.txt" "$TEST_DIR/custom.sig" >> "$MANIFEST"
+
+# Batch sign
+"$BATCH" sign -k "$PRIVKEY" -m "$MANIFEST" -j 4 -q -o "$SUMMARY" || fail "Batch signing"
+[ -f "$TEST_DIR/file_1.bin.sig" ] && [ -f "$TEST_DIR/custom.sig" ] || fail "Batch signing"
+pass "Batch signing"
+
+# Summary is valid JSON with one result per file
+python3 - "$SUMMARY" $((NUM_FILES + 2)) <<'EOF' || fail "JSON summary"
+import json, sys
+s = json.load(open(sys.argv[1]))
+assert s["mode"] == "sign" and s["failed"] == 0 and s["files"] == int(sys.argv[2])
+assert all(r["status"] == "ok" and r["hash_ms"] >= 0 for r in s["results"])
+EOF
+pass "JSON summary"
+
+# Same bytes as openssl dgst (signatures are deterministic PKCS#1 v1.5)
+openssl dgst -sha256 -sign "$PRIVKEY" -out "$TEST_DIR/openssl.sig" "$TEST_DIR/file_3.bin"
+cmp -s "$TEST_DIR/openssl.sig" "$TEST_DIR/file_3.bin.sig" || fail "Matches openssl dgst"
+bash "$SCRIPT_DIR/rsa_sign_verify.sh" verify "$PUBKEY" "$TEST_DIR/file_5.bin" "$TEST_DIR/file_5.bin.sig" > /dev/null \
+    || fail "Matches openssl dgst"
+pass "Matches openssl dgst"
+
+# Batch verify, from stdin
+"$BATCH" verify -k "$PUBKEY" -m - -q < "$MANIFEST" || fail "Batch verification"
+pass "Batch verification"
+
+# With -o - stdout carries only the JSON summary, the report goes to stderr
+"$BATCH" verify -k "$PUBKEY" -C "$TEST_DIR/stdout.cache" -o - "$TEST_DIR/file_1.bin" "$TEST_DIR/file_2.bin" \
+    2> "$TEST_DIR/report.txt" | python3 -c 'import json, sys; assert json.load(sys.stdin)["ok"] == 2' \
+    || fail "Summary on stdout"
+grep -q "^Verified 2/2 files" "$TEST_DIR/report.txt" && grep -q "^Cache:" "$TEST_DIR/report.txt" \
+    || fail "Summary on stdout"
+pass "Summary on stdout"
+
+# Tampered file and missing signature are reported, the rest still pass
+echo "tampered" >> "$TEST_DIR/file_7.bin"
+rm -f "$TEST_DIR/file_9.bin.sig"
+if "$BATCH" verify -k "$PUBKEY" -m "$MANIFEST" -q -o "$SUMMARY" 2> /dev/null; then
+    fail "Tamper detection"
+fi
+python3 - "$SUMMARY" <<'EOF' || fail "Tamper detection"
+import json, sys
+s = json.load(open(sys.argv[1]))
+bad = sorted(r["path"].rsplit("/", 1)[1] for r in s["results"] if r["status"] != "ok")
+assert bad == ["file_7.bin", "file_9.bin"], bad
+EOF
+pass "Tamper detection"
+
+# Verification cache: cold run verifies, warm run reads nothing
+"$BATCH" sign -k "$PRIVKEY" -m "$MANIFEST" -q || fail "Verification cache"
+cache_counts() {
+    python3 - "$SUMMARY" <<'EOF'
+import json, sys
+s = json.load(open(sys.argv[1]))
+c = s["cache"]
+print(s["failed"], c["hit"], c["rehash"], c["miss"])
+EOF
+}
+"$BATCH" verify -k "$PUBKEY" -m "$MANIFEST" -q -C "$CACHE" -o "$SUMMARY" > /dev/null || fail "Verification cache"
+[ "$(cache_counts)" = "0 0 0 $((NUM_FILES + 2))" ] || fail "Verification cache"
+"$BATCH" verify -k "$PUBKEY" -m "$MANIFEST" -q -C "$CACHE" -o "$SUMMARY" > /dev/null || fail "Verification cache"
+[ "$(cache_counts)" = "0 $((NUM_FILES + 2)) 0 0" ] || fail "Verification cache"
+[ "$(stat -c %a "$CACHE")" = "600" ] || fail "Verification cache"
+pass "Verification cache"
+
+# A touched file is re-hashed but not re-verified; changed content and a
+# replaced signature are caught
+sleep 0.01
+touch "$TEST_DIR/file_2.bin"
+echo "tampered" >> "$TEST_DIR/file_4.bin"
+cp "$TEST_DIR/file_6.bin.sig" "$TEST_DIR/file_8.bin.sig"
+if "$BATCH" verify -k "$PUBKEY" -m "$MANIFEST" -q -C "$CACHE" -o "$SUMMARY" > /dev/null 2>&1; then
+    fail "Cache invalidation"
+fi
+[ "$(cache_counts)" = "2 $((NUM_FILES - 1)) 1 2" ] || fail "Cache invalidation"
+python3 - "$SUMMARY" <<'EOF' || fail "Cache invalidation"
+import json, sys
+s = json.load(open(sys.argv[1]))
+st = {r["path"].rsplit("/", 1)[1]: (r["status"], r["cache"]) for r in s["results"]}
+assert st["file_2.bin"] == ("ok", "rehash"), st
+assert st["file_4.bin"] == ("error", "miss"), st
+assert st["file_8.bin"] == ("error", "miss"), st
+EOF
+pass "Cache invalidation"
+
+# A cache that other users can write is refused
+chmod 666 "$CACHE"
+if "$BATCH" verify -k "$PUBKEY" -m "$MANIFEST" -q -C "$CACHE" > /dev/null 2>&1; then
+    fail "Cache permissions"
+fi
+pass "Cache permissions"
+
+# A file that is not a cache, even a short one, is refused and left intact
+NOT_CACHE="$TEST_DIR/not_a_cache.txt"
+echo "keep me" > "$NOT_CACHE"
+chmod 600 "$NOT_CACHE"
+if "$BATCH" verify -k "$PUBKEY" -m "$MANIFEST" -q -C "$NOT_CACHE" > /dev/null 2>&1; then
+    fail "Foreign cache file"
+fi
+[ "$(cat "$NOT_CACHE")" = "keep me" ] || fail "Foreign cache file"
+pass "Foreign cache file"
+
+echo "All tests passed." | tee -a "$TEST_LOG"
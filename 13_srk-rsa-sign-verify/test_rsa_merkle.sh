@@ -0,0 +1,75 @@
+#!/bin/bash
+# Copyright (c) 2025 Senthil Kumar
+# Author: Senthil Kumar
+# Permission required for commercial use. Please acknowledge the author.
+# This program is free for personal and educational use.
+# Contact: senthil4321 (GitHub)
+# Unit tests for rsa_merkle (chunked Merkle-tree sign/verify)
+set -e
+
+TEST_LOG="test_rsa_merkle.log"
+TEST_DIR="test_rsa_merkle"
+KEYSIZE=2048
+PRIVKEY="$TEST_DIR/test_private.pem"
+PUBKEY="$TEST_DIR/test_public.pem"
+DATAFILE="$TEST_DIR/image.bin"
+MANIFEST="$DATAFILE.merkle"
+CHUNK=65536
+
+SCRIPT_DIR="$(dirname "$0")"
+MERKLE="$SCRIPT_DIR/rsa_merkle"
+
+pass() { echo "$1: PASS" | tee -a "$TEST_LOG"; }
+fail() { echo "$1: FAIL" | tee -a "$TEST_LOG"; exit 1; }
+
+rm -rf "$TEST_DIR" "$TEST_LOG"
+mkdir -p "$TEST_DIR"
+
+if [ ! -x "$MERKLE" ]; then
+    make -C "$SCRIPT_DIR" rsa_merkle > /dev/null
+fi
+
+bash "$SCRIPT_DIR/rsa_gen_keys.sh" $KEYSIZE "$PRIVKEY" "$PUBKEY" > /dev/null 2>&1 || fail "Key generation"
+pass "Key generation"
+
+# 7.5 chunks, so the last chunk is partial and the tree has an odd level
+head -c $((CHUNK * 15 / 2)) /dev/urandom > "$DATAFILE"
+
+"$MERKLE" sign -k "$PRIVKEY" -c $CHUNK -j 4 "$DATAFILE" > /dev/null || fail "Merkle signing"
+[ "$(sed -n 4p "$MANIFEST")" = "chunks 8" ] || fail "Merkle signing"
+pass "Merkle signing"
+
+# Thread count must not change the tree
+"$MERKLE" sign -k "$PRIVKEY" -c $CHUNK -j 1 -o "$TEST_DIR/serial.merkle" "$DATAFILE" > /dev/null
+cmp -s "$MANIFEST" "$TEST_DIR/serial.merkle" || fail "Deterministic manifest"
+pass "Deterministic manifest"
+
+"$MERKLE" verify -k "$PUBKEY" "$DATAFILE" > /dev/null || fail "Full verification"
+pass "Full verification"
+
+"$MERKLE" verify -k "$PUBKEY" -i 7 "$DATAFILE" > /dev/null || fail "Single-chunk verification"
+pass "Single-chunk verification"
+
+# Corrupt one byte in chunk 2: full verify names it, other chunks still verify.
+# The byte is inverted, so the random data cannot already hold the new value.
+OFFSET=$((CHUNK * 2 + 100))
+BYTE=$(od -An -tu1 -j $OFFSET -N1 "$DATAFILE")
+printf "\\$(printf '%03o' $((BYTE ^ 255)))" | dd of="$DATAFILE" bs=1 seek=$OFFSET conv=notrunc status=none
+if "$MERKLE" verify -k "$PUBKEY" "$DATAFILE" 2> "$TEST_DIR/err.txt" > /dev/null; then
+    fail "Tamper detection"
+fi
+grep -q "Chunk 2 " "$TEST_DIR/err.txt" || fail "Tamper detection"
+"$MERKLE" verify -k "$PUBKEY" -i 0 "$DATAFILE" > /dev/null || fail "Tamper detection"
+if "$MERKLE" verify -k "$PUBKEY" -i 2 "$DATAFILE" 2> /dev/null > /dev/null; then
+    fail "Tamper detection"
+fi
+pass "Tamper detection"
+
+# A leaf edited in the manifest no longer matches the signed root
+sed -i '7s/^1/2/;t;7s/^./1/' "$TEST_DIR/serial.merkle"
+if "$MERKLE" verify -k "$PUBKEY" -m "$TEST_DIR/serial.merkle" -i 0 "$DATAFILE" 2> /dev/null > /dev/null; then
+    fail "Manifest tamper detection"
+fi
+pass "Manifest tamper detection"
+
+echo "All tests passed." | tee -a "$TEST_LOG"
@@ -23,7 +23,7 @@ echo "Hello, RSA Test!" > "$DATAFILE"
 # Generate key pair
 SCRIPT_DIR="$(dirname "$0")"
 echo "Generating RSA key pair..." | tee -a "$TEST_LOG"
-"$SCRIPT_DIR/rsa_gen_keys.sh" $KEYSIZE "$PRIVKEY" "$PUBKEY"
+bash "$SCRIPT_DIR/rsa_gen_keys.sh" $KEYSIZE "$PRIVKEY" "$PUBKEY"
 if [ $? -eq 0 ]; then
     echo "Key generation: PASS" | tee -a "$TEST_LOG"
 else
@@ -33,7 +33,7 @@ fi
 
 # Sign the file
 echo "Signing data file..." | tee -a "$TEST_LOG"
-"$SCRIPT_DIR/rsa_sign_verify.sh" sign "$PRIVKEY" "$DATAFILE" "$SIGFILE"
+bash "$SCRIPT_DIR/rsa_sign_verify.sh" sign "$PRIVKEY" "$DATAFILE" "$SIGFILE"
 if [ $? -eq 0 ]; then
     echo "Signing: PASS" | tee -a "$TEST_LOG"
 else
@@ -43,7 +43,7 @@ fi
 
 # Verify the signature
 echo "Verifying signature..." | tee -a "$TEST_LOG"
-"$SCRIPT_DIR/rsa_sign_verify.sh" verify "$PUBKEY" "$DATAFILE" "$SIGFILE"
+bash "$SCRIPT_DIR/rsa_sign_verify.sh" verify "$PUBKEY" "$DATAFILE" "$SIGFILE"
 if [ $? -eq 0 ]; then
     echo "Verification: PASS" | tee -a "$TEST_LOG"
 else
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2025 Senthil Kumar
+ * Author: Senthil Kumar
+ * Permission required for commercial use. Please acknowledge the author.
+ * This program is free for personal and educational use.
+ * Contact: senthil4321 (GitHub)
+ *
+ * Persistent Verification Cache
+ * An mmap'd open-addressing hash table that remembers files whose
+ * signature already verified, so unchanged files skip hashing and RSA.
+ *
+ * One entry per (dev, inode). An entry only counts when everything matches:
+ *   identity   dev, inode, size, mtime_ns, ctime_ns
+ *   content    SHA-256 of the file (the signed digest), and the fs-verity
+ *              digest when the file has fs-verity enabled
+ *   statement  SHA-256 of the signature bytes and an id of the public key
+ *
+ * Lookup outcomes (vc_status_t):
+ *   HIT     identity unchanged: nothing is read
+ *   VERITY  fs-verity file with the same measurement: the kernel vouches
+ *           for the content, so metadata changes do not matter
+ *   REHASH  identity changed (touch, copy-back, ...) but the re-hashed
+ *           content is the same: RSA is skipped, the entry is refreshed
+ *   MISS    full verification; on success the entry is (re)written
+ *
+ * ctime is in the identity because, unlike mtime, it cannot be set back
+ * by user space. Each entry carries a checksum, so an entry torn by a
+ * crash is ignored rather than trusted. The file is locked with flock()
+ * for the lifetime of the handle, and is refused if other users can write
+ * it: whoever can write the cache can make files "verify".
+ */
+
+#ifndef VERIFY_CACHE_H
+#define VERIFY_CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/fsverity.h>
+
+#define VC_MAGIC "VCACHE01"
+#define VC_MIN_CAPACITY 1024
+#define VC_DIGEST_LEN 32
+
+#define VC_EMPTY 0
+#define VC_VALID 1
+#define VC_TOMBSTONE 2
+#define VC_HAS_VERITY 0x100
+
+typedef enum { VC_MISS = 0, VC_HIT, VC_VERITY, VC_REHASH } vc_status_t;
+
+typedef struct {
+    char magic[8];
+    uint64_t capacity;          // Entries, power of two
+    uint64_t count;             // Valid entries
+    uint8_t pad[40];
+} vc_header_t;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+    uint8_t content[VC_DIGEST_LEN];   // SHA-256 of the file
+    uint8_t verity[VC_DIGEST_LEN];    // fs-verity digest (VC_HAS_VERITY)
+    uint8_t sig_hash[VC_DIGEST_LEN];  // SHA-256 of the signature file
+    uint8_t key_id[8];                // First bytes of SHA-256(public key DER)
+    uint32_t state;                   // VC_EMPTY / VC_VALID / VC_TOMBSTONE | flags
+    uint32_t pad;
+    uint64_t check;                   // Checksum of all bytes above
+} vc_entry_t;
+
+_Static_assert(sizeof(vc_header_t) == 64, "cache header layout");
+_Static_assert(sizeof(vc_entry_t) == 160, "cache entry layout");
+
+typedef struct {
+    int fd;
+    vc_header_t *hdr;
+    vc_entry_t *entries;
+    size_t map_size;
+    pthread_mutex_t lock;       // Threads of this process; flock() covers others
+} vcache_t;
+
+static inline uint64_t vc_mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t vc_checksum(const vc_entry_t *e) {
+    // FNV-1a: detects torn or garbage entries, not an authenticator
+    const uint8_t *p = (const uint8_t *)e;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < offsetof(vc_entry_t, check); i++) {
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static inline int vc_entry_valid(const vc_entry_t *e) {
+    return (e->state & 0xff) == VC_VALID && e->check == vc_checksum(e);
+}
+
+static inline int64_t vc_ns(struct timespec ts) {
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Fill the identity fields of an entry from stat()
+static inline void vc_identity(vc_entry_t *e, const struct stat *st) {
+    memset(e, 0, sizeof(*e));
+    e->dev = st->st_dev;
+    e->ino = st->st_ino;
+    e->size = st->st_size;
+    e->mtime_ns = vc_ns(st->st_mtim);
+    e->ctime_ns = vc_ns(st->st_ctim);
+}
+
+static inline int vc_same_identity(const vc_entry_t *a, const vc_entry_t *b) {
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+           a->mtime_ns == b->mtime_ns && a->ctime_ns == b->ctime_ns;
+}
+
+// fs-verity SHA-256 measurement of an open file. Returns 0 if the file has
+// fs-verity enabled (digest in out), -1 otherwise.
+static inline int vc_verity_digest(int fd, uint8_t out[VC_DIGEST_LEN]) {
+    struct {
+        struct fsverity_digest d;
+        uint8_t buf[64];
+    } m;
+    m.d.digest_size = sizeof(m.buf);
+    if (ioctl(fd, FS_IOC_MEASURE_VERITY, &m.d) != 0 ||
+        m.d.digest_algorithm != FS_VERITY_HASH_ALG_SHA256 || m.d.digest_size != VC_DIGEST_LEN) {
+        return -1;
+    }
+    memcpy(out, m.d.digest, VC_DIGEST_LEN);
+    return 0;
+}
+
+// ============================================================================
+// Table
+// ============================================================================
+
+static inline vc_entry_t *vc_probe(vc_entry_t *entries, uint64_t capacity, uint64_t dev, uint64_t ino,
+                                   int for_insert) {
+    uint64_t mask = capacity - 1;
+    uint64_t i = vc_mix(dev * 0x100000001b3ULL ^ ino) & mask;
+    vc_entry_t *free_slot = NULL;
+
+    for (uint64_t n = 0; n < capacity; n++, i = (i + 1) & mask) {
+        vc_entry_t *e = &entries[i];
+        uint32_t state = e->state & 0xff;
+        if (state == VC_EMPTY) {
+            return for_insert ? (free_slot ? free_slot : e) : NULL;
+        }
+        if (vc_entry_valid(e)) {
+            if (e->dev == dev && e->ino == ino) return e;
+        } else if (!free_slot) {
+            free_slot = e;          // Tombstone or torn entry: reusable
+        }
+    }
+    return for_insert ? free_slot : NULL;
+}
+
+static inline int vc_map(vcache_t *c, uint64_t capacity) {
+    c->map_size = sizeof(vc_header_t) + capacity * sizeof(vc_entry_t);
+    void *p = mmap(NULL, c->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+    if (p == MAP_FAILED) return -1;
+    c->hdr = p;
+    c->entries = (vc_entry_t *)((uint8_t *)p + sizeof(vc_header_t));
+    return 0;
+}
+
+// Resize (or create) the table with room for `capacity` entries, keeping
+// every valid entry. Runs under the flock, before any lookups.
+static inline int vc_rebuild(vcache_t *c, uint64_t capacity) {
+    vc_entry_t *keep = NULL;
+    uint64_t nkeep = 0;
+
+    if (c->hdr) {
+        keep = malloc((c->hdr->count + 1) * sizeof(vc_entry_t));
+        if (!keep) return -1;
+        for (uint64_t i = 0; i < c->hdr->capacity && nkeep <= c->hdr->count; i++) {
+            if (vc_entry_valid(&c->entries[i])) keep[nkeep++] = c->entries[i];
+        }
+        munmap(c->hdr, c->map_size);
+        c->hdr = NULL;
+    }
+    if (ftruncate(c->fd, 0) != 0 ||
+        ftruncate(c->fd, sizeof(vc_header_t) + capacity * sizeof(vc_entry_t)) != 0 ||
+        vc_map(c, capacity) != 0) {
+        free(keep);
+        return -1;
+    }
+    memcpy(c->hdr->magic, VC_MAGIC, sizeof(c->hdr->magic));
+    c->hdr->capacity = capacity;
+    c->hdr->count = 0;
+    for (uint64_t i = 0; i < nkeep; i++) {
+        vc_entry_t *slot = vc_probe(c->entries, capacity, keep[i].dev, keep[i].ino, 1);
+        if (slot) {
+            *slot = keep[i];
+            c->hdr->count++;
+        }
+    }
+    free(keep);
+    return 0;
+}
+
+// Open (creating if needed) a cache with room for `expected` more files.
+// A non-empty file without the cache magic is left untouched.
+// Returns 0, or -1 after printing the reason.
+static inline int vc_open(vcache_t *c, const char *path, size_t expected) {
+    struct stat st;
+
+    memset(c, 0, sizeof(*c));
+    c->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (c->fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (flock(c->fd, LOCK_EX) != 0 || fstat(c->fd, &st) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(c->fd);
+        return -1;
+    }
+    if (st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        fprintf(stderr, "%s: refusing a cache that is not private to this user\n", path);
+        close(c->fd);
+        return -1;
+    }
+
+    // Only an empty file or one that starts with our magic may be
+    // (re)written: -C pointed at anything else is a mistake, not a cache
+    uint64_t capacity = VC_MIN_CAPACITY;
+    if (st.st_size > 0) {
+        vc_header_t h;
+        memset(&h, 0, sizeof(h));
+        if (pread(c->fd, &h, sizeof(h), 0) < (ssize_t)sizeof(h.magic) || memcmp(h.magic, VC_MAGIC, 8) != 0) {
+            fprintf(stderr, "%s: not a verification cache, refusing to overwrite it\n", path);
+            close(c->fd);
+            return -1;
+        }
+        if ((size_t)st.st_size >= sizeof(vc_header_t) &&
+            h.capacity >= VC_MIN_CAPACITY && (h.capacity & (h.capacity - 1)) == 0 &&
+            (uint64_t)st.st_size == sizeof(vc_header_t) + h.capacity * sizeof(vc_entry_t) &&
+            vc_map(c, h.capacity) == 0) {
+            capacity = h.capacity;
+        } else {
+            fprintf(stderr, "%s: damaged cache, starting empty\n", path);
+        }
+    }
+
+    // Keep the load factor at or below 1/2 for this run
+    uint64_t want = capacity;
+    uint64_t need = 2 * ((c->hdr ? c->hdr->count : 0) + expected);
+    while (want < need) want <<= 1;
+    if (!c->hdr || want != capacity) {
+        if (vc_rebuild(c, want) != 0) {
+            fprintf(stderr, "%s: cannot size cache: %s\n", path, strerror(errno));
+            if (c->hdr) munmap(c->hdr, c->map_size);
+            close(c->fd);
+            return -1;
+        }
+    }
+    pthread_mutex_init(&c->lock, NULL);
+    return 0;
+}
+
+static inline void vc_close(vcache_t *c) {
+    if (c->hdr) {
+        msync(c->hdr, c->map_size, MS_ASYNC);
+        munmap(c->hdr, c->map_size);
+        pthread_mutex_destroy(&c->lock);
+    }
+    if (c->fd >= 0) close(c->fd);   // Also releases the flock
+    c->hdr = NULL;
+    c->fd = -1;
+}
+
+// Copy the entry for st's (dev, inode) into out. Returns 1 if found.
+static inline int vc_lookup(vcache_t *c, const struct stat *st, vc_entry_t *out) {
+    pthread_mutex_lock(&c->lock);
+    vc_entry_t *e = vc_probe(c->entries, c->hdr->capacity, st->st_dev, st->st_ino, 0);
+    if (e) *out = *e;
+    pthread_mutex_unlock(&c->lock);
+    return e != NULL;
+}
+
+static inline void vc_store(vcache_t *c, const vc_entry_t *entry) {
+    vc_entry_t e = *entry;
+    e.state = (e.state & ~0xffu) | VC_VALID;
+    e.check = vc_checksum(&e);
+
+    pthread_mutex_lock(&c->lock);
+    vc_entry_t *slot = vc_probe(c->entries, c->hdr->capacity, e.dev, e.ino, 1);
+    if (slot) {
+        if (!vc_entry_valid(slot)) c->hdr->count++;
+        *slot = e;
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static inline void vc_remove(vcache_t *c, const struct stat *st) {
+    pthread_mutex_lock(&c->lock);
+    vc_entry_t *e = vc_probe(c->entries, c->hdr->capacity, st->st_dev, st->st_ino, 0);
+    if (e) {
+        e->state = VC_TOMBSTONE;
+        e->check = 0;
+        c->hdr->count--;
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static inline const char *vc_status_name(vc_status_t s) {
+    switch (s) {
+    case VC_HIT: return "hit";
+    case VC_VERITY: return "verity";
+    case VC_REHASH: return "rehash";
+    default: return "miss";
+    }
+}
+
+#endif // VERIFY_CACHE_H
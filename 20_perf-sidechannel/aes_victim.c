@@ -1,17 +1,42 @@
 /*
  * AES Victim Process
  * Performs AES encryption operations that can be observed via cache timing
+ *
+ * With -r NAME every encryption is also logged to the shared-memory ring
+ * NAME (sample_ring.h): sequence number, start/end timestamp, plaintext and
+ * ciphertext. perf_spy -r NAME reads the same ring to attribute its counter
+ * readings to individual encryptions.
+ *
+ * With -b it is a self-timed benchmark instead: N pinned threads drive one
+ * engine (OpenSSL EVP, legacy AES_encrypt, simple_aes.h) under a load
+ * profile (closed loop, open loop at a fixed rate, bursts) and report
+ * per-thread throughput and latency percentiles on exit. -N repeats the
+ * run and -o writes every run's totals as JSON results (bench_json.h).
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <time.h>
 
+#include "cache_ctl.h"
+#include "cpu_affinity.h"
+#include "sample_ring.h"
+#include "latency_hist.h"
+#include "simple_aes.h"
+#include "bench_json.h"
+
 #define KEY_SIZE 16  // 128-bit key
 #define BLOCK_SIZE 16
+#define MAX_THREADS 256
+#define MAX_BLOCKS_PER_OP 65536
 
 // Secret key we're trying to extract via side-channel
 static unsigned char secret_key[KEY_SIZE] = {
@@ -19,6 +44,13 @@ static unsigned char secret_key[KEY_SIZE] = {
     0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
 };
 
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
 void print_hex(const char *label, unsigned char *data, int len) {
     printf("%s: ", label);
     for (int i = 0; i < len; i++) {
@@ -27,44 +59,474 @@ void print_hex(const char *label, unsigned char *data, int len) {
     printf("\n");
 }
 
-int main() {
+// ============================================================================
+// Benchmark mode
+// ============================================================================
+
+typedef enum { ENGINE_EVP, ENGINE_LEGACY, ENGINE_SIMPLE } engine_t;
+typedef enum { LOAD_CLOSED, LOAD_OPEN, LOAD_BURST } load_t;
+
+static const char *engine_names[] = { "evp", "legacy", "simple" };
+
+typedef struct {
+    engine_t engine;
+    load_t load;
+    double rate;              // Open loop: operations per second per thread
+    int burst_ops;            // Burst: operations back to back ...
+    long burst_gap_us;        // ... then this long idle
+    int threads;
+    double seconds;
+    unsigned long max_ops;    // Per thread, 0 = run for `seconds`
+    size_t blocks;            // 16-byte blocks per operation
+} bench_config_t;
+
+typedef struct {
+    int id;
+    int cpu;
+    const bench_config_t *cfg;
+    uint64_t ops;
+    double elapsed;
+    latency_hist_t hist;
+    int error;
+} bench_thread_t;
+
+static int parse_engine(const char *s, engine_t *out) {
+    for (int e = 0; e < 3; e++) {
+        if (strcmp(s, engine_names[e]) == 0) {
+            *out = (engine_t)e;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// closed | open:RATE | burst:OPS:GAP_US
+static int parse_profile(const char *s, bench_config_t *cfg) {
+    if (strcmp(s, "closed") == 0) {
+        cfg->load = LOAD_CLOSED;
+        return 0;
+    }
+    if (sscanf(s, "open:%lf", &cfg->rate) == 1 && cfg->rate > 0) {
+        cfg->load = LOAD_OPEN;
+        return 0;
+    }
+    if (sscanf(s, "burst:%d:%ld", &cfg->burst_ops, &cfg->burst_gap_us) == 2 &&
+        cfg->burst_ops > 0 && cfg->burst_gap_us >= 0) {
+        cfg->load = LOAD_BURST;
+        return 0;
+    }
+    return -1;
+}
+
+static void pin_bench_thread(const bench_thread_t *t) {
+    if (ca_pin_thread(t->cpu) != 0) {
+        fprintf(stderr, "Warning: could not pin thread %d to CPU %d\n", t->id, t->cpu);
+    }
+}
+
+static void sleep_until(uint64_t deadline, double hz) {
+    uint64_t now = cc_timestamp();
+    if (now >= deadline) return;
+    // Sleep through most of the wait, spin the last 50 us for precision
+    double wait_us = (deadline - now) / hz * 1e6;
+    if (wait_us > 100) {
+        usleep((useconds_t)(wait_us - 50));
+    }
+    while (cc_timestamp() < deadline) {
+        __asm__ volatile("" ::: "memory");
+    }
+}
+
+static void *bench_worker(void *arg) {
+    bench_thread_t *t = arg;
+    const bench_config_t *cfg = t->cfg;
+    size_t len = cfg->blocks * BLOCK_SIZE;
+    unsigned char *in = malloc(len), *out = malloc(len + BLOCK_SIZE);
+    EVP_CIPHER_CTX *evp = NULL;
+    AES_KEY legacy;
+    SimpleAES_CTX simple;
+    double hz = cc_timestamp_hz();
+    double ns_per_tick = 1e9 / hz;
+
+    pin_bench_thread(t);
+    lh_init(&t->hist);
+    if (!in || !out) {
+        t->error = 1;
+        goto done;
+    }
+    for (size_t i = 0; i < len; i++) in[i] = (unsigned char)(i * 131 + t->id);
+
+    switch (cfg->engine) {
+    case ENGINE_EVP:
+        evp = EVP_CIPHER_CTX_new();
+        if (!evp || EVP_EncryptInit_ex(evp, EVP_aes_128_ecb(), NULL, secret_key, NULL) != 1) {
+            t->error = 1;
+            goto done;
+        }
+        EVP_CIPHER_CTX_set_padding(evp, 0);
+        break;
+    case ENGINE_LEGACY:
+        // The deprecated AES_* API is the engine being measured
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+        AES_set_encrypt_key(secret_key, 128, &legacy);
+#pragma GCC diagnostic pop
+        break;
+    case ENGINE_SIMPLE:
+        simple_aes_key_expansion(&simple, secret_key);
+        break;
+    }
+
+    uint64_t period = cfg->load == LOAD_OPEN ? (uint64_t)(hz / cfg->rate) : 0;
+    uint64_t gap = (uint64_t)(cfg->burst_gap_us * hz / 1e6);
+    uint64_t start = cc_timestamp();
+    uint64_t stop = start + (uint64_t)(cfg->seconds * hz);
+    uint64_t scheduled = start;
+
+    for (uint64_t op = 0; cfg->max_ops ? op < cfg->max_ops : cc_timestamp() < stop; op++) {
+        if (stop_requested) break;
+
+        // Open loop: latency runs from the scheduled start, so time spent
+        // behind schedule counts (no coordinated omission)
+        uint64_t t0;
+        if (cfg->load == LOAD_OPEN) {
+            sleep_until(scheduled, hz);
+            t0 = scheduled;
+            scheduled += period;
+        } else {
+            if (cfg->load == LOAD_BURST && op > 0 && op % cfg->burst_ops == 0) {
+                sleep_until(cc_timestamp() + gap, hz);
+            }
+            t0 = cc_timestamp();
+        }
+
+        // Vary the input so no engine can reuse a result
+        memcpy(in, &op, sizeof(op));
+        switch (cfg->engine) {
+        case ENGINE_EVP: {
+            int outl;
+            EVP_EncryptUpdate(evp, out, &outl, in, (int)len);
+            break;
+        }
+        case ENGINE_LEGACY:
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+            for (size_t b = 0; b < cfg->blocks; b++) {
+                AES_encrypt(in + b * BLOCK_SIZE, out + b * BLOCK_SIZE, &legacy);
+            }
+#pragma GCC diagnostic pop
+            break;
+        case ENGINE_SIMPLE:
+            simple_aes_encrypt_ecb(&simple, in, out, cfg->blocks);
+            break;
+        }
+        uint64_t t1 = cc_timestamp();
+
+        lh_record(&t->hist, (uint64_t)((t1 - t0) * ns_per_tick));
+        t->ops++;
+    }
+    t->elapsed = (cc_timestamp() - start) / hz;
+
+done:
+    EVP_CIPHER_CTX_free(evp);
+    free(in);
+    free(out);
+    return NULL;
+}
+
+static void print_profile(const bench_config_t *cfg) {
+    switch (cfg->load) {
+    case LOAD_CLOSED:
+        printf("closed loop");
+        break;
+    case LOAD_OPEN:
+        printf("open loop, %.0f ops/s per thread", cfg->rate);
+        break;
+    case LOAD_BURST:
+        printf("bursts of %d ops, %ld us apart", cfg->burst_ops, cfg->burst_gap_us);
+        break;
+    }
+}
+
+// Records one run's totals as "<engine>/<profile>/threads=N/blocks=N/<metric>"
+static void record_benchmark(bench_results_t *r, const bench_config_t *cfg, double ops_s,
+                             const latency_hist_t *all) {
+    static const struct { const char *name; double q; } pct[] = {
+        { "p50", 0.50 }, { "p90", 0.90 }, { "p99", 0.99 }, { "p99.9", 0.999 },
+    };
+    char point[96];
+    int len = snprintf(point, sizeof(point), "%s/", engine_names[cfg->engine]);
+
+    switch (cfg->load) {
+    case LOAD_CLOSED:
+        len += snprintf(point + len, sizeof(point) - len, "closed");
+        break;
+    case LOAD_OPEN:
+        len += snprintf(point + len, sizeof(point) - len, "open:%.0f", cfg->rate);
+        break;
+    case LOAD_BURST:
+        len += snprintf(point + len, sizeof(point) - len, "burst:%d:%ld", cfg->burst_ops, cfg->burst_gap_us);
+        break;
+    }
+    snprintf(point + len, sizeof(point) - len, "/threads=%d/blocks=%zu", cfg->threads, cfg->blocks);
+
+    bench_record(r, "Mops/s", BENCH_HIGHER, ops_s / 1e6, "%s/throughput", point);
+    bench_record(r, "MB/s", BENCH_HIGHER, ops_s * cfg->blocks * BLOCK_SIZE / 1e6, "%s/bandwidth", point);
+    bench_record(r, "ns", BENCH_LOWER, lh_mean(all), "%s/latency_mean", point);
+    for (size_t i = 0; i < sizeof(pct) / sizeof(pct[0]); i++) {
+        bench_record(r, "ns", BENCH_LOWER, (double)lh_percentile(all, pct[i].q), "%s/latency_%s", point,
+                     pct[i].name);
+    }
+}
+
+static int run_benchmark(const bench_config_t *cfg, bench_results_t *results) {
+    static bench_thread_t threads[MAX_THREADS];
+    pthread_t tids[MAX_THREADS];
+    int cpus[MAX_THREADS];
+    int ncpus = ca_select_cpus(cpus, MAX_THREADS);
+    latency_hist_t all;
+
+    printf("=== AES Victim Benchmark ===\n");
+    printf("Engine: %s, %zu block(s) per op, %d thread(s), ", engine_names[cfg->engine],
+           cfg->blocks, cfg->threads);
+    print_profile(cfg);
+    if (cfg->max_ops) {
+        printf(", %lu ops per thread\n\n", cfg->max_ops);
+    } else {
+        printf(", %.1f s\n\n", cfg->seconds);
+    }
+
+    cc_timestamp_hz();   // Calibrate once before the threads start
+    for (int i = 0; i < cfg->threads; i++) {
+        memset(&threads[i], 0, sizeof(threads[i]));
+        threads[i].id = i;
+        threads[i].cpu = ncpus ? cpus[i % ncpus] : -1;
+        threads[i].cfg = cfg;
+        if (pthread_create(&tids[i], NULL, bench_worker, &threads[i]) != 0) {
+            fprintf(stderr, "Failed to start thread %d\n", i);
+            stop_requested = 1;
+            for (int j = 0; j < i; j++) {
+                pthread_join(tids[j], NULL);
+            }
+            return 1;
+        }
+    }
+
+    lh_init(&all);
+    uint64_t total_ops = 0;
+    double wall = 0;
+    int failed = 0;
+    printf("%-7s %-4s %12s %10s %10s %9s %9s %9s\n",
+           "Thread", "CPU", "Ops", "Mops/s", "MB/s", "p50 ns", "p99 ns", "max ns");
+    for (int i = 0; i < cfg->threads; i++) {
+        bench_thread_t *t = &threads[i];
+        pthread_join(tids[i], NULL);
+        if (t->error) {
+            fprintf(stderr, "Thread %d: engine setup failed\n", i);
+            failed = 1;
+            continue;
+        }
+        double ops_s = t->elapsed > 0 ? t->ops / t->elapsed : 0;
+        printf("%-7d %-4d %12lu %10.3f %10.1f %9lu %9lu %9lu\n", i, t->cpu, (unsigned long)t->ops,
+               ops_s / 1e6, ops_s * cfg->blocks * BLOCK_SIZE / 1e6,
+               (unsigned long)lh_percentile(&t->hist, 0.50), (unsigned long)lh_percentile(&t->hist, 0.99),
+               (unsigned long)t->hist.max);
+        lh_merge(&all, &t->hist);
+        total_ops += t->ops;
+        if (t->elapsed > wall) wall = t->elapsed;
+    }
+
+    double ops_s = wall > 0 ? total_ops / wall : 0;
+    printf("%-7s %-4s %12lu %10.3f %10.1f\n\n", "Total", "", (unsigned long)total_ops,
+           ops_s / 1e6, ops_s * cfg->blocks * BLOCK_SIZE / 1e6);
+    printf("Latency (ns, all threads): mean %.1f  p50 %lu  p90 %lu  p99 %lu  p99.9 %lu  max %lu\n",
+           lh_mean(&all), (unsigned long)lh_percentile(&all, 0.50), (unsigned long)lh_percentile(&all, 0.90),
+           (unsigned long)lh_percentile(&all, 0.99), (unsigned long)lh_percentile(&all, 0.999),
+           (unsigned long)all.max);
+    if (!failed) {
+        record_benchmark(results, cfg, ops_s, &all);
+    }
+    if (cfg->load == LOAD_OPEN && cfg->max_ops == 0) {
+        double target = cfg->rate * cfg->threads;
+        if (ops_s < 0.95 * target) {
+            printf("Warning: achieved %.0f ops/s of %.0f requested; latencies include queueing\n",
+                   ops_s, target);
+        }
+    }
+    return failed;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-r ring_name] [-n count] [-d delay_us] [-C capacity]\n", prog);
+    fprintf(stderr, "       %s -b [-e engine] [-p profile] [-j threads] [-t seconds] [-n ops] [-s blocks]\n"
+                    "          [-N runs] [-o results.json]\n", prog);
+    fprintf(stderr, "  -r NAME  Log every encryption to shared-memory ring NAME\n");
+    fprintf(stderr, "  -n N     Stop after N encryptions (default: run until interrupted)\n");
+    fprintf(stderr, "  -d US    Sleep between encryptions in microseconds (default: 10, 0 with -r)\n");
+    fprintf(stderr, "  -C N     Ring capacity in records (default: %u)\n", SR_DEFAULT_CAPACITY);
+    fprintf(stderr, "Benchmark mode (-b):\n");
+    fprintf(stderr, "  -e ENG   evp | legacy | simple (default: legacy)\n");
+    fprintf(stderr, "  -p PROF  closed | open:RATE (ops/s per thread) | burst:OPS:GAP_US (default: closed)\n");
+    fprintf(stderr, "  -j N     Threads, pinned round-robin to isolated or allowed CPUs (default: 1)\n");
+    fprintf(stderr, "  -t SEC   Duration (default: 5)\n");
+    fprintf(stderr, "  -n N     Operations per thread instead of a duration\n");
+    fprintf(stderr, "  -s N     16-byte blocks per operation (default: 1)\n");
+    fprintf(stderr, "  -N N     Repeat the run N times, one trial each (default: 1)\n");
+    fprintf(stderr, "  -o FILE  Write throughput and latency percentiles of every run as JSON\n");
+}
+
+int main(int argc, char *argv[]) {
     AES_KEY enc_key;
     unsigned char plaintext[BLOCK_SIZE];
     unsigned char ciphertext[BLOCK_SIZE];
-    
+    const char *ring_name = NULL;
+    unsigned long max_iterations = 0;
+    long delay_us = -1;
+    unsigned long capacity = SR_DEFAULT_CAPACITY;
+    sample_ring_t ring;
+    int bench = 0, runs = 1;
+    const char *json_path = NULL;
+    bench_config_t cfg = { .engine = ENGINE_LEGACY, .load = LOAD_CLOSED, .threads = 1,
+                           .seconds = 5.0, .blocks = 1 };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:n:d:C:be:p:j:t:s:N:o:h")) != -1) {
+        switch (opt) {
+        case 'r': ring_name = optarg; break;
+        case 'n': max_iterations = strtoul(optarg, NULL, 10); break;
+        case 'd': delay_us = atol(optarg); break;
+        case 'C': capacity = strtoul(optarg, NULL, 10); break;
+        case 'b': bench = 1; break;
+        case 'e':
+            if (parse_engine(optarg, &cfg.engine) != 0) {
+                fprintf(stderr, "Unknown engine: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            if (parse_profile(optarg, &cfg) != 0) {
+                fprintf(stderr, "Bad load profile: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'j': cfg.threads = atoi(optarg); break;
+        case 't': cfg.seconds = atof(optarg); break;
+        case 's': cfg.blocks = strtoul(optarg, NULL, 10); break;
+        case 'N': runs = atoi(optarg); break;
+        case 'o': json_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (bench) {
+        if (ring_name) {
+            fprintf(stderr, "-r and -b cannot be combined\n");
+            return 1;
+        }
+        if (cfg.threads < 1 || cfg.threads > MAX_THREADS || cfg.blocks < 1 ||
+            cfg.blocks > MAX_BLOCKS_PER_OP || cfg.seconds <= 0 || runs < 1) {
+            fprintf(stderr, "Need 1-%d threads, 1-%d blocks per op, a positive duration and at least one run\n",
+                    MAX_THREADS, MAX_BLOCKS_PER_OP);
+            return 1;
+        }
+        cfg.max_ops = max_iterations;
+        signal(SIGINT, handle_stop);
+        signal(SIGTERM, handle_stop);
+
+        bench_results_t results;
+        int rc = 0;
+        bench_init(&results, "aes_victim", argc, argv);
+        for (int run = 0; run < runs && rc == 0 && !stop_requested; run++) {
+            if (runs > 1) {
+                printf("\n#### Run %d/%d ####\n", run + 1, runs);
+            }
+            rc = run_benchmark(&cfg, &results);
+        }
+        if (json_path && bench_write(&results, json_path) != 0) {
+            perror(json_path);
+            rc = 1;
+        }
+        bench_free(&results);
+        return rc;
+    }
+    if (delay_us < 0) {
+        delay_us = ring_name ? 0 : 10;
+    }
+    if (capacity == 0 || capacity > (1ul << 30)) {
+        fprintf(stderr, "Ring capacity must be between 1 and 2^30 records\n");
+        return 1;
+    }
+
     printf("=== AES Victim Process ===\n");
     printf("PID: %d\n", getpid());
     print_hex("Secret Key", secret_key, KEY_SIZE);
-    
+
     // Initialize AES key
     if (AES_set_encrypt_key(secret_key, 128, &enc_key) < 0) {
         fprintf(stderr, "AES key setup failed\n");
         return 1;
     }
-    
+
+    if (ring_name) {
+        if (sr_create(&ring, ring_name, sizeof(sr_victim_rec_t), capacity) != 0) {
+            return 1;
+        }
+        printf("Ring: /dev/shm%s (%u records of %zu bytes)\n",
+               ring.name, ring.hdr->capacity, sizeof(sr_victim_rec_t));
+    }
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
     printf("\nPerforming continuous AES encryptions...\n");
     printf("Monitor this process with perf_spy to observe cache patterns\n\n");
-    
+
     // Continuous encryption loop
     unsigned long iterations = 0;
-    while (1) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (!stop_requested && (max_iterations == 0 || iterations < max_iterations)) {
         // Generate random plaintext
         for (int i = 0; i < BLOCK_SIZE; i++) {
             plaintext[i] = rand() & 0xFF;
         }
-        
-        // Perform AES encryption (table-based, vulnerable to cache timing)
+
+        // Perform AES encryption (table-based, vulnerable to cache timing);
+        // with -r the same call is timestamped and published to the ring
+        uint64_t t_begin = ring_name ? cc_timestamp() : 0;
         AES_encrypt(plaintext, ciphertext, &enc_key);
-        
+        if (ring_name) {
+            uint64_t t_end = cc_timestamp();
+            sr_victim_rec_t *rec = sr_claim(&ring);
+            rec->seq = iterations;
+            rec->t_begin = t_begin;
+            rec->t_end = t_end;
+            memcpy(rec->plaintext, plaintext, BLOCK_SIZE);
+            memcpy(rec->ciphertext, ciphertext, BLOCK_SIZE);
+            sr_publish(&ring);
+        }
+
         iterations++;
         if (iterations % 100000 == 0) {
             printf("Iterations: %lu\r", iterations);
             fflush(stdout);
         }
-        
+
         // Small delay to make cache observations easier
-        usleep(10);
+        if (delay_us > 0) {
+            usleep(delay_us);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double sec = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("\nEncryptions: %lu in %.2f s (%.0f ops/s)\n", iterations, sec, sec > 0 ? iterations / sec : 0.0);
+
+    if (ring_name) {
+        sr_close(&ring);
     }
-    
+
     return 0;
 }
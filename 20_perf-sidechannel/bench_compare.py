@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""
+bench_compare.py
+
+Regression check for the JSON results written by the benchmark programs
+(-j, or -o for aes_victim -b; see bench_json.h). Every metric present in
+both the baseline and the current results is tested with Welch's t-test
+on its trials; a change is reported when it is both statistically
+significant (p < alpha) and larger than a relative threshold. The
+threshold matters: trials from one process do not see run-to-run noise
+(clock frequency, page placement), which on a shared or virtual host can
+exceed the spread within a run. Whether a change is a regression follows
+the metric's "better" direction; "none" metrics are reported but never
+fail the check.
+
+Arguments are result files, or directories whose *.json files are paired
+by name (the layout `make bench` writes). Exit status is 1 when any metric
+regressed, 2 when the inputs cannot be read, 0 otherwise.
+
+Usage:
+    python3 bench_compare.py base.json cur.json --alpha 0.01 --threshold 0.05
+    python3 bench_compare.py results/baseline results/current -v
+"""
+
+import argparse
+import json
+import math
+import os
+import sys
+
+FORMAT = 'bench-json/1'
+
+# Host fields that must match for a comparison to mean anything
+HOST_KEYS = ('cpu_model', 'cpuinfo', 'online_cpus', 'kernel', 'governor')
+
+
+def load(path):
+    with open(path) as f:
+        doc = json.load(f)
+    if doc.get('format') != FORMAT:
+        raise ValueError(f"{path}: not a {FORMAT} document")
+    return doc
+
+
+def pair_inputs(baseline, current):
+    """Return [(name, baseline file, current file)]; a file pairs with a file"""
+    if os.path.isdir(baseline) != os.path.isdir(current):
+        raise ValueError("compare a file with a file, or a directory with a directory")
+    if not os.path.isdir(baseline):
+        return [(os.path.basename(current), baseline, current)]
+    names = sorted(set(f for f in os.listdir(baseline) if f.endswith('.json')) |
+                   set(f for f in os.listdir(current) if f.endswith('.json')))
+    return [(n, os.path.join(baseline, n), os.path.join(current, n)) for n in names]
+
+
+def _betacf(a, b, x):
+    """Continued fraction of the incomplete beta function (modified Lentz)"""
+    tiny = 1e-300
+    c, d = 1.0, 1.0 - (a + b) * x / (a + 1.0)
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    h = d
+    for m in range(1, 300):
+        m2 = 2 * m
+        for num in (m * (b - m) * x / ((a + m2 - 1) * (a + m2)),
+                    -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1))):
+            d = 1.0 + num * d
+            d = 1.0 / (d if abs(d) > tiny else tiny)
+            c = 1.0 + num / c
+            c = c if abs(c) > tiny else tiny
+            h *= d * c
+        if abs(d * c - 1.0) < 1e-12:
+            break
+    return h
+
+
+def betainc(a, b, x):
+    """Regularized incomplete beta function I_x(a, b)"""
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    front = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) +
+                     a * math.log(x) + b * math.log1p(-x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return front * _betacf(a, b, x) / a
+    return 1.0 - front * _betacf(b, a, 1.0 - x) / b
+
+
+def welch(base, cur):
+    """Two-sided Welch t-test on two metric summaries; returns (t, df, p)"""
+    na, nb = base['n'], cur['n']
+    va, vb = base['stddev'] ** 2 / na, cur['stddev'] ** 2 / nb
+    diff = cur['mean'] - base['mean']
+    if va + vb == 0.0:
+        return (0.0, 0.0, 1.0) if diff == 0 else (math.copysign(math.inf, diff), 0.0, 0.0)
+    t = diff / math.sqrt(va + vb)
+    df = (va + vb) ** 2 / (va ** 2 / (na - 1) + vb ** 2 / (nb - 1))
+    return t, df, betainc(df / 2.0, 0.5, df / (df + t * t))
+
+
+def relative_change(base_mean, cur_mean):
+    if base_mean == 0:
+        return 0.0 if cur_mean == 0 else math.copysign(math.inf, cur_mean)
+    return (cur_mean - base_mean) / abs(base_mean)
+
+
+def verdict(base, cur, alpha, threshold):
+    """Return (status, change, p); status is one of regression, improved,
+    changed (significant, direction "none"), same, untested (fewer than two
+    trials on a side)"""
+    change = relative_change(base['mean'], cur['mean'])
+    if base['n'] < 2 or cur['n'] < 2:
+        return ('untested' if abs(change) >= threshold else 'same'), change, None
+    _, _, p = welch(base, cur)
+    if p >= alpha or abs(change) < threshold:
+        return 'same', change, p
+    if cur['better'] == 'none':
+        return 'changed', change, p
+    worse = change > 0 if cur['better'] == 'lower' else change < 0
+    return ('regression' if worse else 'improved'), change, p
+
+
+def host_differences(base, cur):
+    hb, hc = base.get('host', {}), cur.get('host', {})
+    return [k for k in HOST_KEYS if hb.get(k) != hc.get(k)]
+
+
+def format_mean(m):
+    half = (m['ci95'][1] - m['ci95'][0]) / 2 if m['ci95'][0] is not None else 0.0
+    return f"{m['mean']:.4g} ±{half:.2g}"
+
+
+def compare(name, base, cur, args):
+    """Print one benchmark's comparison; returns the number of regressions"""
+    print(f"=== {name}: {base['benchmark']} ({base['timestamp']} -> {cur['timestamp']}) ===")
+    diffs = host_differences(base, cur)
+    if diffs:
+        print(f"warning: hosts differ in {', '.join(diffs)}; "
+              f"{base['host'].get('cpu_model')} vs {cur['host'].get('cpu_model')}")
+
+    before = {m['name']: m for m in base['metrics']}
+    after = {m['name']: m for m in cur['metrics']}
+    counts = {}
+    rows = []
+    for metric in before.keys() | after.keys():
+        if metric not in after or metric not in before:
+            status, change, p = ('missing' if metric not in after else 'new'), None, None
+        else:
+            status, change, p = verdict(before[metric], after[metric], args.alpha, args.threshold)
+        counts[status] = counts.get(status, 0) + 1
+        if status != 'same' or args.verbose:
+            rows.append((metric, status, change, p))
+
+    order = ('regression', 'improved', 'changed', 'untested', 'missing', 'new', 'same')
+    rows.sort(key=lambda r: (order.index(r[1]), r[0]))
+    if rows:
+        width = max(len(r[0]) for r in rows)
+        print(f"{'metric':<{width}} {'baseline':>20} {'current':>20} {'change':>9} {'p':>9}  verdict")
+    for metric, status, change, p in rows:
+        b = format_mean(before[metric]) if metric in before else '-'
+        c = format_mean(after[metric]) if metric in after else '-'
+        ch = f"{change * 100:+.1f}%" if change is not None else '-'
+        pv = f"{p:.2g}" if p is not None else '-'
+        unit = (after.get(metric) or before[metric])['unit']
+        print(f"{metric:<{width}} {b:>20} {c:>20} {ch:>9} {pv:>9}  {status} [{unit}]")
+    print(', '.join(f"{counts[s]} {s}" for s in order if s in counts) or 'no metrics')
+    print()
+    return counts.get('regression', 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flag significant regressions between benchmark results")
+    parser.add_argument('baseline', help="baseline results file or directory")
+    parser.add_argument('current', help="current results file or directory")
+    parser.add_argument('--alpha', type=float, default=0.01,
+                        help="significance level of the Welch t-test (default 0.01)")
+    parser.add_argument('--threshold', type=float, default=0.05,
+                        help="smallest relative change reported (default 0.05 = 5%%)")
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help="list unchanged metrics too")
+    args = parser.parse_args()
+
+    try:
+        pairs = pair_inputs(args.baseline, args.current)
+    except (OSError, ValueError) as e:
+        print(f"error: {e}", file=sys.stderr)
+        sys.exit(2)
+
+    regressions = 0
+    for name, base_path, cur_path in pairs:
+        if not os.path.exists(base_path) or not os.path.exists(cur_path):
+            print(f"=== {name}: only in {'current' if os.path.exists(cur_path) else 'baseline'} ===\n")
+            continue
+        try:
+            base, cur = load(base_path), load(cur_path)
+        except (OSError, ValueError) as e:
+            print(f"error: {e}", file=sys.stderr)
+            sys.exit(2)
+        regressions += compare(name, base, cur, args)
+
+    if regressions:
+        print(f"{regressions} regression(s)")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
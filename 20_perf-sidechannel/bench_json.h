@@ -0,0 +1,381 @@
+/**
+ * bench_json.h
+ *
+ * Machine-readable benchmark results. A program records every trial of
+ * every metric under a stable name (e.g. "latency/32.0KB/ns_per_load");
+ * bench_write() then dumps them as one JSON document with host and CPU
+ * metadata and, per metric, the raw samples with mean, standard deviation
+ * and a 95% Student-t confidence interval. bench_compare.py tests two such
+ * documents against each other.
+ *
+ *   {
+ *     "format": "bench-json/1",
+ *     "benchmark": "aes_bulk_bench",
+ *     "command": "./aes_bulk_bench -r 10 -j aes.json",
+ *     "timestamp": "2026-01-01T12:00:00Z",
+ *     "host": { "hostname", "kernel", "machine", "cpu_model", "cpuinfo": {...},
+ *               "online_cpus", "governor", "caches": {...}, "compiler" },
+ *     "metrics": [
+ *       { "name", "unit", "better": "lower" | "higher" | "none",
+ *         "n", "mean", "stddev", "ci95": [lo, hi], "median", "min", "max",
+ *         "samples": [...] }
+ *     ]
+ *   }
+ *
+ * Metrics are kept in memory for the whole run, so a program can also
+ * print its tables from bench_summarize() instead of a single trial.
+ */
+
+#ifndef BENCH_JSON_H
+#define BENCH_JSON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "online_stats.h"
+
+#define BENCH_NAME_LEN 128
+#define BENCH_COMMAND_LEN 512
+
+// Which direction of change is a regression for bench_compare.py
+typedef enum {
+    BENCH_LOWER,        // Latency, time, misses: lower is better
+    BENCH_HIGHER,       // Throughput, IPC: higher is better
+    BENCH_INFO,         // Recorded, never flagged
+} bench_better_t;
+
+typedef struct {
+    char name[BENCH_NAME_LEN];
+    const char *unit;           // String literal
+    bench_better_t better;
+    double *samples;
+    size_t n, cap;
+} bench_metric_t;
+
+typedef struct {
+    const char *benchmark;
+    char command[BENCH_COMMAND_LEN];
+    time_t started;
+    bench_metric_t *metrics;
+    size_t n, cap;
+} bench_results_t;
+
+typedef struct {
+    size_t n;
+    double mean, stddev;
+    double ci_low, ci_high;     // 95% confidence interval of the mean
+    double median, min, max;
+} bench_summary_t;
+
+static inline void bench_init(bench_results_t *r, const char *benchmark, int argc, char **argv) {
+    size_t len = 0;
+
+    memset(r, 0, sizeof(*r));
+    r->benchmark = benchmark;
+    r->started = time(NULL);
+    for (int i = 0; i < argc; i++) {
+        int n = snprintf(r->command + len, sizeof(r->command) - len, "%s%s", i ? " " : "", argv[i]);
+        if (n < 0 || (size_t)n >= sizeof(r->command) - len) break;
+        len += n;
+    }
+}
+
+static inline void bench_free(bench_results_t *r) {
+    for (size_t i = 0; i < r->n; i++) {
+        free(r->metrics[i].samples);
+    }
+    free(r->metrics);
+    r->metrics = NULL;
+    r->n = r->cap = 0;
+}
+
+static inline bench_metric_t *bench_find(bench_results_t *r, const char *name) {
+    for (size_t i = 0; i < r->n; i++) {
+        if (strcmp(r->metrics[i].name, name) == 0) return &r->metrics[i];
+    }
+    return NULL;
+}
+
+// Appends one trial of the metric named by fmt, creating it on first use.
+// Returns -1 when out of memory.
+static inline int bench_record(bench_results_t *r, const char *unit, bench_better_t better,
+                               double value, const char *fmt, ...)
+    __attribute__((format(printf, 5, 6)));
+
+static inline int bench_record(bench_results_t *r, const char *unit, bench_better_t better,
+                               double value, const char *fmt, ...) {
+    char name[BENCH_NAME_LEN];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(name, sizeof(name), fmt, ap);
+    va_end(ap);
+
+    bench_metric_t *m = bench_find(r, name);
+    if (!m) {
+        if (r->n == r->cap) {
+            size_t cap = r->cap ? r->cap * 2 : 32;
+            bench_metric_t *grown = realloc(r->metrics, cap * sizeof(*grown));
+            if (!grown) return -1;
+            r->metrics = grown;
+            r->cap = cap;
+        }
+        m = &r->metrics[r->n++];
+        memset(m, 0, sizeof(*m));
+        memcpy(m->name, name, sizeof(name));
+        m->unit = unit;
+        m->better = better;
+    }
+    if (m->n == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 16;
+        double *grown = realloc(m->samples, cap * sizeof(*grown));
+        if (!grown) return -1;
+        m->samples = grown;
+        m->cap = cap;
+    }
+    m->samples[m->n++] = value;
+    return 0;
+}
+
+// Two-sided 95% Student-t critical value: exact table to 30 degrees of
+// freedom, then the Cornish-Fisher expansion around the normal quantile
+static inline double bench_t95(size_t df) {
+    static const double table[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    const double z = 1.959964;
+
+    if (df == 0) return INFINITY;
+    if (df <= 30) return table[df - 1];
+    return z + (z * z * z + z) / (4.0 * df) +
+           (5 * pow(z, 5) + 16 * z * z * z + 3 * z) / (96.0 * df * df);
+}
+
+static inline int bench_compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Returns -1 for a metric without samples (or out of memory for the median)
+static inline int bench_summarize(const bench_metric_t *m, bench_summary_t *s) {
+    welford_t w;
+    double *sorted;
+
+    memset(s, 0, sizeof(*s));
+    if (!m || m->n == 0 || !(sorted = malloc(m->n * sizeof(double)))) return -1;
+
+    welford_init(&w);
+    for (size_t i = 0; i < m->n; i++) {
+        welford_push(&w, m->samples[i]);
+    }
+    memcpy(sorted, m->samples, m->n * sizeof(double));
+    qsort(sorted, m->n, sizeof(double), bench_compare_double);
+
+    s->n = m->n;
+    s->mean = w.mean;
+    s->stddev = sqrt(welford_variance(&w));
+    double half = m->n > 1 ? bench_t95(m->n - 1) * s->stddev / sqrt((double)m->n) : 0.0;
+    s->ci_low = s->mean - half;
+    s->ci_high = s->mean + half;
+    s->median = m->n % 2 ? sorted[m->n / 2] : (sorted[m->n / 2 - 1] + sorted[m->n / 2]) / 2;
+    s->min = sorted[0];
+    s->max = sorted[m->n - 1];
+    free(sorted);
+    return 0;
+}
+
+// ============================================================================
+// JSON output
+// ============================================================================
+
+static inline void bench_json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+// JSON has no NaN or infinity
+static inline void bench_json_number(FILE *fp, double v) {
+    if (isfinite(v)) {
+        fprintf(fp, "%.10g", v);
+    } else {
+        fputs("null", fp);
+    }
+}
+
+// First line of a sysfs/procfs file without the newline; 0 on success
+static inline int bench_read_line(const char *path, char *buf, size_t len) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    int ok = fgets(buf, (int)len, fp) != NULL;
+    fclose(fp);
+    if (!ok) return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// Identification fields of the first CPU in /proc/cpuinfo (x86 and ARM
+// spell them differently; whichever exist are copied)
+static const char *const bench_cpuinfo_keys[] = {
+    "vendor_id", "cpu family", "model", "stepping", "microcode",
+    "CPU implementer", "CPU architecture", "CPU variant", "CPU part", "CPU revision",
+};
+#define BENCH_CPUINFO_KEYS (sizeof(bench_cpuinfo_keys) / sizeof(bench_cpuinfo_keys[0]))
+
+static inline void bench_write_host(FILE *fp) {
+    char values[BENCH_CPUINFO_KEYS][64] = {{0}};
+    char model[128] = "", hostname[256] = "", line[256];
+    struct utsname uts;
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+
+    if (cpuinfo) {
+        while (fgets(line, sizeof(line), cpuinfo)) {
+            char *colon = strchr(line, ':');
+            if (!colon) continue;
+            char *end = colon;
+            while (end > line && (end[-1] == ' ' || end[-1] == '\t')) end--;
+            *end = '\0';
+            char *value = colon + 1 + strspn(colon + 1, " \t");
+            value[strcspn(value, "\n")] = '\0';
+
+            // "model name" on x86; "Model" or "Hardware" on ARM boards
+            if (!model[0] && (!strcmp(line, "model name") || !strcmp(line, "Model") ||
+                              !strcmp(line, "Hardware"))) {
+                snprintf(model, sizeof(model), "%s", value);
+            }
+            for (size_t k = 0; k < BENCH_CPUINFO_KEYS; k++) {
+                if (!values[k][0] && !strcmp(line, bench_cpuinfo_keys[k])) {
+                    snprintf(values[k], sizeof(values[k]), "%s", value);
+                }
+            }
+        }
+        fclose(cpuinfo);
+    }
+    if (uname(&uts) != 0) memset(&uts, 0, sizeof(uts));
+    if (!model[0]) snprintf(model, sizeof(model), "%s", uts.machine);
+    gethostname(hostname, sizeof(hostname) - 1);
+
+    fprintf(fp, "  \"host\": {\n    \"hostname\": ");
+    bench_json_string(fp, hostname);
+    fprintf(fp, ",\n    \"kernel\": ");
+    snprintf(line, sizeof(line), "%s %s", uts.sysname, uts.release);
+    bench_json_string(fp, line);
+    fprintf(fp, ",\n    \"machine\": ");
+    bench_json_string(fp, uts.machine);
+    fprintf(fp, ",\n    \"cpu_model\": ");
+    bench_json_string(fp, model);
+    fprintf(fp, ",\n    \"cpuinfo\": {");
+    for (size_t k = 0, first = 1; k < BENCH_CPUINFO_KEYS; k++) {
+        if (!values[k][0]) continue;
+        fprintf(fp, "%s", first ? "" : ", ");
+        bench_json_string(fp, bench_cpuinfo_keys[k]);
+        fprintf(fp, ": ");
+        bench_json_string(fp, values[k]);
+        first = 0;
+    }
+    fprintf(fp, "},\n    \"online_cpus\": %ld", sysconf(_SC_NPROCESSORS_ONLN));
+
+    fprintf(fp, ",\n    \"governor\": ");
+    if (bench_read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", line, sizeof(line)) == 0) {
+        bench_json_string(fp, line);
+    } else {
+        fputs("null", fp);
+    }
+
+    // cpu0's caches, labelled the way lscpu does: L1d, L1i, L2, L3
+    fprintf(fp, ",\n    \"caches\": {");
+    for (int i = 0, first = 1; i < 16; i++) {
+        char path[96], level[16], type[32], size[32], label[48];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+        if (bench_read_line(path, level, sizeof(level)) != 0) break;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+        if (bench_read_line(path, type, sizeof(type)) != 0) continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+        if (bench_read_line(path, size, sizeof(size)) != 0) continue;
+        snprintf(label, sizeof(label), "L%s%s", level,
+                 !strcmp(type, "Data") ? "d" : !strcmp(type, "Instruction") ? "i" : "");
+        fprintf(fp, "%s", first ? "" : ", ");
+        bench_json_string(fp, label);
+        fprintf(fp, ": ");
+        bench_json_string(fp, size);
+        first = 0;
+    }
+    fprintf(fp, "},\n    \"compiler\": ");
+#ifdef __VERSION__
+    bench_json_string(fp, __VERSION__);
+#else
+    fputs("null", fp);
+#endif
+    fprintf(fp, "\n  },\n");
+}
+
+// Writes all metrics to path ("-" for stdout); -1 with errno set on failure
+static inline int bench_write(const bench_results_t *r, const char *path) {
+    static const char *const better_names[] = { "lower", "higher", "none" };
+    FILE *fp = strcmp(path, "-") ? fopen(path, "w") : stdout;
+    char stamp[32];
+
+    if (!fp) return -1;
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&r->started));
+
+    fprintf(fp, "{\n  \"format\": \"bench-json/1\",\n  \"benchmark\": ");
+    bench_json_string(fp, r->benchmark);
+    fprintf(fp, ",\n  \"command\": ");
+    bench_json_string(fp, r->command);
+    fprintf(fp, ",\n  \"timestamp\": \"%s\",\n", stamp);
+    bench_write_host(fp);
+
+    fprintf(fp, "  \"metrics\": [");
+    for (size_t i = 0; i < r->n; i++) {
+        const bench_metric_t *m = &r->metrics[i];
+        bench_summary_t s;
+        if (bench_summarize(m, &s) != 0) continue;
+
+        fprintf(fp, "%s\n    {\"name\": ", i ? "," : "");
+        bench_json_string(fp, m->name);
+        fprintf(fp, ", \"unit\": ");
+        bench_json_string(fp, m->unit);
+        fprintf(fp, ", \"better\": \"%s\", \"n\": %zu,\n     \"mean\": ", better_names[m->better], s.n);
+        bench_json_number(fp, s.mean);
+        fprintf(fp, ", \"stddev\": ");
+        bench_json_number(fp, s.stddev);
+        fprintf(fp, ", \"ci95\": [");
+        bench_json_number(fp, s.ci_low);
+        fprintf(fp, ", ");
+        bench_json_number(fp, s.ci_high);
+        fprintf(fp, "], \"median\": ");
+        bench_json_number(fp, s.median);
+        fprintf(fp, ", \"min\": ");
+        bench_json_number(fp, s.min);
+        fprintf(fp, ", \"max\": ");
+        bench_json_number(fp, s.max);
+        fprintf(fp, ",\n     \"samples\": [");
+        for (size_t k = 0; k < m->n; k++) {
+            if (k) fprintf(fp, k % 16 ? ", " : ",\n                 ");
+            bench_json_number(fp, m->samples[k]);
+        }
+        fprintf(fp, "]}");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+
+    if (fp == stdout) return fflush(fp) == 0 ? 0 : -1;
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+#endif // BENCH_JSON_H
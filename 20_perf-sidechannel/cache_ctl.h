@@ -0,0 +1,267 @@
+/*
+ * Cache Control Primitives
+ * Targeted eviction and cache probing for the side-channel demos:
+ *   - cycle timestamps (rdtscp on x86, cntvct_el0 on ARM64)
+ *   - flushing individual lines (clflushopt/clflush, dc civac)
+ *   - L1D eviction sets built from the cache geometry
+ *   - Flush+Reload and Prime+Probe measurements
+ *
+ * Flushing the handful of lines that matter (e.g. the 4 lines of the AES
+ * S-box) replaces sweeping megabytes of memory, which is slow and evicts
+ * the measurement harness along with the target.
+ */
+
+#ifndef CACHE_CTL_H
+#define CACHE_CTL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define CC_HAVE_FLUSH 1
+#elif defined(__aarch64__)
+#define CC_HAVE_FLUSH 1
+#else
+#define CC_HAVE_FLUSH 0
+#endif
+
+#define CC_LINE_SIZE 64
+#define CC_MAX_EVSET 32
+
+// ============================================================================
+// Timestamps
+// ============================================================================
+
+// Serialized timestamp: earlier loads complete before the read, later
+// instructions do not start before it. Units are TSC cycles on x86 and
+// generic-timer ticks on ARM64 (see cc_timestamp_hz()).
+static inline uint64_t cc_timestamp(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+#elif defined(__aarch64__)
+    uint64_t t;
+    __asm__ volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(t) :: "memory");
+    return t;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// Timestamp ticks per second, measured once against CLOCK_MONOTONIC_RAW
+static inline double cc_timestamp_hz(void) {
+    static double hz;
+    if (hz == 0.0) {
+#if defined(__aarch64__)
+        uint64_t freq;
+        __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+        hz = (double)freq;
+#else
+        struct timespec a, b, pause = { 0, 20 * 1000 * 1000 };
+        clock_gettime(CLOCK_MONOTONIC_RAW, &a);
+        uint64_t t0 = cc_timestamp();
+        nanosleep(&pause, NULL);
+        uint64_t t1 = cc_timestamp();
+        clock_gettime(CLOCK_MONOTONIC_RAW, &b);
+        double sec = (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+        hz = (t1 - t0) / sec;
+#endif
+    }
+    return hz;
+}
+
+// Ticks between two cc_timestamp() reads in nanoseconds. Call
+// cc_timestamp_hz() once before starting threads: it calibrates lazily.
+static inline double cc_ticks_to_ns(uint64_t ticks) {
+    return ticks * 1e9 / cc_timestamp_hz();
+}
+
+// ============================================================================
+// Line flushing
+// ============================================================================
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline int cc_has_clflushopt(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        unsigned int eax, ebx, ecx, edx;
+        cached = __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 23));
+    }
+    return cached;
+}
+
+__attribute__((target("clflushopt")))
+static inline void cc_clflushopt(const void *p) {
+    _mm_clflushopt((void *)p);
+}
+#endif
+
+// Evict one line from every cache level (no ordering; see cc_flush_range)
+static inline void cc_flush_line(const void *p) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (cc_has_clflushopt()) {
+        cc_clflushopt(p);
+    } else {
+        _mm_clflush(p);
+    }
+#elif defined(__aarch64__)
+    __asm__ volatile("dc civac, %0" :: "r"(p) : "memory");
+#else
+    (void)p;
+#endif
+}
+
+// Wait until previously issued flushes and loads have completed
+static inline void cc_fence(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_mfence();
+#elif defined(__aarch64__)
+    __asm__ volatile("dsb ish\n\tisb" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
+// Flush every line overlapping [addr, addr + len)
+static inline void cc_flush_range(const void *addr, size_t len) {
+    uintptr_t p = (uintptr_t)addr & ~(uintptr_t)(CC_LINE_SIZE - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+
+    for (; p < end; p += CC_LINE_SIZE) {
+        cc_flush_line((const void *)p);
+    }
+    cc_fence();
+}
+
+// ============================================================================
+// Flush+Reload
+// ============================================================================
+
+// Time a single load of addr
+static inline uint64_t cc_time_access(const void *addr) {
+    uint64_t t0 = cc_timestamp();
+    *(volatile const uint8_t *)addr;
+    uint64_t t1 = cc_timestamp();
+    return t1 - t0;
+}
+
+// Reload addr, report its latency, and flush it again for the next round.
+// A latency below the hit threshold means someone touched the line since
+// the previous flush.
+static inline uint64_t cc_flush_reload(const void *addr) {
+    uint64_t t = cc_time_access(addr);
+    cc_flush_line(addr);
+    cc_fence();
+    return t;
+}
+
+// Hit/miss threshold: midpoint of the median cached and flushed latencies
+static inline uint64_t cc_calibrate_threshold(void) {
+    enum { N = 1001 };
+    static uint8_t probe[2 * CC_LINE_SIZE] __attribute__((aligned(CC_LINE_SIZE)));
+    uint64_t hit[N], miss[N];
+
+    for (int i = 0; i < N; i++) {
+        *(volatile uint8_t *)probe;
+        hit[i] = cc_time_access(probe);
+        cc_flush_range(probe, 1);
+        miss[i] = cc_time_access(probe);
+    }
+    // Partial selection sort up to the median is plenty for N = 1001
+    for (int i = 0; i <= N / 2; i++) {
+        for (int j = i + 1; j < N; j++) {
+            if (hit[j] < hit[i]) { uint64_t t = hit[i]; hit[i] = hit[j]; hit[j] = t; }
+            if (miss[j] < miss[i]) { uint64_t t = miss[i]; miss[i] = miss[j]; miss[j] = t; }
+        }
+    }
+    return (hit[N / 2] + miss[N / 2]) / 2;
+}
+
+// ============================================================================
+// Prime+Probe (L1D)
+// ============================================================================
+
+typedef struct {
+    int ways;                    // Lines in the set
+    void *lines[CC_MAX_EVSET];   // Linked list: each line stores the next pointer
+    void *pool;                  // Backing memory
+} cc_evset_t;
+
+// L1D geometry: line size, associativity and set stride (sets * line size)
+static inline void cc_l1d_geometry(int *ways, size_t *stride) {
+    long size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    long assoc = sysconf(_SC_LEVEL1_DCACHE_ASSOC);
+
+    if (size <= 0 || assoc <= 0) {
+        size = 32 * 1024;  // Common default: 32 KB, 8-way
+        assoc = 8;
+    }
+    *ways = (int)assoc;
+    *stride = (size_t)(size / assoc);
+}
+
+// Build a minimal eviction set for the L1D set holding target: 'ways' lines
+// whose addresses are congruent to target modulo the set stride. L1D is
+// virtually indexed within the page offset, so no physical addresses are
+// needed. The lines are chained so probing is a dependent pointer chase.
+static inline int cc_evset_build(cc_evset_t *ev, const void *target) {
+    size_t stride;
+    int ways;
+
+    cc_l1d_geometry(&ways, &stride);
+    if (ways > CC_MAX_EVSET) ways = CC_MAX_EVSET;
+
+    ev->pool = aligned_alloc(stride, stride * (ways + 1));
+    if (!ev->pool) {
+        return -1;
+    }
+    ev->ways = ways;
+
+    size_t offset = (uintptr_t)target % stride & ~(size_t)(CC_LINE_SIZE - 1);
+    for (int w = 0; w < ways; w++) {
+        ev->lines[w] = (uint8_t *)ev->pool + (size_t)w * stride + offset;
+    }
+    for (int w = 0; w < ways; w++) {
+        *(void **)ev->lines[w] = ev->lines[(w + 1) % ways];
+    }
+    return 0;
+}
+
+static inline void cc_evset_free(cc_evset_t *ev) {
+    free(ev->pool);
+    ev->pool = NULL;
+    ev->ways = 0;
+}
+
+// Fill the set with our own lines
+static inline void cc_prime(const cc_evset_t *ev) {
+    void *p = ev->lines[0];
+    for (int w = 0; w < ev->ways; w++) {
+        p = *(void **)p;
+    }
+    __asm__ volatile("" :: "r"(p));
+}
+
+// Walk the set again and time it: every line the victim displaced since
+// cc_prime() costs a miss, so a slower probe means the set was used
+static inline uint64_t cc_probe(const cc_evset_t *ev) {
+    uint64_t t0 = cc_timestamp();
+    void *p = ev->lines[0];
+    for (int w = 0; w < ev->ways; w++) {
+        p = *(void **)p;
+    }
+    __asm__ volatile("" :: "r"(p));
+    return cc_timestamp() - t0;
+}
+
+#endif // CACHE_CTL_H
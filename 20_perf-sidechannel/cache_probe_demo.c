@@ -0,0 +1,203 @@
+/*
+ * Cache Probe Demo
+ * Exercises the cache_ctl.h primitives against the simple_aes S-box:
+ *   1. Flush+Reload: which S-box lines does one encryption touch?
+ *   2. Prime+Probe: does an encryption disturb the L1D set of the S-box?
+ *   3. Eviction cost: flushing the S-box lines vs sweeping 8 MB
+ *
+ * -j writes every trial as JSON results (bench_json.h): per-line hit rates,
+ * probe times and eviction costs in timestamp ticks.
+ *
+ * Compile: make cache_probe_demo
+ * Run: ./cache_probe_demo [-j results.json] [trials]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "simple_aes.h"
+#include "cache_ctl.h"
+#include "bench_json.h"
+
+#define DEFAULT_TRIALS 1000
+#define SWEEP_SIZE (8 * 1024 * 1024)
+#define SBOX_LINES ((sizeof(sbox) + CC_LINE_SIZE - 1) / CC_LINE_SIZE)
+
+static const uint8_t demo_key[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static bench_results_t results;
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t median(uint64_t *v, int n) {
+    qsort(v, n, sizeof(*v), cmp_u64);
+    return v[n / 2];
+}
+
+static void demo_flush_reload(SimpleAES_CTX *ctx, int trials, uint64_t threshold) {
+    const uint8_t *line0 = (const uint8_t *)((uintptr_t)sbox & ~(uintptr_t)(CC_LINE_SIZE - 1));
+    int hits_idle[SBOX_LINES + 1] = {0};
+    int hits_enc[SBOX_LINES + 1] = {0};
+    int samples[SBOX_LINES + 1] = {0};
+    uint8_t pt[AES_BLOCK_SIZE] = {0}, ct[AES_BLOCK_SIZE];
+    int nlines = (int)(((uintptr_t)(sbox + sizeof(sbox) - 1) - (uintptr_t)line0) / CC_LINE_SIZE) + 1;
+
+    printf("\n--- Flush+Reload on %d S-box lines (threshold %lu ticks) ---\n",
+           nlines, (unsigned long)threshold);
+
+    // One line is reloaded per window, rotating through the lines, so the
+    // reload itself cannot pull its neighbours in through the prefetcher
+    for (int t = 0; t < trials * nlines; t++) {
+        int l = t % nlines;
+        const uint8_t *line = line0 + l * CC_LINE_SIZE;
+
+        // Idle window: nothing should touch the line
+        cc_flush_range(line0, nlines * CC_LINE_SIZE);
+        int idle_hit = cc_flush_reload(line) < threshold;
+        hits_idle[l] += idle_hit;
+
+        // Victim window: one encryption
+        cc_flush_range(line0, nlines * CC_LINE_SIZE);
+        pt[0] = (uint8_t)t;
+        simple_aes_encrypt(ctx, pt, ct);
+        int enc_hit = cc_flush_reload(line) < threshold;
+        hits_enc[l] += enc_hit;
+        samples[l]++;
+        bench_record(&results, "%", BENCH_INFO, 100.0 * idle_hit, "flush_reload/line=%d/idle_hit_pct", l);
+        bench_record(&results, "%", BENCH_INFO, 100.0 * enc_hit, "flush_reload/line=%d/encrypt_hit_pct", l);
+    }
+
+    printf("%-6s %-14s %-14s\n", "Line", "Idle hits", "Encrypt hits");
+    for (int l = 0; l < nlines; l++) {
+        printf("%-6d %6.1f%%        %6.1f%%\n", l,
+               100.0 * hits_idle[l] / samples[l], 100.0 * hits_enc[l] / samples[l]);
+    }
+}
+
+static void demo_prime_probe(SimpleAES_CTX *ctx, int trials) {
+    cc_evset_t ev;
+    uint64_t *idle = malloc(trials * sizeof(uint64_t));
+    uint64_t *busy = malloc(trials * sizeof(uint64_t));
+    uint8_t pt[AES_BLOCK_SIZE] = {0}, ct[AES_BLOCK_SIZE];
+
+    if (!idle || !busy || cc_evset_build(&ev, sbox) != 0) {
+        fprintf(stderr, "Prime+Probe setup failed\n");
+        free(idle);
+        free(busy);
+        return;
+    }
+
+    printf("\n--- Prime+Probe on the L1D set of sbox[0] (%d-way) ---\n", ev.ways);
+    for (int t = 0; t < trials; t++) {
+        cc_prime(&ev);
+        idle[t] = cc_probe(&ev);
+
+        cc_prime(&ev);
+        pt[0] = (uint8_t)t;
+        simple_aes_encrypt(ctx, pt, ct);
+        busy[t] = cc_probe(&ev);
+    }
+    for (int t = 0; t < trials; t++) {
+        bench_record(&results, "ticks", BENCH_INFO, idle[t], "prime_probe/idle_probe");
+        bench_record(&results, "ticks", BENCH_INFO, busy[t], "prime_probe/encrypt_probe");
+    }
+    printf("Median probe time, idle:          %lu ticks\n", (unsigned long)median(idle, trials));
+    printf("Median probe time, after encrypt: %lu ticks\n", (unsigned long)median(busy, trials));
+
+    cc_evset_free(&ev);
+    free(idle);
+    free(busy);
+}
+
+static void demo_eviction_cost(int trials) {
+    volatile char *buffer = malloc(SWEEP_SIZE);
+    uint64_t *targeted = malloc(trials * sizeof(uint64_t));
+    uint64_t *sweep = malloc(trials * sizeof(uint64_t));
+    int sweeps = trials < 100 ? trials : 100;
+
+    if (!buffer || !targeted || !sweep) {
+        fprintf(stderr, "Out of memory\n");
+        goto out;
+    }
+
+    for (int t = 0; t < trials; t++) {
+        uint64_t t0 = cc_timestamp();
+        cc_flush_range(sbox, sizeof(sbox));
+        targeted[t] = cc_timestamp() - t0;
+    }
+    for (int t = 0; t < sweeps; t++) {
+        uint64_t t0 = cc_timestamp();
+        for (int i = 0; i < SWEEP_SIZE; i += CC_LINE_SIZE) buffer[i] = i;
+        sweep[t] = cc_timestamp() - t0;
+    }
+
+    for (int t = 0; t < trials; t++) {
+        bench_record(&results, "ticks", BENCH_LOWER, targeted[t], "eviction/clflush_sbox");
+    }
+    for (int t = 0; t < sweeps; t++) {
+        bench_record(&results, "ticks", BENCH_LOWER, sweep[t], "eviction/sweep_8MB");
+    }
+
+    uint64_t m_targeted = median(targeted, trials);
+    uint64_t m_sweep = median(sweep, sweeps);
+    printf("\n--- Eviction cost (median) ---\n");
+    printf("clflush S-box lines: %10lu ticks\n", (unsigned long)m_targeted);
+    printf("8 MB sweep:          %10lu ticks (%.0fx)\n", (unsigned long)m_sweep,
+           m_targeted ? (double)m_sweep / m_targeted : 0.0);
+
+out:
+    free((void *)buffer);
+    free(targeted);
+    free(sweep);
+}
+
+int main(int argc, char *argv[]) {
+    const char *json_path = NULL;
+    SimpleAES_CTX ctx;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:h")) != -1) {
+        switch (opt) {
+        case 'j': json_path = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-j results.json] [trials]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    int trials = optind < argc ? atoi(argv[optind]) : DEFAULT_TRIALS;
+    if (trials < 1) {
+        fprintf(stderr, "Usage: %s [-j results.json] [trials]\n", argv[0]);
+        return 1;
+    }
+    if (!CC_HAVE_FLUSH) {
+        fprintf(stderr, "No user-space cache flush instruction on this architecture\n");
+        return 1;
+    }
+
+    simple_aes_key_expansion(&ctx, demo_key);
+    bench_init(&results, "cache_probe_demo", argc, argv);
+
+    printf("=== Cache Probe Demo ===\n");
+    printf("Timestamp: %.1f MHz\n", cc_timestamp_hz() / 1e6);
+    uint64_t threshold = cc_calibrate_threshold();
+    printf("Hit/miss threshold: %lu ticks\n", (unsigned long)threshold);
+
+    demo_flush_reload(&ctx, trials, threshold);
+    demo_prime_probe(&ctx, trials);
+    demo_eviction_cost(trials);
+
+    bench_record(&results, "ticks", BENCH_INFO, threshold, "hit_threshold");
+    if (json_path && bench_write(&results, json_path) != 0) {
+        perror(json_path);
+        return 1;
+    }
+    bench_free(&results);
+    return 0;
+}
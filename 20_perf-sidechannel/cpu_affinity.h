@@ -0,0 +1,70 @@
+/*
+ * CPU Placement
+ * Choosing CPUs for measurement threads and pinning threads to them, shared
+ * by key_extractor's workers and the aes_victim benchmark threads
+ *
+ * Isolated cores (isolcpus=) are preferred: nothing else is scheduled there,
+ * so a pinned thread times its own work and not a neighbour's.
+ */
+
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+// CPUs to pin workers to: isolated cores (isolcpus=) if any, otherwise the
+// CPUs this process may run on. Returns the number of CPUs found.
+static inline int ca_select_cpus(int *cpus, int max) {
+    int n = 0;
+    FILE *fp = fopen("/sys/devices/system/cpu/isolated", "r");
+
+    if (fp) {
+        char line[1024];
+        if (fgets(line, sizeof(line), fp)) {
+            char *tok = strtok(line, ",\n");
+            while (tok && n < max) {
+                int lo, hi;
+                if (sscanf(tok, "%d-%d", &lo, &hi) != 2) {
+                    hi = lo = atoi(tok);
+                }
+                for (int c = lo; c <= hi && n < max; c++) {
+                    cpus[n++] = c;
+                }
+                tok = strtok(NULL, ",\n");
+            }
+        }
+        fclose(fp);
+    }
+    if (n > 0) {
+        return n;
+    }
+
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++) {
+            if (CPU_ISSET(c, &set)) cpus[n++] = c;
+        }
+    }
+    return n;
+}
+
+// Pin the calling thread to cpu; cpu < 0 leaves the affinity alone.
+// Returns 0 on success.
+static inline int ca_pin_thread(int cpu) {
+    if (cpu < 0) {
+        return 0;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+#endif // CPU_AFFINITY_H
@@ -2,18 +2,48 @@
  * AES Key Extractor
  * Demonstrates cache timing attack to recover AES key bytes
  * Uses custom AES implementation vulnerable to timing attacks
+ *
+ * The 256 candidates for a key byte can be searched in parallel (-j):
+ * each worker thread is pinned to its own core (isolated cores first)
+ * and owns its eviction buffer and a private copy of the S-box for the
+ * whole run, so one worker's flushes never touch the lines another worker
+ * is timing. There are never more workers than usable CPUs.
+ *
+ * Full-key mode (-a) attacks all 16 bytes with streaming statistics:
+ * candidates are measured in rounds, and a candidate is dropped once its
+ * confidence interval lies entirely above the current best's. Pruning is
+ * deliberately conservative, so it saves encryptions only when the leak
+ * separates candidates clearly; with a weak leak nearly all 256 survive.
+ *
+ * Before each measurement only the S-box cache lines are flushed
+ * (cache_ctl.h); -F restores the old 8 MB eviction sweep.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
-#include <sys/time.h>
+#include <sched.h>
+#include <pthread.h>
 #include "simple_aes.h"
+#include "online_stats.h"
+#include "cache_ctl.h"
+#include "cpu_affinity.h"
 
 #define NUM_ITERATIONS 50000  // Iterations per measurement
 #define NUM_WARMUP 1000       // Warmup iterations to stabilize cache
+#define NUM_MEASUREMENTS 5    // Measurements averaged per key guess
+#define FLUSH_SIZE (8 * 1024 * 1024)  // 8MB sweep for -F / no flush instruction
+#define MAX_WORKERS 256
+
+// Full-key mode defaults
+#define SAMPLE_ITERATIONS 2000  // Encryptions per sample
+#define SAMPLE_WARMUP 100       // Warmup encryptions per sample
+#define MAX_ROUNDS 40           // Samples per candidate at most
+#define MIN_ROUNDS 3            // Samples before any candidate is pruned
+#define PRUNE_T 4.0             // Interval half-width (standard errors) for rejection
 
 // Known secret key (for demo, we recover the first byte)
 static unsigned char known_key[AES_KEY_SIZE] = {
@@ -21,65 +51,366 @@ static unsigned char known_key[AES_KEY_SIZE] = {
     0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
 };
 
-// Flush cache to ensure timing differences are measurable
-static void flush_cache(void) {
-    const int size = 8 * 1024 * 1024;  // 8MB to flush cache
-    volatile char *buffer = malloc(size);
+// Search parameters shared by all workers
+typedef struct {
+    int key_index;       // Which key byte is being recovered
+    int iterations;      // Encryptions per measurement
+    int measurements;    // Measurements per key guess
+    int sweep;           // 1 = evict by sweeping FLUSH_SIZE bytes instead of clflush
+} search_params_t;
+
+// One round of full-key mode: every live candidate gets one more sample
+typedef struct {
+    const unsigned char *base_key;
+    const int *candidates;        // Live candidates of this round
+    int ncandidates;
+    int next;                     // Work queue head (atomic)
+    welford_t *stats;             // [256] per-candidate running statistics
+} sample_round_t;
+
+// One worker: a pinned thread testing every nworkers-th candidate
+// (or pulling candidates from a sample_round_t queue in full-key mode)
+typedef struct {
+    pthread_t thread;
+    int id;
+    int nworkers;
+    int cpu;                      // -1 = not pinned
+    const search_params_t *params;
+    volatile char *flush_buffer;  // Sweep mode only: allocated once, reused for every measurement
+    uint8_t *sbox;                // Private, line-aligned copy of the S-box
+    double *timings;              // Shared [256] result array, disjoint indices
+    sample_round_t *round;
+} worker_t;
+
+// Flush cache to ensure timing differences are measurable: evict exactly
+// the lines of the table this context encrypts with, or sweep the
+// worker's buffer when one was allocated
+static void flush_cache(const SimpleAES_CTX *ctx, volatile char *buffer) {
     if (buffer) {
-        for (int i = 0; i < size; i += 64) {
+        for (int i = 0; i < FLUSH_SIZE; i += 64) {
             buffer[i] = i;
         }
-        free((void*)buffer);
+        return;
     }
+    cc_flush_range(ctx->sbox, sizeof(sbox));
 }
 
-double measure_encryption_time(unsigned char *key) {
-    SimpleAES_CTX ctx;
+// Time 'iterations' encryptions of the fixed plaintext after flushing the
+// cache; returns nanoseconds for the whole batch
+static uint64_t timed_encryptions(SimpleAES_CTX *ctx, int iterations, volatile char *flush_buffer) {
     unsigned char plaintext[AES_BLOCK_SIZE];
     unsigned char ciphertext[AES_BLOCK_SIZE];
-    
+
     // Use fixed plaintext to create consistent patterns for correct key
     // When key guess is correct, the XOR with plaintext creates predictable S-box indices
     memset(plaintext, 0, AES_BLOCK_SIZE);
-    
+
+    flush_cache(ctx, flush_buffer);  // Flush cache before measurement
+
+    uint64_t start = cc_timestamp();
+
+    // Perform encryptions
+    for (int i = 0; i < iterations; i++) {
+        simple_aes_encrypt(ctx, plaintext, ciphertext);
+    }
+
+    return (uint64_t)cc_ticks_to_ns(cc_timestamp() - start);
+}
+
+static void warmup(SimpleAES_CTX *ctx, int iterations) {
+    unsigned char plaintext[AES_BLOCK_SIZE] = {0};
+    unsigned char ciphertext[AES_BLOCK_SIZE];
+
+    for (int i = 0; i < iterations; i++) {
+        simple_aes_encrypt(ctx, plaintext, ciphertext);
+    }
+}
+
+double measure_encryption_time(const worker_t *w, unsigned char *key) {
+    const search_params_t *params = w->params;
+    SimpleAES_CTX ctx;
+
     simple_aes_key_expansion(&ctx, key);
-    
+    ctx.sbox = w->sbox;
+
     // Warmup phase to stabilize
-    for (int i = 0; i < NUM_WARMUP; i++) {
-        simple_aes_encrypt(&ctx, plaintext, ciphertext);
-    }
-    
-    const int num_measurements = 5;  // Average over multiple measurements
-    double total_time = 0.0;
-
-    for (int meas = 0; meas < num_measurements; meas++) {
-        flush_cache();  // Flush cache before measurement
-        
-        struct timeval start, end;
-        gettimeofday(&start, NULL);
-
-        // Perform encryptions
-        for (int i = 0; i < NUM_ITERATIONS; i++) {
-            simple_aes_encrypt(&ctx, plaintext, ciphertext);
-        }
+    warmup(&ctx, NUM_WARMUP);
 
-        gettimeofday(&end, NULL);
+    uint64_t total_ns = 0;
 
-        double time_taken = (end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec);
-        total_time += time_taken;
+    for (int meas = 0; meas < params->measurements; meas++) {
+        total_ns += timed_encryptions(&ctx, params->iterations, w->flush_buffer);
     }
 
-    return total_time / (num_measurements * NUM_ITERATIONS);  // Average time per encryption in microseconds
+    // Average time per encryption in microseconds
+    return total_ns / 1000.0 / ((double)params->measurements * params->iterations);
 }
 
-int main() {
-    printf("=== AES Key Extractor ===\n");
-    printf("Recovering first byte of AES key using timing attack\n");
-    printf("Using custom AES implementation with amplified timing differences\n");
-    printf("Performing %d encryptions per key guess...\n\n", NUM_ITERATIONS);
+static void pin_worker(const worker_t *w) {
+    if (ca_pin_thread(w->cpu) != 0) {
+        fprintf(stderr, "Warning: could not pin worker %d to CPU %d\n", w->id, w->cpu);
+    }
+}
 
+static void *search_worker(void *arg) {
+    worker_t *w = arg;
     unsigned char test_key[AES_KEY_SIZE];
+
+    pin_worker(w);
+
     memcpy(test_key, known_key, AES_KEY_SIZE);
+    for (int byte = w->id; byte < 256; byte += w->nworkers) {
+        test_key[w->params->key_index] = byte;
+        w->timings[byte] = measure_encryption_time(w, test_key);
+    }
+    return NULL;
+}
+
+// Worker pool: one pinned thread per worker, each with its own eviction
+// buffer. The pool lives for the whole run; run_workers() starts one job.
+static worker_t workers[MAX_WORKERS];
+static int num_workers;
+
+static int init_workers(const search_params_t *params, int nworkers, double *timings) {
+    int cpus[MAX_WORKERS];
+    int ncpus = ca_select_cpus(cpus, MAX_WORKERS);
+
+    num_workers = nworkers;
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].id = i;
+        workers[i].nworkers = nworkers;
+        workers[i].cpu = (ncpus > 0 && nworkers > 1) ? cpus[i % ncpus] : -1;
+        workers[i].params = params;
+        workers[i].timings = timings;
+        workers[i].round = NULL;
+        workers[i].flush_buffer = NULL;
+        workers[i].sbox = aligned_alloc(CC_LINE_SIZE, sizeof(sbox));
+        if (!workers[i].sbox) {
+            fprintf(stderr, "Failed to allocate S-box copy for worker %d\n", i);
+            return -1;
+        }
+        memcpy(workers[i].sbox, sbox, sizeof(sbox));
+        if (!params->sweep) {
+            continue;
+        }
+        workers[i].flush_buffer = malloc(FLUSH_SIZE);
+        if (!workers[i].flush_buffer) {
+            fprintf(stderr, "Failed to allocate eviction buffer for worker %d\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void free_workers(void) {
+    for (int i = 0; i < num_workers; i++) {
+        free((void *)workers[i].flush_buffer);
+        free(workers[i].sbox);
+    }
+}
+
+// Run fn on every worker and wait for all of them
+static int run_workers(void *(*fn)(void *)) {
+    int started = 0;
+
+    if (num_workers == 1) {
+        fn(&workers[0]);
+        return 0;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&workers[i].thread, NULL, fn, &workers[i]) != 0) {
+            perror("pthread_create");
+            break;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    return started == num_workers ? 0 : -1;
+}
+
+// Full-key mode: pull live candidates from the round queue and add one
+// sample (mean us/encryption over params->iterations) to each
+static void *sample_worker(void *arg) {
+    worker_t *w = arg;
+    sample_round_t *round = w->round;
+    unsigned char test_key[AES_KEY_SIZE];
+    SimpleAES_CTX ctx;
+
+    pin_worker(w);
+
+    memcpy(test_key, round->base_key, AES_KEY_SIZE);
+    for (;;) {
+        int slot = __atomic_fetch_add(&round->next, 1, __ATOMIC_RELAXED);
+        if (slot >= round->ncandidates) {
+            break;
+        }
+        int byte = round->candidates[slot];
+
+        test_key[w->params->key_index] = byte;
+        simple_aes_key_expansion(&ctx, test_key);
+        ctx.sbox = w->sbox;
+        warmup(&ctx, SAMPLE_WARMUP);
+
+        uint64_t ns = timed_encryptions(&ctx, w->params->iterations, w->flush_buffer);
+        welford_push(&round->stats[byte], ns / 1000.0 / w->params->iterations);
+    }
+    return NULL;
+}
+
+// Per-byte outcome of the full-key search
+typedef struct {
+    int recovered;
+    int rounds;
+    int survivors;
+    double confidence;       // P(winner faster than closest rival), normal approx.
+    uint64_t encryptions;
+} byte_result_t;
+
+static int lowest_mean(const welford_t *stats, const int *candidates, int n) {
+    int best = candidates[0];
+    for (int i = 1; i < n; i++) {
+        if (stats[candidates[i]].mean < stats[best].mean) best = candidates[i];
+    }
+    return best;
+}
+
+// Recover one key byte with sequential sampling and early rejection
+static int recover_byte(search_params_t *params, int max_rounds, double prune_t,
+                        byte_result_t *result) {
+    welford_t stats[256];
+    int candidates[256];
+    int ncandidates = 256;
+    sample_round_t round;
+    int r;
+
+    for (int i = 0; i < 256; i++) {
+        welford_init(&stats[i]);
+        candidates[i] = i;
+    }
+    round.base_key = known_key;
+    round.stats = stats;
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].round = &round;
+    }
+
+    result->encryptions = 0;
+    for (r = 1; r <= max_rounds && ncandidates > 1; r++) {
+        round.candidates = candidates;
+        round.ncandidates = ncandidates;
+        round.next = 0;
+        if (run_workers(sample_worker) != 0) {
+            return -1;
+        }
+        result->encryptions += (uint64_t)ncandidates * (params->iterations + SAMPLE_WARMUP);
+
+        if (r < MIN_ROUNDS) {
+            continue;
+        }
+
+        // Drop a candidate only when even its optimistic time (mean minus
+        // prune_t standard errors) is slower than the best's pessimistic
+        // one. That is stricter than Welch t > prune_t, which with 255
+        // comparisons per round drops the true byte far too often.
+        int best = lowest_mean(stats, candidates, ncandidates);
+        double best_upper = stats[best].mean + prune_t * welford_stderr(&stats[best]);
+        int kept = 0;
+        for (int i = 0; i < ncandidates; i++) {
+            int c = candidates[i];
+            if (c == best || stats[c].mean - prune_t * welford_stderr(&stats[c]) <= best_upper) {
+                candidates[kept++] = c;
+            }
+        }
+        ncandidates = kept;
+    }
+
+    int winner = lowest_mean(stats, candidates, ncandidates);
+
+    // Confidence against the closest surviving rival, the set the winner
+    // was picked from. A lone survivor beat every rival's interval, which
+    // implies Welch t > prune_t, so prune_t gives its lower bound.
+    double min_t = ncandidates > 1 ? INFINITY : prune_t;
+    for (int i = 0; i < ncandidates; i++) {
+        int c = candidates[i];
+        if (c != winner) {
+            double t = welch_t(&stats[c], &stats[winner]);
+            if (t < min_t) min_t = t;
+        }
+    }
+
+    result->recovered = winner;
+    result->rounds = r - 1;
+    result->survivors = ncandidates;
+    result->confidence = normal_cdf(min_t);
+    return 0;
+}
+
+static int full_key_attack(search_params_t *params, int nworkers, int max_rounds, double prune_t) {
+    unsigned char recovered[AES_KEY_SIZE];
+    uint64_t total_encryptions = 0;
+    int correct = 0;
+
+    printf("=== AES Key Extractor (full key) ===\n");
+    printf("Recovering all %d key bytes with sequential t-test pruning\n", AES_KEY_SIZE);
+    printf("Sample: %d encryptions, rounds: %d-%d, prune outside mean +/- %.1f SE\n",
+           params->iterations, MIN_ROUNDS, max_rounds, prune_t);
+    printf("Eviction: %s\n", params->sweep ? "8 MB sweep" : "clflush S-box lines");
+    printf("Worker threads: %d\n\n", nworkers);
+
+    if (init_workers(params, nworkers, NULL) != 0) {
+        return 1;
+    }
+
+    printf("%-5s %-10s %-8s %-7s %-10s %-11s %s\n",
+           "Byte", "Recovered", "Actual", "Rounds", "Survivors", "Confidence", "Encryptions");
+
+    uint64_t start = cc_timestamp();
+    for (int k = 0; k < AES_KEY_SIZE; k++) {
+        byte_result_t res;
+
+        params->key_index = k;
+        if (recover_byte(params, max_rounds, prune_t, &res) != 0) {
+            free_workers();
+            return 1;
+        }
+        recovered[k] = res.recovered;
+        total_encryptions += res.encryptions;
+        if (res.recovered == known_key[k]) correct++;
+
+        printf("%-5d 0x%02x       0x%02x     %-7d %-10d %9.2f%%  %lu\n",
+               k, res.recovered, known_key[k], res.rounds, res.survivors,
+               res.confidence * 100.0, (unsigned long)res.encryptions);
+        fflush(stdout);
+    }
+    double elapsed = cc_ticks_to_ns(cc_timestamp() - start) / 1e9;
+    free_workers();
+
+    // What the same rounds would have cost without pruning
+    uint64_t exhaustive = (uint64_t)AES_KEY_SIZE * 256 * max_rounds * (params->iterations + SAMPLE_WARMUP);
+
+    printf("\n=== Results ===\n");
+    printf("Recovered key: ");
+    for (int k = 0; k < AES_KEY_SIZE; k++) printf("%02x", recovered[k]);
+    printf("\nActual key:    ");
+    for (int k = 0; k < AES_KEY_SIZE; k++) printf("%02x", known_key[k]);
+    printf("\nCorrect bytes: %d/%d\n", correct, AES_KEY_SIZE);
+    printf("Encryptions: %lu (%.1fx fewer than %d rounds without pruning)\n",
+           (unsigned long)total_encryptions, (double)exhaustive / total_encryptions, max_rounds);
+    printf("Search time: %.2f s with %d thread(s)\n", elapsed, nworkers);
+
+    return 0;
+}
+
+static int single_byte_attack(const search_params_t *params, int nworkers) {
+    int k = params->key_index;
+
+    printf("=== AES Key Extractor ===\n");
+    printf("Recovering key byte %d of AES key using timing attack\n", k);
+    printf("Using custom AES implementation with amplified timing differences\n");
+    printf("Performing %d encryptions per key guess...\n", params->iterations);
+    printf("Eviction: %s\n", params->sweep ? "8 MB sweep" : "clflush S-box lines");
+    printf("Worker threads: %d\n\n", nworkers);
 
     double min_time = 1e9;  // Large initial value
     double max_time = 0.0;
@@ -87,18 +418,22 @@ int main() {
     double timings[256];  // Store all timings for analysis
 
     printf("Testing key byte 0x00 to 0xFF...\n");
-    printf("This may take several minutes...\n\n");
-    
-    for (int byte = 0; byte < 256; byte++) {
-        test_key[0] = byte;
-        double avg_time = measure_encryption_time(test_key);
+    if (nworkers == 1) {
+        printf("This may take several minutes (use -j 0 to search in parallel)...\n\n");
+    } else {
+        printf("\n");
+    }
 
-        if (avg_time < 0) {
-            fprintf(stderr, "Error measuring time for byte 0x%02x\n", byte);
-            continue;
-        }
+    uint64_t search_start = cc_timestamp();
+    if (init_workers(params, nworkers, timings) != 0 || run_workers(search_worker) != 0) {
+        free_workers();
+        return 1;
+    }
+    free_workers();
+    double search_sec = cc_ticks_to_ns(cc_timestamp() - search_start) / 1e9;
 
-        timings[byte] = avg_time;
+    for (int byte = 0; byte < 256; byte++) {
+        double avg_time = timings[byte];
 
         if (avg_time < min_time) {
             min_time = avg_time;
@@ -114,22 +449,23 @@ int main() {
     }
 
     printf("\n=== Results ===\n");
-    printf("Recovered first key byte: 0x%02x\n", best_byte);
-    printf("Actual first key byte: 0x%02x\n", known_key[0]);
+    printf("Recovered key byte %d: 0x%02x\n", k, best_byte);
+    printf("Actual key byte %d: 0x%02x\n", k, known_key[k]);
     printf("Best average time: %.4f us/encryption\n", min_time);
     printf("Worst average time: %.4f us/encryption\n", max_time);
     printf("Timing spread: %.4f us (%.2f%%)\n", max_time - min_time, ((max_time - min_time) / min_time) * 100.0);
-    
+    printf("Search time: %.2f s with %d thread(s)\n", search_sec, nworkers);
+
     // Show timing difference
     if (best_byte >= 0 && best_byte < 256) {
-        double correct_time = timings[known_key[0]];
+        double correct_time = timings[known_key[k]];
         printf("Correct key byte time: %.4f us/encryption\n", correct_time);
-        printf("Time difference from best: %.4f us (%.2f%%)\n", 
-               correct_time - min_time, 
+        printf("Time difference from best: %.4f us (%.2f%%)\n",
+               correct_time - min_time,
                ((correct_time - min_time) / min_time) * 100.0);
     }
 
-    if (best_byte == known_key[0]) {
+    if (best_byte == known_key[k]) {
         printf("\n*** SUCCESS: Key byte recovered correctly! ***\n");
     } else {
         printf("\n*** Attack did not recover correct byte ***\n");
@@ -138,4 +474,67 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j threads] [-b key_byte] [-n iterations] [-m measurements] [-F]\n", prog);
+    fprintf(stderr, "       %s -a [-j threads] [-n iterations] [-r max_rounds] [-t prune_t] [-F]\n", prog);
+    fprintf(stderr, "  -j  Worker threads, 0 = one per available CPU (default 1)\n");
+    fprintf(stderr, "  -b  Index of the key byte to recover, 0-15 (default 0)\n");
+    fprintf(stderr, "  -n  Encryptions per measurement (default %d, %d with -a)\n",
+            NUM_ITERATIONS, SAMPLE_ITERATIONS);
+    fprintf(stderr, "  -m  Measurements per key guess (default %d)\n", NUM_MEASUREMENTS);
+    fprintf(stderr, "  -a  Recover all 16 key bytes with early candidate pruning\n");
+    fprintf(stderr, "  -r  Full-key mode: samples per candidate at most (default %d)\n", MAX_ROUNDS);
+    fprintf(stderr, "  -t  Full-key mode: standard errors per side of the interval test (default %.1f)\n", PRUNE_T);
+    fprintf(stderr, "  -F  Evict with the 8 MB memory sweep instead of flushing the S-box lines\n");
+}
+
+int main(int argc, char *argv[]) {
+    search_params_t params = { 0, 0, NUM_MEASUREMENTS, !CC_HAVE_FLUSH };
+    int nworkers = 1;
+    int full_key = 0;
+    int max_rounds = MAX_ROUNDS;
+    double prune_t = PRUNE_T;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:b:n:m:ar:t:Fh")) != -1) {
+        switch (opt) {
+        case 'j': nworkers = atoi(optarg); break;
+        case 'b': params.key_index = atoi(optarg); break;
+        case 'n': params.iterations = atoi(optarg); break;
+        case 'm': params.measurements = atoi(optarg); break;
+        case 'a': full_key = 1; break;
+        case 'r': max_rounds = atoi(optarg); break;
+        case 't': prune_t = atof(optarg); break;
+        case 'F': params.sweep = 1; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (params.iterations == 0) {
+        params.iterations = full_key ? SAMPLE_ITERATIONS : NUM_ITERATIONS;
+    }
+    if (nworkers == 0) {
+        nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (nworkers < 1 || nworkers > MAX_WORKERS || params.key_index < 0 ||
+        params.key_index >= AES_KEY_SIZE || params.iterations < 1 || params.measurements < 1 ||
+        max_rounds < MIN_ROUNDS || prune_t <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Two workers on one CPU would time each other's encryptions
+    int cpus[MAX_WORKERS];
+    int ncpus = ca_select_cpus(cpus, MAX_WORKERS);
+    if (ncpus > 0 && nworkers > ncpus) {
+        fprintf(stderr, "Note: %d workers requested, using %d (one per usable CPU)\n", nworkers, ncpus);
+        nworkers = ncpus;
+    }
+    cc_timestamp_hz();   // Calibrate once before the workers start
+
+    if (full_key) {
+        return full_key_attack(&params, nworkers, max_rounds, prune_t);
+    }
+    return single_byte_attack(&params, nworkers);
+}
@@ -0,0 +1,82 @@
+/*
+ * Latency Histogram
+ * Fixed-size log-linear histogram for nanosecond latencies: exact below
+ * 64 ns, then 32 sub-buckets per power of two (about 3% resolution) up to
+ * 2^40 ns. Recording is an index computation and one increment, so each
+ * thread keeps its own and they are merged once at the end.
+ */
+
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define LH_LINEAR 64
+#define LH_SUB_BITS 5
+#define LH_SUB (1 << LH_SUB_BITS)
+#define LH_MAX_EXP 40
+#define LH_BUCKETS (LH_LINEAR + (LH_MAX_EXP - 6 + 1) * LH_SUB)
+
+typedef struct {
+    uint64_t count[LH_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+    double sum;
+} latency_hist_t;
+
+static inline void lh_init(latency_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+static inline int lh_index(uint64_t ns) {
+    if (ns < LH_LINEAR) return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    if (e > LH_MAX_EXP) return LH_BUCKETS - 1;
+    int sub = (int)((ns >> (e - LH_SUB_BITS)) & (LH_SUB - 1));
+    return LH_LINEAR + (e - 6) * LH_SUB + sub;
+}
+
+// Upper bound of a bucket, reported for percentiles
+static inline uint64_t lh_bucket_value(int idx) {
+    if (idx < LH_LINEAR) return idx;
+    int e = (idx - LH_LINEAR) / LH_SUB + 6;
+    int sub = (idx - LH_LINEAR) % LH_SUB;
+    return ((uint64_t)(LH_SUB + sub + 1) << (e - LH_SUB_BITS)) - 1;
+}
+
+static inline void lh_record(latency_hist_t *h, uint64_t ns) {
+    h->count[lh_index(ns)]++;
+    h->total++;
+    h->sum += ns;
+    if (ns > h->max) h->max = ns;
+}
+
+static inline void lh_merge(latency_hist_t *dst, const latency_hist_t *src) {
+    for (int i = 0; i < LH_BUCKETS; i++) dst->count[i] += src->count[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// Value at quantile q (0..1), capped at the largest recorded value
+static inline uint64_t lh_percentile(const latency_hist_t *h, double q) {
+    if (h->total == 0) return 0;
+    uint64_t rank = (uint64_t)(q * h->total);
+    if (rank >= h->total) rank = h->total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LH_BUCKETS; i++) {
+        seen += h->count[i];
+        if (seen > rank) {
+            uint64_t v = lh_bucket_value(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+static inline double lh_mean(const latency_hist_t *h) {
+    return h->total ? h->sum / h->total : 0.0;
+}
+
+#endif // LATENCY_HIST_H
@@ -0,0 +1,542 @@
+/**
+ * mem_hierarchy_bench.c
+ *
+ * Memory hierarchy characterization, grown from the memory_intensive_work()
+ * and tlb_intensive_work() workloads of perf_capabilities_demo into
+ * parameterized sweeps. Every point is measured with the same perf counter
+ * set (perf_counter.h), normalised per load or per cache line.
+ *
+ * 1. Latency: pointer chase through a random cyclic permutation of cache
+ *    lines (one dependent load per line), working sets from L1 to DRAM.
+ * 2. Bandwidth: read, write and copy (STREAM convention: copy counts read
+ *    and written bytes) versus thread count, each thread on its own
+ *    first-touched buffer.
+ * 3. NUMA: latency and read bandwidth from the CPUs of each node to memory
+ *    bound (mbind) to each node.
+ *
+ * Each point can be measured -N times; the tables show the mean of the
+ * trials and -j writes all of them as JSON results (bench_json.h).
+ *
+ * Compile: gcc -O2 -pthread -o mem_hierarchy_bench mem_hierarchy_bench.c
+ * Run: sudo ./mem_hierarchy_bench [-m latency,bandwidth,numa] [-N trials] [-j file] (root or
+ *      perf_event_paranoid <= 2 for the counters)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <sched.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "perf_counter.h"
+#include "bench_json.h"
+
+#define LINE 64
+#define MAX_THREADS 256
+#define MAX_NODES 64
+#define CHASE_CHUNK (1 << 20)
+
+typedef struct line {
+    struct line *next;
+    char pad[LINE - sizeof(struct line *)];
+} line_t;
+
+// Counters reported for every point
+enum { C_CYCLES, C_L1D_MISS, C_LLC_MISS, C_DTLB_MISS, NUM_COUNTERS };
+
+static PerfCounter counters[NUM_COUNTERS] = {
+    PERF_COUNTER_SPEC("cycles", "cycles|cpu_cycles"),
+    PERF_COUNTER_SPEC("L1D-miss", "L1-dcache-load-misses|l1d_cache_refill"),
+    PERF_COUNTER_SPEC("LLC-miss", "LLC-load-misses|ll_cache_miss_rd|l2d_cache_refill"),
+    PERF_COUNTER_SPEC("dTLB-miss", "dTLB-load-misses|l1d_tlb_refill"),
+};
+
+static struct {
+    size_t min_bytes;
+    size_t max_bytes;
+    int points_per_octave;
+    size_t thread_bytes;
+    int max_threads;
+    double point_ms;
+    int trials;
+} cfg = { 4 << 10, 256 << 20, 2, 64 << 20, 0, 100, 1 };
+
+static bench_results_t results;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void *map_buffer(size_t size) {
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+// Mean over the trials of "<point>/<metric>", NAN when never recorded
+static double point_mean(const char *point, const char *metric) {
+    char name[BENCH_NAME_LEN];
+    bench_summary_t s;
+    snprintf(name, sizeof(name), "%s/%s", point, metric);
+    return bench_summarize(bench_find(&results, name), &s) == 0 ? s.mean : NAN;
+}
+
+// One trial of every available counter, normalised per unit
+static void record_counters(const char *point, const char *unit, double units) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (counter_available(&counters[i]) && units > 0) {
+            bench_record(&results, unit, BENCH_LOWER, counters[i].value / units, "%s/%s", point,
+                         counters[i].name);
+        }
+    }
+}
+
+// Counter columns: mean value per unit, or "-" when the event is unavailable
+static void print_counter_header(void) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        printf(" %11s", counters[i].name);
+    }
+    printf("\n");
+}
+
+static void print_counters(const char *point) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        double v = point_mean(point, counters[i].name);
+        if (!isnan(v)) {
+            printf(" %11.3f", v);
+        } else {
+            printf(" %11s", "-");
+        }
+    }
+    printf("\n");
+}
+
+// ============================================================================
+// Latency: pointer chasing
+// ============================================================================
+
+// Link the first n lines of buf into one random cycle (Sattolo's algorithm),
+// so every load depends on the previous one and the prefetchers cannot help
+static line_t *build_chain(line_t *buf, size_t n, uint32_t *order) {
+    for (size_t i = 0; i < n; i++) order[i] = (uint32_t)i;
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = rng_next() % i;
+        uint32_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (size_t i = 0; i < n; i++) {
+        buf[order[i]].next = &buf[order[(i + 1) % n]];
+    }
+    return &buf[order[0]];
+}
+
+static line_t *volatile chase_sink;    // Keeps the chase from being optimised away
+
+static line_t *chase(line_t *p, long loads) {
+    for (long i = 0; i < loads; i += 8) {
+        p = p->next; p = p->next; p = p->next; p = p->next;
+        p = p->next; p = p->next; p = p->next; p = p->next;
+    }
+    return p;
+}
+
+// Average ns per dependent load over at least cfg.point_ms; counters cover
+// exactly the timed loads
+static double chase_latency(line_t *start, size_t lines, double *loads_out) {
+    line_t *p = chase(start, lines < CHASE_CHUNK ? (long)lines : CHASE_CHUNK);   // Warm up
+    double loads = 0, t0, elapsed;
+
+    counters_start(counters, NUM_COUNTERS);
+    t0 = now_ns();
+    do {
+        p = chase(p, CHASE_CHUNK);
+        loads += CHASE_CHUNK;
+        elapsed = now_ns() - t0;
+    } while (elapsed < cfg.point_ms * 1e6);
+    counters_stop(counters, NUM_COUNTERS);
+    chase_sink = p;
+    *loads_out = loads;
+    return elapsed / loads;
+}
+
+static void run_latency(void) {
+    size_t max_lines = cfg.max_bytes / LINE;
+    line_t *buf = map_buffer(cfg.max_bytes);
+    uint32_t *order = malloc(max_lines * sizeof(uint32_t));
+
+    printf("\n========================================\n");
+    printf("Latency: pointer chase (%d points/octave, %d x >= %.0f ms each)\n", cfg.points_per_octave,
+           cfg.trials, cfg.point_ms);
+    printf("========================================\n");
+    if (!buf || !order) {
+        fprintf(stderr, "Cannot allocate %zu MB\n", cfg.max_bytes >> 20);
+        free(order);
+        if (buf) munmap(buf, cfg.max_bytes);
+        return;
+    }
+    printf("%10s %9s", "size", "ns/load");
+    print_counter_header();
+
+    double step = exp2(1.0 / cfg.points_per_octave);
+    for (double size = cfg.min_bytes; size <= cfg.max_bytes * 1.0001; size *= step) {
+        size_t lines = (size_t)size / LINE;
+        if (lines < 8) continue;
+        line_t *start = build_chain(buf, lines, order);
+        char label[32], point[48];
+        if (size >= 1 << 20) {
+            snprintf(label, sizeof(label), "%.1fMB", size / (1 << 20));
+        } else {
+            snprintf(label, sizeof(label), "%.1fKB", size / 1024);
+        }
+        snprintf(point, sizeof(point), "latency/%s", label);
+        for (int t = 0; t < cfg.trials; t++) {
+            double loads;
+            double ns = chase_latency(start, lines, &loads);
+            bench_record(&results, "ns", BENCH_LOWER, ns, "%s/ns_per_load", point);
+            record_counters(point, "per load", loads);
+        }
+        printf("%10s %9.2f", label, point_mean(point, "ns_per_load"));
+        print_counters(point);
+    }
+    free(order);
+    munmap(buf, cfg.max_bytes);
+}
+
+// ============================================================================
+// Bandwidth: read / write / copy versus threads
+// ============================================================================
+
+enum { K_READ, K_WRITE, K_COPY, NUM_KERNELS };
+static const char *kernel_names[NUM_KERNELS] = { "read", "write", "copy" };
+
+typedef struct {
+    int kernel;
+    int cpu;                    // Pin target, -1 = none
+    size_t bytes;
+    pthread_barrier_t *start;
+    volatile int *stop;
+    double moved;               // Bytes counted for bandwidth
+    uint64_t sink;
+} bw_arg_t;
+
+static uint64_t kernel_read(const uint64_t *p, size_t n) {
+    uint64_t a = 0, b = 0, c = 0, d = 0;
+    for (size_t i = 0; i < n; i += 4) {
+        a += p[i];
+        b += p[i + 1];
+        c += p[i + 2];
+        d += p[i + 3];
+    }
+    return a + b + c + d;
+}
+
+static void kernel_write(uint64_t *p, size_t n, uint64_t v) {
+    // Not a constant store, which the compiler would turn into memset()
+    for (size_t i = 0; i < n; i++) p[i] = v + i;
+}
+
+static void pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void *bw_worker(void *p) {
+    bw_arg_t *a = p;
+    size_t n = a->bytes / sizeof(uint64_t);
+
+    if (a->cpu >= 0) pin_to_cpu(a->cpu);
+    // First touch from this thread: pages land on its NUMA node
+    uint64_t *src = map_buffer(a->bytes);
+    uint64_t *dst = a->kernel == K_COPY ? map_buffer(a->bytes) : NULL;
+    if (src) kernel_write(src, n, 1);
+    if (dst) kernel_write(dst, n, 2);
+
+    pthread_barrier_wait(a->start);
+    for (uint64_t rep = 0; src && !*a->stop && (a->kernel != K_COPY || dst); rep++) {
+        switch (a->kernel) {
+        case K_READ: a->sink += kernel_read(src, n); a->moved += a->bytes; break;
+        case K_WRITE: kernel_write(src, n, rep); a->moved += a->bytes; break;
+        default: memcpy(dst, src, a->bytes); a->moved += 2.0 * a->bytes; break;
+        }
+    }
+    if (src) munmap(src, a->bytes);
+    if (dst) munmap(dst, a->bytes);
+    return NULL;
+}
+
+// Aggregate GB/s of `threads` workers running kernel for cfg.point_ms
+static double run_bandwidth_point(int kernel, int threads, const int *cpus, int ncpus, double *lines) {
+    pthread_t tids[MAX_THREADS];
+    bw_arg_t args[MAX_THREADS];
+    pthread_barrier_t start;
+    volatile int stop = 0;
+    double moved = 0;
+
+    pthread_barrier_init(&start, NULL, threads + 1);
+    for (int t = 0; t < threads; t++) {
+        args[t] = (bw_arg_t){ .kernel = kernel, .cpu = ncpus ? cpus[t % ncpus] : -1, .bytes = cfg.thread_bytes,
+                              .start = &start, .stop = &stop };
+        pthread_create(&tids[t], NULL, bw_worker, &args[t]);
+    }
+    pthread_barrier_wait(&start);           // Buffers are allocated and touched
+    counters_start(counters, NUM_COUNTERS);
+    double t0 = now_ns();
+    while (now_ns() - t0 < cfg.point_ms * 1e6) usleep(1000);
+    stop = 1;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        moved += args[t].moved;
+    }
+    // Includes each worker's last, partly late pass: fine at point_ms >> pass time
+    double elapsed = now_ns() - t0;
+    counters_stop(counters, NUM_COUNTERS);
+    pthread_barrier_destroy(&start);
+    *lines = moved / LINE;
+    return moved / elapsed;
+}
+
+static int allowed_cpus(int *cpus, int max) {
+    cpu_set_t set;
+    int n = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return 0;
+    for (int c = 0; c < CPU_SETSIZE && n < max; c++) {
+        if (CPU_ISSET(c, &set)) cpus[n++] = c;
+    }
+    return n;
+}
+
+static void run_bandwidth(void) {
+    int cpus[MAX_THREADS];
+    int ncpus = allowed_cpus(cpus, MAX_THREADS);
+    int max_threads = cfg.max_threads > 0 ? cfg.max_threads : (ncpus > 0 ? ncpus : 1);
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    printf("\n========================================\n");
+    printf("Bandwidth: %zu MB per thread, up to %d thread(s), %d x >= %.0f ms each\n", cfg.thread_bytes >> 20,
+           max_threads, cfg.trials, cfg.point_ms);
+    printf("========================================\n");
+    printf("%6s %7s %9s %11s", "kernel", "threads", "GB/s", "GB/s/thread");
+    print_counter_header();
+
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        // 1, 2, 4, ... and the maximum itself
+        for (int threads = 1; threads <= max_threads;
+             threads = (threads * 2 > max_threads && threads < max_threads) ? max_threads : threads * 2) {
+            char point[48];
+            snprintf(point, sizeof(point), "bandwidth/%s/threads=%d", kernel_names[k], threads);
+            for (int t = 0; t < cfg.trials; t++) {
+                double lines;
+                double gbs = run_bandwidth_point(k, threads, cpus, ncpus, &lines);
+                bench_record(&results, "GB/s", BENCH_HIGHER, gbs, "%s/GB_per_s", point);
+                record_counters(point, "per line", lines);     // Per cache line moved
+            }
+            double gbs = point_mean(point, "GB_per_s");
+            printf("%6s %7d %9.2f %11.2f", kernel_names[k], threads, gbs, gbs / threads);
+            print_counters(point);
+        }
+    }
+}
+
+// ============================================================================
+// NUMA: local versus remote
+// ============================================================================
+
+// First CPU of every node that has CPUs, from sysfs
+static int numa_nodes(int *node_ids, int *first_cpu, int max) {
+    DIR *dir = opendir("/sys/devices/system/node");
+    struct dirent *de;
+    int n = 0;
+
+    if (!dir) return 0;
+    while ((de = readdir(dir)) != NULL && n < max) {
+        int id;
+        char path[300], list[256];
+        if (sscanf(de->d_name, "node%d", &id) != 1) continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", de->d_name);
+        FILE *fp = fopen(path, "r");
+        if (!fp) continue;
+        int cpu = -1;
+        if (fgets(list, sizeof(list), fp) && sscanf(list, "%d", &cpu) == 1) {
+            node_ids[n] = id;
+            first_cpu[n] = cpu;
+            n++;
+        }
+        fclose(fp);
+    }
+    closedir(dir);
+    // Sort by node id
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && node_ids[j] < node_ids[j - 1]; j--) {
+            int t = node_ids[j]; node_ids[j] = node_ids[j - 1]; node_ids[j - 1] = t;
+            t = first_cpu[j]; first_cpu[j] = first_cpu[j - 1]; first_cpu[j - 1] = t;
+        }
+    }
+    return n;
+}
+
+// Buffer whose pages come from `node` only (before first touch)
+static void *map_on_node(size_t size, int node) {
+    void *p = map_buffer(size);
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1] = {0};
+
+    if (!p) return NULL;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_mbind, p, size, MPOL_BIND, mask, MAX_NODES + 1, 0) != 0) {
+        munmap(p, size);
+        return NULL;
+    }
+    return p;
+}
+
+static void run_numa(void) {
+    int ids[MAX_NODES], cpus[MAX_NODES];
+    int n = numa_nodes(ids, cpus, MAX_NODES);
+    size_t size = cfg.thread_bytes;
+    size_t lines = size / LINE;
+    uint32_t *order = malloc(lines * sizeof(uint32_t));
+    cpu_set_t saved;
+
+    printf("\n========================================\n");
+    printf("NUMA: %d node(s) with CPUs, %zu MB working set\n", n, size >> 20);
+    printf("========================================\n");
+    if (n == 0 || !order) {
+        printf("No NUMA topology in /sys/devices/system/node\n");
+        free(order);
+        return;
+    }
+    if (n == 1) printf("Single node: only local access can be measured.\n");
+    sched_getaffinity(0, sizeof(saved), &saved);
+    printf("%8s %8s %9s %9s", "cpu node", "mem node", "ns/load", "read GB/s");
+    print_counter_header();
+
+    for (int c = 0; c < n; c++) {
+        pin_to_cpu(cpus[c]);
+        for (int m = 0; m < n; m++) {
+            line_t *buf = map_on_node(size, ids[m]);
+            if (!buf) {
+                printf("%8d %8d  cannot bind memory: %s\n", ids[c], ids[m], strerror(errno));
+                continue;
+            }
+            line_t *start = build_chain(buf, lines, order);
+            char point[48];
+            snprintf(point, sizeof(point), "numa/cpu_node=%d/mem_node=%d", ids[c], ids[m]);
+            for (int t = 0; t < cfg.trials; t++) {
+                double loads;
+                double ns = chase_latency(start, lines, &loads);
+                bench_record(&results, "ns", BENCH_LOWER, ns, "%s/ns_per_load", point);
+                record_counters(point, "per load", loads);     // Latency counters, per load
+
+                // Single-thread read bandwidth over the same bound pages
+                static volatile uint64_t sink;
+                double t0 = now_ns(), bytes = 0;
+                do {
+                    sink += kernel_read((const uint64_t *)buf, size / sizeof(uint64_t));
+                    bytes += size;
+                } while (now_ns() - t0 < cfg.point_ms * 1e6);
+                bench_record(&results, "GB/s", BENCH_HIGHER, bytes / (now_ns() - t0), "%s/read_GB_per_s", point);
+            }
+
+            printf("%8d %8d %9.2f %9.2f", ids[c], ids[m], point_mean(point, "ns_per_load"),
+                   point_mean(point, "read_GB_per_s"));
+            print_counters(point);
+            munmap(buf, size);
+        }
+    }
+    sched_setaffinity(0, sizeof(saved), &saved);
+    free(order);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-m modes] [-s KB] [-S MB] [-p N] [-B MB] [-T N] [-t MS] [-N N] [-j file]\n", prog);
+    fprintf(stderr, "  -m MODES  Comma-separated: latency, bandwidth, numa (default: all)\n");
+    fprintf(stderr, "  -s KB     Smallest latency working set (default: 4)\n");
+    fprintf(stderr, "  -S MB     Largest latency working set (default: 256)\n");
+    fprintf(stderr, "  -p N      Latency points per octave (default: 2)\n");
+    fprintf(stderr, "  -B MB     Buffer per bandwidth thread / NUMA working set (default: 64)\n");
+    fprintf(stderr, "  -T N      Most bandwidth threads (default: allowed CPUs)\n");
+    fprintf(stderr, "  -t MS     Minimum time per point (default: 100)\n");
+    fprintf(stderr, "  -N N      Trials per point; tables show their mean (default: 1)\n");
+    fprintf(stderr, "  -j FILE   Write every trial as JSON results to FILE (\"-\" for stdout)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *modes = "latency,bandwidth,numa";
+    const char *json_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:s:S:p:B:T:t:N:j:h")) != -1) {
+        switch (opt) {
+        case 'm': modes = optarg; break;
+        case 's': cfg.min_bytes = strtoul(optarg, NULL, 0) << 10; break;
+        case 'S': cfg.max_bytes = strtoul(optarg, NULL, 0) << 20; break;
+        case 'p': cfg.points_per_octave = atoi(optarg); break;
+        case 'B': cfg.thread_bytes = strtoul(optarg, NULL, 0) << 20; break;
+        case 'T': cfg.max_threads = atoi(optarg); break;
+        case 't': cfg.point_ms = atof(optarg); break;
+        case 'N': cfg.trials = atoi(optarg); break;
+        case 'j': json_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (cfg.min_bytes < LINE * 8 || cfg.max_bytes < cfg.min_bytes || cfg.points_per_octave < 1 ||
+        cfg.thread_bytes < (1 << 20) || cfg.point_ms <= 0 || cfg.trials < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    bench_init(&results, "mem_hierarchy_bench", argc, argv);
+
+    printf("========================================\n");
+    printf("Memory Hierarchy Benchmark\n");
+    printf("========================================\n");
+    // Inherited, so bandwidth worker threads are counted too
+    int active = counters_open(counters, NUM_COUNTERS, PC_QUIET | PC_INHERIT);
+    printf("Counters available: %d/%d (", active, NUM_COUNTERS);
+    for (int i = 0, first = 1; i < NUM_COUNTERS; i++) {
+        if (counter_available(&counters[i])) {
+            printf("%s%s", first ? "" : ", ", counters[i].name);
+            first = 0;
+        }
+    }
+    printf("); columns are per load (latency, NUMA) or per 64-byte line moved (bandwidth)\n");
+
+    if (strstr(modes, "latency")) run_latency();
+    if (strstr(modes, "bandwidth")) run_bandwidth();
+    if (strstr(modes, "numa")) run_numa();
+
+    counters_close(counters, NUM_COUNTERS);
+    if (json_path && bench_write(&results, json_path) != 0) {
+        perror(json_path);
+        return 1;
+    }
+    bench_free(&results);
+    return 0;
+}
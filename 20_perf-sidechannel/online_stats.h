@@ -0,0 +1,60 @@
+/*
+ * Online (streaming) statistics
+ * Welford running mean/variance and Welch's t-test, updated one sample at
+ * a time without storing the samples
+ */
+
+#ifndef ONLINE_STATS_H
+#define ONLINE_STATS_H
+
+#include <stdint.h>
+#include <math.h>
+
+typedef struct {
+    uint64_t n;
+    double mean;
+    double m2;    // Sum of squared deviations from the running mean
+} welford_t;
+
+static inline void welford_init(welford_t *w) {
+    w->n = 0;
+    w->mean = 0.0;
+    w->m2 = 0.0;
+}
+
+static inline void welford_push(welford_t *w, double x) {
+    double delta = x - w->mean;
+    w->n++;
+    w->mean += delta / w->n;
+    w->m2 += delta * (x - w->mean);
+}
+
+// Sample variance (n - 1 denominator)
+static inline double welford_variance(const welford_t *w) {
+    return w->n > 1 ? w->m2 / (w->n - 1) : 0.0;
+}
+
+// Standard error of the mean
+static inline double welford_stderr(const welford_t *w) {
+    return w->n > 1 ? sqrt(welford_variance(w) / w->n) : INFINITY;
+}
+
+// Welch's t statistic for mean(a) - mean(b); positive when a is larger.
+// Returns 0 until both sides have at least two samples.
+static inline double welch_t(const welford_t *a, const welford_t *b) {
+    if (a->n < 2 || b->n < 2) {
+        return 0.0;
+    }
+    double se = sqrt(welford_variance(a) / a->n + welford_variance(b) / b->n);
+    if (se <= 0.0) {
+        return a->mean == b->mean ? 0.0 : (a->mean > b->mean ? INFINITY : -INFINITY);
+    }
+    return (a->mean - b->mean) / se;
+}
+
+// Standard normal CDF, used as a large-sample approximation of the t CDF
+static inline double normal_cdf(double z) {
+    return 0.5 * erfc(-z / sqrt(2.0));
+}
+
+#endif // ONLINE_STATS_H
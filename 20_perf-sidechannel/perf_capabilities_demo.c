@@ -4,104 +4,52 @@
  * Comprehensive demonstration of Linux perf_event capabilities
  * Shows various hardware and software performance counters
  * 
- * Capabilities demonstrated:
+ * Demos, numbered as in the output:
  * 1. Hardware counters (CPU cycles, instructions, cache, branches)
- * 2. Software counters (page faults, context switches)
- * 3. Cache hierarchy monitoring (L1, L2, LLC)
- * 4. Branch prediction analysis
+ * 2. Cache hierarchy monitoring (L1, L2, LLC)
+ * 3. Branch prediction analysis (branchy vs branchless, SIMD and sorted variants)
+ * 4. Software counters (page faults, context switches)
  * 5. TLB monitoring
- * 6. Multiple counter groups
+ * 6. Huge page comparison (-H): 4 KB vs THP vs hugetlb 2 MB / 1 GB backing
+ *
+ * Also: several counters per workload, PMU event discovery (-l) and custom
+ * symbolic events (-e, see pmu_events.h), JSON results (-j, see
+ * bench_json.h) over repeated runs (-N)
+ *
+ * Hardware events are given as specs with per-architecture fallbacks, so
+ * the same binary counts on x86 and ARM; a counter that no alternative
+ * resolves for is reported as not available rather than as 0.
  * 
  * Compile: gcc -O2 -o perf_capabilities_demo perf_capabilities_demo.c
- * Run: sudo ./perf_capabilities_demo
+ * Run: sudo ./perf_capabilities_demo [-H] [-s MB] [-n accesses] [-l] [-e spec]... [-N trials] [-j file]
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/perf_event.h>
-#include <asm/unistd.h>
 #include <errno.h>
 #include <stdint.h>
 #include <time.h>
+#include <cpuid.h>
+#include <sys/mman.h>
 
-// Perf event syscall wrapper
-static long perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
-                           int cpu, int group_fd, unsigned long flags) {
-    return syscall(__NR_perf_event_open, hw_event, pid, cpu, group_fd, flags);
-}
+#include "perf_counter.h"
+#include "bench_json.h"
 
-// Hardware counter configuration
-typedef struct {
-    const char *name;
-    uint32_t type;
-    uint64_t config;
-    int fd;
-    uint64_t value;
-} PerfCounter;
-
-// Initialize a perf counter
-int init_counter(PerfCounter *counter) {
-    struct perf_event_attr pe;
-    
-    memset(&pe, 0, sizeof(struct perf_event_attr));
-    pe.type = counter->type;
-    pe.size = sizeof(struct perf_event_attr);
-    pe.config = counter->config;
-    pe.disabled = 1;
-    pe.exclude_kernel = 0;
-    pe.exclude_hv = 1;
-    
-    counter->fd = perf_event_open(&pe, 0, -1, -1, 0);
-    if (counter->fd == -1) {
-        fprintf(stderr, "Warning: Failed to open %s: %s\n", 
-                counter->name, strerror(errno));
-        return -1;
-    }
-    return 0;
-}
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PCD_HAVE_SIMD 1
+#else
+#define PCD_HAVE_SIMD 0
+#endif
 
-// Read counter value
-void read_counter(PerfCounter *counter) {
-    if (counter->fd != -1) {
-        if (read(counter->fd, &counter->value, sizeof(uint64_t)) == -1) {
-            counter->value = 0;
-        }
-    } else {
-        counter->value = 0;
-    }
-}
-
-// Reset counter
-void reset_counter(PerfCounter *counter) {
-    if (counter->fd != -1) {
-        ioctl(counter->fd, PERF_EVENT_IOC_RESET, 0);
-    }
-}
-
-// Enable counter
-void enable_counter(PerfCounter *counter) {
-    if (counter->fd != -1) {
-        ioctl(counter->fd, PERF_EVENT_IOC_ENABLE, 0);
-    }
-}
-
-// Disable counter
-void disable_counter(PerfCounter *counter) {
-    if (counter->fd != -1) {
-        ioctl(counter->fd, PERF_EVENT_IOC_DISABLE, 0);
-    }
-}
-
-// Close counter
-void close_counter(PerfCounter *counter) {
-    if (counter->fd != -1) {
-        close(counter->fd);
-        counter->fd = -1;
-    }
-}
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
 
 // ============================================================================
 // Workload Functions for Testing
@@ -160,6 +108,95 @@ void unpredictable_branches(int iterations) {
     }
 }
 
+// Reduction variants over a pre-generated input: sum of elements >= 128.
+// The empty asm statements keep the compiler from turning the branchy loop
+// into a cmov and from vectorizing the scalar ones, so each variant really
+// is the code its name says.
+#define BRANCH_ELEMENTS (1 << 20)
+#define BRANCH_THRESHOLD 128
+
+__attribute__((noinline))
+static int64_t sum_branchy(const int32_t *data, size_t n) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (data[i] >= BRANCH_THRESHOLD) {
+            sum += data[i];
+            __asm__ volatile("" : "+r"(sum));
+        }
+    }
+    return sum;
+}
+
+__attribute__((noinline))
+static int64_t sum_branchless(const int32_t *data, size_t n) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = data[i];
+        sum += v >= BRANCH_THRESHOLD ? v : 0;   // cmov, no jump on the data
+        __asm__("" : "+r"(sum));
+    }
+    return sum;
+}
+
+#if PCD_HAVE_SIMD
+__attribute__((target("avx2"), noinline))
+static int64_t sum_masked_avx2(const int32_t *data, size_t n) {
+    const __m256i limit = _mm256_set1_epi32(BRANCH_THRESHOLD - 1);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+
+    // Per-lane int32 sums cannot overflow for BRANCH_ELEMENTS values < 256
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        acc = _mm256_add_epi32(acc, _mm256_and_si256(v, _mm256_cmpgt_epi32(v, limit)));
+    }
+    int32_t lanes[8];
+    int64_t sum = 0;
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    for (int l = 0; l < 8; l++) sum += lanes[l];
+    return sum + sum_branchless(data + i, n - i);
+}
+
+__attribute__((noinline))
+static int64_t sum_masked_sse2(const int32_t *data, size_t n) {
+    const __m128i limit = _mm_set1_epi32(BRANCH_THRESHOLD - 1);
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        acc = _mm_add_epi32(acc, _mm_and_si128(v, _mm_cmpgt_epi32(v, limit)));
+    }
+    int32_t lanes[4];
+    int64_t sum = 0;
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    for (int l = 0; l < 4; l++) sum += lanes[l];
+    return sum + sum_branchless(data + i, n - i);
+}
+
+static int have_avx2(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2");
+    }
+    return cached;
+}
+#endif
+
+static int64_t sum_masked(const int32_t *data, size_t n) {
+#if PCD_HAVE_SIMD
+    return have_avx2() ? sum_masked_avx2(data, n) : sum_masked_sse2(data, n);
+#else
+    return sum_branchless(data, n);
+#endif
+}
+
+static int compare_int32(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
 // TLB-intensive workload
 void tlb_intensive_work() {
     const int num_pages = 10000;
@@ -195,6 +232,24 @@ void tlb_intensive_work() {
 // Demonstration Functions
 // ============================================================================
 
+// Every value printed below is also recorded as one trial of "<test>/<name>"
+static bench_results_t results;
+
+// One result line; says which fallback was used, or why there is no value
+static void print_counter(const char *test, const PerfCounter *counter) {
+    if (!counter_available(counter)) {
+        printf("  %-20s: not available\n", counter->name);
+        return;
+    }
+    bench_record(&results, "count", BENCH_LOWER, counter->value, "%s/%s", test, counter->name);
+    const char *fallback = counter_fallback(counter);
+    if (fallback) {
+        printf("  %-20s: %lu  [%s]\n", counter->name, counter->value, fallback);
+    } else {
+        printf("  %-20s: %lu\n", counter->name, counter->value);
+    }
+}
+
 void demo_basic_hw_counters() {
     printf("\n");
     printf("========================================\n");
@@ -202,10 +257,10 @@ void demo_basic_hw_counters() {
     printf("========================================\n");
     
     PerfCounter counters[] = {
-        {"CPU Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0},
-        {"Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0},
-        {"Cache References", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, -1, 0},
-        {"Cache Misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, 0},
+        PERF_COUNTER_SPEC("CPU Cycles", "cycles|cpu_cycles"),
+        PERF_COUNTER_SPEC("Instructions", "instructions|inst_retired"),
+        PERF_COUNTER_SPEC("Cache References", "cache-references|l1d_cache"),
+        PERF_COUNTER_SPEC("Cache Misses", "cache-misses|l1d_cache_refill"),
     };
     int num_counters = sizeof(counters) / sizeof(counters[0]);
     
@@ -232,19 +287,21 @@ void demo_basic_hw_counters() {
     // Display results
     printf("\nResults:\n");
     for (int i = 0; i < num_counters; i++) {
-        printf("  %-20s: %lu\n", counters[i].name, counters[i].value);
+        print_counter("basic", &counters[i]);
     }
     
     // Calculate IPC (Instructions Per Cycle)
     if (counters[0].value > 0) {
         double ipc = (double)counters[1].value / counters[0].value;
         printf("\n  IPC (Instructions/Cycle): %.2f\n", ipc);
+        bench_record(&results, "IPC", BENCH_HIGHER, ipc, "basic/IPC");
     }
     
     // Calculate cache miss rate
     if (counters[2].value > 0) {
         double miss_rate = (double)counters[3].value / counters[2].value * 100.0;
         printf("  Cache Miss Rate: %.2f%%\n", miss_rate);
+        bench_record(&results, "%", BENCH_LOWER, miss_rate, "basic/Cache Miss Rate");
     }
     
     // Cleanup
@@ -260,18 +317,11 @@ void demo_cache_hierarchy() {
     printf("========================================\n");
     
     PerfCounter counters[] = {
-        {"L1D Read Access", PERF_TYPE_HW_CACHE, 
-         (PERF_COUNT_HW_CACHE_L1D) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
-         (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16), -1, 0},
-        {"L1D Read Miss", PERF_TYPE_HW_CACHE,
-         (PERF_COUNT_HW_CACHE_L1D) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
-         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1, 0},
-        {"L1I Read Miss", PERF_TYPE_HW_CACHE,
-         (PERF_COUNT_HW_CACHE_L1I) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
-         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1, 0},
-        {"LLC Read Miss", PERF_TYPE_HW_CACHE,
-         (PERF_COUNT_HW_CACHE_LL) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
-         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1, 0},
+        PERF_COUNTER_SPEC("L1D Read Access", "L1-dcache-loads|l1d_cache_rd|l1d_cache"),
+        PERF_COUNTER_SPEC("L1D Read Miss", "L1-dcache-load-misses|l1d_cache_refill_rd|l1d_cache_refill"),
+        PERF_COUNTER_SPEC("L1I Read Miss", "L1-icache-load-misses|l1i_cache_refill"),
+        // No L3 on many ARM cores: the L2 is the last level
+        PERF_COUNTER_SPEC("LLC Read Miss", "LLC-load-misses|ll_cache_miss_rd|l2d_cache_refill"),
     };
     int num_counters = sizeof(counters) / sizeof(counters[0]);
     
@@ -306,15 +356,14 @@ void demo_cache_hierarchy() {
     // Display results
     printf("\nResults:\n");
     for (int i = 0; i < num_counters; i++) {
-        if (counters[i].fd != -1) {
-            printf("  %-20s: %lu\n", counters[i].name, counters[i].value);
-        }
+        print_counter("cache", &counters[i]);
     }
     
     // Calculate L1D miss rate
     if (counters[0].fd != -1 && counters[0].value > 0) {
         double l1d_miss_rate = (double)counters[1].value / counters[0].value * 100.0;
         printf("\n  L1D Miss Rate: %.2f%%\n", l1d_miss_rate);
+        bench_record(&results, "%", BENCH_LOWER, l1d_miss_rate, "cache/L1D Miss Rate");
     }
     
     // Cleanup
@@ -330,8 +379,8 @@ void demo_branch_prediction() {
     printf("========================================\n");
     
     PerfCounter counters[] = {
-        {"Branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, -1, 0},
-        {"Branch Misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, 0},
+        PERF_COUNTER_SPEC("Branches", "branches|br_retired|pc_write_retired|br_pred"),
+        PERF_COUNTER_SPEC("Branch Misses", "branch-misses|br_mis_pred_retired|br_mis_pred"),
     };
     int num_counters = sizeof(counters) / sizeof(counters[0]);
     
@@ -356,11 +405,12 @@ void demo_branch_prediction() {
     
     printf("Results:\n");
     for (int i = 0; i < num_counters; i++) {
-        printf("  %-20s: %lu\n", counters[i].name, counters[i].value);
+        print_counter("branch/predictable", &counters[i]);
     }
     if (counters[0].value > 0) {
         double miss_rate = (double)counters[1].value / counters[0].value * 100.0;
         printf("  Branch Miss Rate: %.2f%%\n", miss_rate);
+        bench_record(&results, "%", BENCH_LOWER, miss_rate, "branch/predictable/Branch Miss Rate");
     }
     
     // Test 2: Unpredictable branches
@@ -379,12 +429,88 @@ void demo_branch_prediction() {
     
     printf("Results:\n");
     for (int i = 0; i < num_counters; i++) {
-        printf("  %-20s: %lu\n", counters[i].name, counters[i].value);
+        print_counter("branch/random", &counters[i]);
     }
     if (counters[0].value > 0) {
         double miss_rate = (double)counters[1].value / counters[0].value * 100.0;
         printf("  Branch Miss Rate: %.2f%% (higher due to randomness)\n", miss_rate);
+        bench_record(&results, "%", BENCH_LOWER, miss_rate, "branch/random/Branch Miss Rate");
+    }
+    
+    // Test 3: the same reduction, written four ways, over one random input.
+    // Generating the input up front keeps rand() out of the measurement.
+    printf("\nTest 3: sum of elements >= %d over %d pre-generated random values...\n",
+           BRANCH_THRESHOLD, BRANCH_ELEMENTS);
+    int32_t *random_data = malloc(BRANCH_ELEMENTS * sizeof(int32_t));
+    int32_t *sorted_data = malloc(BRANCH_ELEMENTS * sizeof(int32_t));
+    if (!random_data || !sorted_data) {
+        fprintf(stderr, "Out of memory for the branch inputs\n");
+        free(random_data);
+        free(sorted_data);
+        counters_close(counters, num_counters);
+        return;
     }
+    srand(42);
+    for (int i = 0; i < BRANCH_ELEMENTS; i++) {
+        random_data[i] = rand() % 256;
+    }
+    memcpy(sorted_data, random_data, BRANCH_ELEMENTS * sizeof(int32_t));
+    qsort(sorted_data, BRANCH_ELEMENTS, sizeof(int32_t), compare_int32);
+
+    struct {
+        const char *name;
+        int64_t (*fn)(const int32_t *, size_t);
+        const int32_t *data;
+    } variants[] = {
+        {"branchy, random", sum_branchy, random_data},
+        {"branchy, sorted", sum_branchy, sorted_data},
+        {"branchless (cmov)", sum_branchless, random_data},
+#if PCD_HAVE_SIMD
+        {have_avx2() ? "SIMD mask (AVX2)" : "SIMD mask (SSE2)", sum_masked, random_data},
+#else
+        {"SIMD mask (scalar)", sum_masked, random_data},
+#endif
+    };
+    const int passes = 10;
+    int64_t expected = sum_branchy(random_data, BRANCH_ELEMENTS);
+
+    printf("\n  %-20s %14s %12s %12s\n", "Variant", "Branches/elem", "Miss Rate", "ns/element");
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        int64_t result = variants[v].fn(variants[v].data, BRANCH_ELEMENTS);  // Warm-up
+        struct timespec t0, t1;
+
+        for (int i = 0; i < num_counters; i++) {
+            reset_counter(&counters[i]);
+            enable_counter(&counters[i]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int p = 0; p < passes; p++) {
+            result = variants[v].fn(variants[v].data, BRANCH_ELEMENTS);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < num_counters; i++) {
+            disable_counter(&counters[i]);
+            read_counter(&counters[i]);
+        }
+
+        double elements = (double)BRANCH_ELEMENTS * passes;
+        double ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / elements;
+        char branches[16] = "-", miss_rate[16] = "-";
+        if (counter_available(&counters[0]) && counters[0].value > 0) {
+            snprintf(branches, sizeof(branches), "%.3f", counters[0].value / elements);
+            snprintf(miss_rate, sizeof(miss_rate), "%.2f%%",
+                     (double)counters[1].value / counters[0].value * 100.0);
+            bench_record(&results, "per element", BENCH_INFO, counters[0].value / elements,
+                         "branch/%s/branches_per_element", variants[v].name);
+            bench_record(&results, "%", BENCH_LOWER, (double)counters[1].value / counters[0].value * 100.0,
+                         "branch/%s/miss_rate", variants[v].name);
+        }
+        bench_record(&results, "ns", BENCH_LOWER, ns, "branch/%s/ns_per_element", variants[v].name);
+        printf("  %-20s %14s %12s %12.3f%s\n", variants[v].name, branches, miss_rate, ns,
+               result == expected ? "" : "  (wrong result!)");
+    }
+    free(random_data);
+    free(sorted_data);
     
     // Cleanup
     for (int i = 0; i < num_counters; i++) {
@@ -399,11 +525,11 @@ void demo_software_events() {
     printf("========================================\n");
     
     PerfCounter counters[] = {
-        {"Page Faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, -1, 0},
-        {"Context Switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, -1, 0},
-        {"CPU Migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, -1, 0},
-        {"Minor Faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN, -1, 0},
-        {"Major Faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ, -1, 0},
+        PERF_COUNTER_SPEC("Page Faults", "page-faults"),
+        PERF_COUNTER_SPEC("Context Switches", "context-switches"),
+        PERF_COUNTER_SPEC("CPU Migrations", "cpu-migrations"),
+        PERF_COUNTER_SPEC("Minor Faults", "minor-faults"),
+        PERF_COUNTER_SPEC("Major Faults", "major-faults"),
     };
     int num_counters = sizeof(counters) / sizeof(counters[0]);
     
@@ -430,7 +556,7 @@ void demo_software_events() {
     // Display results
     printf("\nResults:\n");
     for (int i = 0; i < num_counters; i++) {
-        printf("  %-20s: %lu\n", counters[i].name, counters[i].value);
+        print_counter("software", &counters[i]);
     }
     
     // Cleanup
@@ -446,15 +572,9 @@ void demo_tlb_monitoring() {
     printf("========================================\n");
     
     PerfCounter counters[] = {
-        {"dTLB Read Access", PERF_TYPE_HW_CACHE,
-         (PERF_COUNT_HW_CACHE_DTLB) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
-         (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16), -1, 0},
-        {"dTLB Read Miss", PERF_TYPE_HW_CACHE,
-         (PERF_COUNT_HW_CACHE_DTLB) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
-         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1, 0},
-        {"iTLB Read Miss", PERF_TYPE_HW_CACHE,
-         (PERF_COUNT_HW_CACHE_ITLB) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
-         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1, 0},
+        PERF_COUNTER_SPEC("dTLB Read Access", "dTLB-loads|l1d_tlb_rd|l1d_tlb"),
+        PERF_COUNTER_SPEC("dTLB Read Miss", "dTLB-load-misses|l1d_tlb_refill_rd|l1d_tlb_refill"),
+        PERF_COUNTER_SPEC("iTLB Read Miss", "iTLB-load-misses|l1i_tlb_refill"),
     };
     int num_counters = sizeof(counters) / sizeof(counters[0]);
     
@@ -489,15 +609,14 @@ void demo_tlb_monitoring() {
     // Display results
     printf("\nResults:\n");
     for (int i = 0; i < num_counters; i++) {
-        if (counters[i].fd != -1) {
-            printf("  %-20s: %lu\n", counters[i].name, counters[i].value);
-        }
+        print_counter("tlb", &counters[i]);
     }
     
     // Calculate dTLB miss rate
     if (counters[0].fd != -1 && counters[0].value > 0) {
         double dtlb_miss_rate = (double)counters[1].value / counters[0].value * 100.0;
         printf("\n  dTLB Miss Rate: %.2f%%\n", dtlb_miss_rate);
+        bench_record(&results, "%", BENCH_LOWER, dtlb_miss_rate, "tlb/dTLB Miss Rate");
     }
     
     // Cleanup
@@ -507,22 +626,372 @@ void demo_tlb_monitoring() {
 }
 
 // ============================================================================
-// Main
+// Huge Page Comparison
+// ============================================================================
+
+// How one region is backed for the huge page comparison
+typedef struct {
+    const char *name;
+    size_t page_size;
+    int mmap_flags;             // Extra mmap() flags (MAP_HUGETLB | size)
+    int advice;                 // madvise() hint for anonymous memory, -1 for none
+    const char *sysfs;          // hugetlb pool directory, NULL for anonymous memory
+} PageBacking;
+
+static const PageBacking page_backings[] = {
+    {"4 KB pages", 4096, 0, MADV_NOHUGEPAGE, NULL},
+    {"THP (madvise)", 2UL << 20, 0, MADV_HUGEPAGE, NULL},
+    {"hugetlb 2 MB", 2UL << 20, MAP_HUGETLB | MAP_HUGE_2MB, -1,
+     "/sys/kernel/mm/hugepages/hugepages-2048kB"},
+    {"hugetlb 1 GB", 1UL << 30, MAP_HUGETLB | MAP_HUGE_1GB, -1,
+     "/sys/kernel/mm/hugepages/hugepages-1048576kB"},
+};
+
+// Event spec for cycles with a dTLB load page walk in flight. There is no
+// generic perf event or sysfs alias for this; the Intel event moved from
+// 0x08 to 0x12 with Ice Lake. NULL when the CPU is not one we know.
+static const char *page_walk_spec(void) {
+    static const unsigned walk_0x08[] = {   // Haswell .. Comet Lake
+        0x3c, 0x3f, 0x45, 0x46, 0x3d, 0x47, 0x4f, 0x56, 0x4e, 0x5e, 0x55, 0x8e, 0x9e, 0xa5, 0xa6,
+    };
+    static const unsigned walk_0x12[] = {   // Ice Lake and later big cores
+        0x6a, 0x6c, 0x7d, 0x7e, 0x8c, 0x8d, 0x8f, 0xad, 0xae, 0xcf,
+    };
+    unsigned eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx) || ebx != 0x756e6547) {   // "Genu"ineIntel
+        return NULL;
+    }
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (((eax >> 8) & 0xf) != 6) {
+        return NULL;
+    }
+    unsigned model = ((eax >> 4) & 0xf) | ((eax >> 12) & 0xf0);
+
+    for (size_t i = 0; i < sizeof(walk_0x12) / sizeof(walk_0x12[0]); i++) {
+        if (model == walk_0x12[i]) {
+            return "cpu/event=0x12,umask=0x10,cmask=1/";   // DTLB_LOAD_MISSES.WALK_ACTIVE
+        }
+    }
+    for (size_t i = 0; i < sizeof(walk_0x08) / sizeof(walk_0x08[0]); i++) {
+        if (model == walk_0x08[i]) {
+            return "cpu/event=0x08,umask=0x10,cmask=1/";   // DTLB_LOAD_MISSES.WALK_DURATION/ACTIVE
+        }
+    }
+    return NULL;
+}
+
+// Size of the huge pages backing [addr, ...) according to /proc/self/smaps
+static size_t anon_huge_bytes(const void *addr) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    char line[256];
+    int in_vma = 0;
+    size_t kb = 0;
+
+    if (!f) return 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            in_vma = (start == (unsigned long)addr);
+        } else if (in_vma && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+    return kb * 1024;
+}
+
+// Map a region of at least len bytes with the given backing. *raw / *raw_len
+// is what to munmap(); the returned pointer is aligned to the page size.
+static char *map_backing(const PageBacking *b, size_t len, void **raw, size_t *raw_len) {
+    size_t map_len = (len + b->page_size - 1) & ~(b->page_size - 1);
+
+    if (b->mmap_flags) {
+        char *p = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | b->mmap_flags, -1, 0);
+        if (p == MAP_FAILED) return NULL;
+        *raw = p;
+        *raw_len = map_len;
+        return p;
+    }
+
+    // Over-allocate so the region can start on a huge page boundary
+    *raw_len = map_len + (2UL << 20);
+    *raw = mmap(NULL, *raw_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (*raw == MAP_FAILED) return NULL;
+    char *p = (char *)(((uintptr_t)*raw + (2UL << 20) - 1) & ~((2UL << 20) - 1));
+    if (b->advice >= 0) {
+        madvise(p, map_len, b->advice);
+    }
+    return p;
+}
+
+// Independent loads from random cache lines of the region; the same seed
+// gives every backing the same access sequence
+static uint64_t random_region_access(const char *region, size_t len, long accesses) {
+    const volatile char *r = region;
+    uint64_t x = 88172645463325252ULL, sum = 0;
+    uint64_t lines = len / 64;
+
+    for (long i = 0; i < accesses; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        sum += r[(uint64_t)(((unsigned __int128)x * lines) >> 64) * 64];
+    }
+    return sum;
+}
+
+void demo_huge_pages(size_t region_mb, long accesses) {
+    printf("\n");
+    printf("========================================\n");
+    printf("Demo 6: Huge Page Comparison\n");
+    printf("========================================\n");
+
+    size_t len = region_mb << 20;
+    const char *walk_spec = page_walk_spec();
+    int have_walk = walk_spec != NULL;
+    PerfCounter counters[] = {
+        PERF_COUNTER_SPEC("CPU Cycles", "cycles|cpu_cycles"),
+        PERF_COUNTER_SPEC("dTLB Read Miss", "dTLB-load-misses|l1d_tlb_refill_rd|l1d_tlb_refill"),
+        PERF_COUNTER_SPEC("Page Walk Cycles", walk_spec),
+        PERF_COUNTER_SPEC("Page Faults", "page-faults"),
+    };
+    int num_counters = sizeof(counters) / sizeof(counters[0]);
+    double base_ns = 0;
+
+    printf("\nRandom loads from a %zu MB region, %ld accesses per backing\n", region_mb, accesses);
+    printf("\n%-14s %6s %14s %14s %10s %9s %8s\n",
+           "Backing", "Huge%", "dTLB miss/acc", "walk cyc/acc", "ns/access", "Macc/s", "vs 4 KB");
+
+    for (size_t b = 0; b < sizeof(page_backings) / sizeof(page_backings[0]); b++) {
+        const PageBacking *pb = &page_backings[b];
+        void *raw;
+        size_t raw_len;
+
+        if (pb->sysfs && access(pb->sysfs, F_OK) != 0) {
+            printf("%-14s unavailable: not supported by this kernel/CPU\n", pb->name);
+            continue;
+        }
+        char *region = map_backing(pb, len, &raw, &raw_len);
+        if (!region) {
+            if (pb->sysfs) {
+                printf("%-14s unavailable: %s (reserve pages via %s/nr_hugepages)\n",
+                       pb->name, strerror(errno), pb->sysfs);
+            } else {
+                printf("%-14s unavailable: %s\n", pb->name, strerror(errno));
+            }
+            continue;
+        }
+
+        // Fault everything in up front so only translation is measured
+        memset(region, 1, len);
+        double huge = pb->sysfs ? 100.0 : 100.0 * anon_huge_bytes(region) / len;
+        if (huge > 100.0) huge = 100.0;
+
+        for (int i = 0; i < num_counters; i++) {
+            if (i == 2 && !have_walk) continue;
+            perf_counter_open(&counters[i], 0, -1, PC_QUIET);
+        }
+        struct timespec t0, t1;
+        counters_start(counters, num_counters);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        volatile uint64_t sum = random_region_access(region, len, accesses);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        counters_stop(counters, num_counters);
+        (void)sum;
+
+        double ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / accesses;
+        if (b == 0) base_ns = ns;
+
+        char miss[16] = "-", walk[16] = "-", speedup[16] = "-";
+        bench_record(&results, "%", BENCH_INFO, huge, "huge_pages/%s/huge_pct", pb->name);
+        bench_record(&results, "ns", BENCH_LOWER, ns, "huge_pages/%s/ns_per_access", pb->name);
+        if (counter_available(&counters[1])) {
+            snprintf(miss, sizeof(miss), "%.3f", (double)counters[1].value / accesses);
+            bench_record(&results, "per access", BENCH_LOWER, (double)counters[1].value / accesses,
+                         "huge_pages/%s/dTLB_miss_per_access", pb->name);
+        }
+        if (counter_available(&counters[2])) {
+            snprintf(walk, sizeof(walk), "%.1f", (double)counters[2].value / accesses);
+            bench_record(&results, "per access", BENCH_LOWER, (double)counters[2].value / accesses,
+                         "huge_pages/%s/walk_cycles_per_access", pb->name);
+        }
+        if (base_ns > 0) {
+            snprintf(speedup, sizeof(speedup), "%.2fx", base_ns / ns);
+        }
+        printf("%-14s %5.0f%% %14s %14s %10.2f %9.1f %8s\n",
+               pb->name, huge, miss, walk, ns, 1e3 / ns, speedup);
+        if (counter_available(&counters[3]) && counters[3].value > 64) {
+            printf("%-14s (%lu page faults during the run)\n", "", counters[3].value);
+        }
+
+        counters_close(counters, num_counters);
+        munmap(raw, raw_len);
+    }
+
+    printf("\n  Huge%%: share of the region actually backed by huge pages\n");
+    printf("  (THP may fall back to 4 KB pages when memory is fragmented)\n");
+    if (!have_walk) {
+        printf("  Page walk cycles: no known raw event for this CPU\n");
+    }
+}
+
+// ============================================================================
+// Custom Events
 // ============================================================================
 
-int main() {
+#define MAX_CUSTOM_EVENTS 16
+
+// Counts user-given event specs (-e) over each workload
+void demo_custom_events(const char **specs, int num_specs) {
+    printf("\n");
     printf("========================================\n");
-    printf("Linux perf_event Capabilities Demo\n");
+    printf("Custom Events\n");
     printf("========================================\n");
-    printf("\nThis program demonstrates various performance\n");
-    printf("monitoring capabilities using perf_event API.\n");
-    
-    demo_basic_hw_counters();
-    demo_cache_hierarchy();
-    demo_branch_prediction();
-    demo_software_events();
-    demo_tlb_monitoring();
-    
+
+    PerfCounter counters[MAX_CUSTOM_EVENTS];
+    int active = 0;
+    for (int i = 0; i < num_specs; i++) {
+        counters[i] = (PerfCounter)PERF_COUNTER_SPEC(specs[i], specs[i]);
+        if (init_counter(&counters[i]) == 0) {
+            active++;
+            printf("  %-32s -> type %u config 0x%llx", specs[i], counters[i].event.type,
+                   (unsigned long long)counters[i].event.config);
+            if (counters[i].event.config1) {
+                printf(" config1 0x%llx", (unsigned long long)counters[i].event.config1);
+            }
+            printf("%s%s\n", counter_fallback(&counters[i]) ? "  via " : "",
+                   counter_fallback(&counters[i]) ? counters[i].event.spec : "");
+        }
+    }
+    if (active == 0) {
+        printf("None of the events could be opened.\n");
+        return;
+    }
+
+    const char *workloads[] = {"cpu", "memory (10 MB)", "branches", "tlb"};
+    printf("\n%-16s", "Workload");
+    for (int i = 0; i < num_specs; i++) {
+        if (counter_available(&counters[i])) printf(" %20.20s", specs[i]);
+    }
+    printf("\n");
+    for (int w = 0; w < 4; w++) {
+        counters_start(counters, num_specs);
+        switch (w) {
+        case 0: cpu_intensive_work(1000000); break;
+        case 1: memory_intensive_work(10); break;
+        case 2: unpredictable_branches(100000); break;
+        case 3: tlb_intensive_work(); break;
+        }
+        counters_stop(counters, num_specs);
+        printf("%-16s", workloads[w]);
+        for (int i = 0; i < num_specs; i++) {
+            if (!counter_available(&counters[i])) continue;
+            bench_record(&results, counters[i].event.scale != 1.0 ? counters[i].event.unit : "count", BENCH_LOWER,
+                         counters[i].value * counters[i].event.scale, "custom/%s/%s", workloads[w], specs[i]);
+            if (counters[i].event.scale != 1.0) {
+                char scaled[32];
+                snprintf(scaled, sizeof(scaled), "%.4g %s",
+                         counters[i].value * counters[i].event.scale, counters[i].event.unit);
+                printf(" %20s", scaled);
+            } else {
+                printf(" %20lu", counters[i].value);
+            }
+        }
+        printf("\n");
+    }
+    counters_close(counters, num_specs);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-H] [-s MB] [-n accesses] [-l] [-e spec]... [-N trials] [-j file]\n", prog);
+    fprintf(stderr, "  -H           Only run the huge page comparison (Demo 6)\n");
+    fprintf(stderr, "  -s MB        Huge page comparison region size (default 512)\n");
+    fprintf(stderr, "  -n accesses  Random accesses per backing (default 20000000)\n");
+    fprintf(stderr, "  -l           List the PMUs, format terms and event aliases in sysfs\n");
+    fprintf(stderr, "  -e spec      Count this event over each workload instead of the demos;\n");
+    fprintf(stderr, "               e.g. cycles, LLC-load-misses, cpu/event=0xd1,umask=0x20/,\n");
+    fprintf(stderr, "               l1d_cache_refill, or alternatives a|b (up to %d)\n", MAX_CUSTOM_EVENTS);
+    fprintf(stderr, "  -N trials    Run the selected demos this many times (default 1)\n");
+    fprintf(stderr, "  -j file      Write every recorded value as JSON results (\"-\" for stdout)\n");
+}
+
+int main(int argc, char *argv[]) {
+    size_t region_mb = 512;
+    long accesses = 20000000;
+    int huge_only = 0, trials = 1, opt;
+    const char *specs[MAX_CUSTOM_EVENTS];
+    int num_specs = 0;
+    const char *json_path = NULL;
+
+    while ((opt = getopt(argc, argv, "Hs:n:le:N:j:h")) != -1) {
+        switch (opt) {
+        case 'H': huge_only = 1; break;
+        case 'l':
+            pmu_list(stdout);
+            return 0;
+        case 'e':
+            if (num_specs == MAX_CUSTOM_EVENTS) {
+                fprintf(stderr, "At most %d events\n", MAX_CUSTOM_EVENTS);
+                return 1;
+            }
+            specs[num_specs++] = optarg;
+            break;
+        case 's': region_mb = strtoul(optarg, NULL, 0); break;
+        case 'n': accesses = atol(optarg); break;
+        case 'N': trials = atoi(optarg); break;
+        case 'j': json_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (region_mb < 1 || accesses < 1 || trials < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    bench_init(&results, "perf_capabilities_demo", argc, argv);
+
+    if (!huge_only && !num_specs) {
+        printf("========================================\n");
+        printf("Linux perf_event Capabilities Demo\n");
+        printf("========================================\n");
+        printf("\nThis program demonstrates various performance\n");
+        printf("monitoring capabilities using perf_event API.\n");
+    }
+
+    for (int t = 0; t < trials; t++) {
+        if (trials > 1) {
+            printf("\n#### Trial %d/%d ####\n", t + 1, trials);
+        }
+        if (huge_only) {
+            demo_huge_pages(region_mb, accesses);
+        } else if (num_specs) {
+            demo_custom_events(specs, num_specs);
+        } else {
+            demo_basic_hw_counters();
+            demo_cache_hierarchy();
+            demo_branch_prediction();
+            demo_software_events();
+            demo_tlb_monitoring();
+            demo_huge_pages(region_mb, accesses);
+        }
+    }
+
+    if (json_path && bench_write(&results, json_path) != 0) {
+        perror(json_path);
+        return 1;
+    }
+    bench_free(&results);
+    if (huge_only || num_specs) {
+        return 0;
+    }
+
     printf("\n");
     printf("========================================\n");
     printf("Demo Complete!\n");
@@ -0,0 +1,194 @@
+/**
+ * perf_counter.h
+ *
+ * Minimal perf_event counter helpers shared by perf_capabilities_demo and
+ * mem_hierarchy_bench.
+ *
+ * Counters are opened with TOTAL_TIME_ENABLED / TOTAL_TIME_RUNNING, so a
+ * value read while the PMU was multiplexing is scaled up to the full
+ * interval. A counter that cannot be opened keeps fd == -1 and reads as 0;
+ * counter_available() tells the two apart.
+ *
+ * A counter either gives type/config directly or a symbolic spec with
+ * fallbacks ("L1-dcache-load-misses|l1d_cache_refill"), resolved through
+ * pmu_events.h when it is opened.
+ */
+
+#ifndef PERF_COUNTER_H
+#define PERF_COUNTER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "pmu_events.h"
+
+// perf_counter_open() flags
+#define PC_QUIET   0x1          // No warning when the event is unavailable
+#define PC_INHERIT 0x2          // Also count threads created after opening
+
+// Hardware counter configuration
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+    uint64_t value;             // Scaled for multiplexing
+    double running;             // Fraction of the interval actually counted
+    const char *spec;           // Event spec alternatives, NULL to use type/config
+    pmu_event_t event;          // What spec resolved to
+} PerfCounter;
+
+#define PERF_COUNTER_SPEC(counter_name, event_spec) \
+    { .name = (counter_name), .fd = -1, .spec = (event_spec) }
+
+// Perf event syscall wrapper
+static inline long perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
+                                   int cpu, int group_fd, unsigned long flags) {
+    return syscall(__NR_perf_event_open, hw_event, pid, cpu, group_fd, flags);
+}
+
+static inline int perf_counter_open(PerfCounter *counter, pid_t pid, int cpu, int flags) {
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(struct perf_event_attr));
+    counter->value = 0;
+    counter->running = 0;
+    counter->fd = -1;
+    if (counter->spec) {
+        char err[512];
+        if (pmu_resolve(counter->spec, &counter->event, err, sizeof(err)) != 0) {
+            if (!(flags & PC_QUIET)) {
+                fprintf(stderr, "Warning: Failed to open %s: %s\n", counter->name, err);
+            }
+            return -1;
+        }
+        counter->type = counter->event.type;
+        counter->config = counter->event.config;
+        pmu_attr(&counter->event, &pe);
+    } else {
+        pe.type = counter->type;
+        pe.size = sizeof(struct perf_event_attr);
+        pe.config = counter->config;
+        pe.exclude_hv = 1;
+    }
+    pe.disabled = 1;
+    pe.inherit = (flags & PC_INHERIT) ? 1 : 0;
+    pe.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    counter->fd = perf_event_open(&pe, pid, cpu, -1, 0);
+    if (counter->fd == -1) {
+        if (!(flags & PC_QUIET)) {
+            fprintf(stderr, "Warning: Failed to open %s: %s\n",
+                    counter->name, strerror(errno));
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Initialize a perf counter for the calling process
+static inline int init_counter(PerfCounter *counter) {
+    return perf_counter_open(counter, 0, -1, 0);
+}
+
+static inline int counter_available(const PerfCounter *counter) {
+    return counter->fd != -1;
+}
+
+// The alternative a spec resolved to when it is not the first one, else NULL
+static inline const char *counter_fallback(const PerfCounter *counter) {
+    if (!counter->spec || counter->fd == -1) return NULL;
+    size_t n = strlen(counter->event.spec);
+    int first = !strncmp(counter->spec, counter->event.spec, n) &&
+                (counter->spec[n] == '\0' || counter->spec[n] == '|');
+    return first ? NULL : counter->event.spec;
+}
+
+// Read counter value
+static inline void read_counter(PerfCounter *counter) {
+    uint64_t buf[3];            // value, time enabled, time running
+
+    counter->value = 0;
+    counter->running = 0;
+    if (counter->fd == -1 || read(counter->fd, buf, sizeof(buf)) != sizeof(buf)) {
+        return;
+    }
+    if (buf[2] > 0) {
+        counter->value = buf[2] < buf[1] ? (uint64_t)((double)buf[0] * buf[1] / buf[2]) : buf[0];
+        counter->running = buf[1] ? (double)buf[2] / buf[1] : 1.0;
+    }
+}
+
+// Reset counter
+static inline void reset_counter(PerfCounter *counter) {
+    if (counter->fd != -1) {
+        ioctl(counter->fd, PERF_EVENT_IOC_RESET, 0);
+    }
+}
+
+// Enable counter
+static inline void enable_counter(PerfCounter *counter) {
+    if (counter->fd != -1) {
+        ioctl(counter->fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+// Disable counter
+static inline void disable_counter(PerfCounter *counter) {
+    if (counter->fd != -1) {
+        ioctl(counter->fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+// Close counter
+static inline void close_counter(PerfCounter *counter) {
+    if (counter->fd != -1) {
+        close(counter->fd);
+        counter->fd = -1;
+    }
+}
+
+// ============================================================================
+// Counter sets
+// ============================================================================
+
+// Open every counter of a set; returns how many are available
+static inline int counters_open(PerfCounter *counters, int n, int flags) {
+    int active = 0;
+    for (int i = 0; i < n; i++) {
+        if (perf_counter_open(&counters[i], 0, -1, flags) == 0) {
+            active++;
+        }
+    }
+    return active;
+}
+
+static inline void counters_start(PerfCounter *counters, int n) {
+    for (int i = 0; i < n; i++) {
+        reset_counter(&counters[i]);
+        enable_counter(&counters[i]);
+    }
+}
+
+static inline void counters_stop(PerfCounter *counters, int n) {
+    for (int i = 0; i < n; i++) {
+        disable_counter(&counters[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        read_counter(&counters[i]);
+    }
+}
+
+static inline void counters_close(PerfCounter *counters, int n) {
+    for (int i = 0; i < n; i++) {
+        close_counter(&counters[i]);
+    }
+}
+
+#endif // PERF_COUNTER_H
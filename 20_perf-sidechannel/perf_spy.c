@@ -2,152 +2,753 @@
  * Perf Spy Process
  * Uses Linux perf events to monitor cache behavior of victim process
  * Demonstrates side-channel attack via cache timing
+ *
+ * Two modes:
+ *   perf_spy PID       print counter deltas once per second, for every
+ *                      thread of PID including ones it creates later
+ *                      (-T adds a row per thread)
+ *   perf_spy -r NAME   follow the victim's shared-memory ring NAME
+ *                      (aes_victim -r NAME) and read the counters every
+ *                      time new encryptions appear, writing one record per
+ *                      read to ring NAME.spy and optionally a CSV trace
+ *
+ * Events default to L1D/L1I/LLC misses and cache references, each with
+ * ARM fallbacks; -e replaces them with any spec pmu_events.h understands.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
+#include <dirent.h>
+#include <time.h>
 #include <sys/syscall.h>
 #include <linux/perf_event.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <errno.h>
 
+#include "cache_ctl.h"
+#include "sample_ring.h"
+#include "pmu_events.h"
+
+#define RING_BATCH 4096
+#define SCAN_INTERVAL 0.01      // Seconds between /proc/PID/task rescans
+
+// setup_perf_counter() / open_counter_group() flags
+#define SPY_INHERIT 0x1         // Also count threads and processes created later
+#define SPY_QUIET   0x2         // No message when an event cannot be opened
+#define SPY_SCALED  0x4         // Scale group reads for PMU multiplexing
+
 static long perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
                             int cpu, int group_fd, unsigned long flags) {
     return syscall(__NR_perf_event_open, hw_event, pid, cpu, group_fd, flags);
 }
 
 typedef struct {
-    int fd;
     const char *name;
-} perf_counter_t;
+    const char *spec;           // Alternatives, best first (see pmu_events.h)
+} spy_event_t;
+
+static const spy_event_t default_events[SR_MAX_COUNTERS] = {
+    // L1 data cache misses
+    { "L1D Cache Misses", "L1-dcache-load-misses|l1d_cache_refill" },
+    // L1 instruction cache misses
+    { "L1I Cache Misses", "L1-icache-load-misses|l1i_cache_refill" },
+    // LLC (Last Level Cache) misses; the L2 on ARM cores without an L3
+    { "LLC Cache Misses", "LLC-load-misses|ll_cache_miss_rd|l2d_cache_refill" },
+    // Cache references
+    { "Cache References", "cache-references|l1d_cache" },
+};
+
+// Events in use (the defaults or -e) and what each resolved to
+static spy_event_t spy_events[SR_MAX_COUNTERS];
+static pmu_event_t spy_resolved[SR_MAX_COUNTERS];
+static int spy_ok[SR_MAX_COUNTERS];
+static int spy_nevents;
+
+static volatile sig_atomic_t stop_requested = 0;
 
-int setup_perf_counter(pid_t target_pid, __u32 type, __u64 config, const char *name) {
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// group_fd -1 opens a standalone counter (or a group leader when
+// read_format has PERF_FORMAT_GROUP); members pass the leader's fd
+int setup_perf_counter(pid_t target_pid, const pmu_event_t *event, const char *name,
+                       int group_fd, __u64 read_format, int flags) {
     struct perf_event_attr pe;
-    
+
     memset(&pe, 0, sizeof(struct perf_event_attr));
-    pe.type = type;
-    pe.size = sizeof(struct perf_event_attr);
-    pe.config = config;
-    pe.disabled = 1;
-    pe.exclude_kernel = 0;
-    pe.exclude_hv = 1;
-    
-    int fd = perf_event_open(&pe, target_pid, -1, -1, 0);
+    pmu_attr(event, &pe);
+    pe.disabled = group_fd == -1;
+    pe.inherit = (flags & SPY_INHERIT) ? 1 : 0;
+    pe.read_format = read_format;
+
+    int fd = perf_event_open(&pe, target_pid, -1, group_fd, 0);
     if (fd == -1) {
-        fprintf(stderr, "Error opening %s: %s\n", name, strerror(errno));
+        if (!(flags & SPY_QUIET)) {
+            fprintf(stderr, "Error opening %s: %s\n", name, strerror(errno));
+        }
         return -1;
     }
-    
+
     return fd;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <target_pid>\n", argv[0]);
-        fprintf(stderr, "Example: %s $(pgrep aes_victim)\n", argv[0]);
-        return 1;
+// Resolves every event spec once; the ones that fail are reported and skipped
+static int resolve_spy_events(void) {
+    int usable = 0;
+    for (int e = 0; e < spy_nevents; e++) {
+        char err[512];
+        spy_ok[e] = pmu_resolve(spy_events[e].spec, &spy_resolved[e], err, sizeof(err)) == 0;
+        if (!spy_ok[e]) {
+            fprintf(stderr, "Error opening %s: %s\n", spy_events[e].name, err);
+        } else if (strcmp(spy_resolved[e].spec, spy_events[e].spec)) {
+            printf("%s: using %s\n", spy_events[e].name, spy_resolved[e].spec);
+        }
+        usable += spy_ok[e];
     }
-    
-    pid_t target_pid = atoi(argv[1]);
-    
+    return usable;
+}
+
+static void print_setup_help(void) {
+    fprintf(stderr, "Failed to setup any performance counters\n");
+    fprintf(stderr, "Make sure you have root privileges and perf events are enabled\n");
+    fprintf(stderr, "Try: echo -1 | sudo tee /proc/sys/kernel/perf_event_paranoid\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-e spec]... [-T] [-t seconds] <target_pid>\n", prog);
+    fprintf(stderr, "       %s [-e spec]... -r ring_name [-o trace.csv] [-t seconds] [-C capacity]\n", prog);
+    fprintf(stderr, "       %s -l\n", prog);
+    fprintf(stderr, "  -e  count this event instead of the defaults (up to %d), e.g.\n", SR_MAX_COUNTERS);
+    fprintf(stderr, "      LLC-load-misses, cpu/event=0xd1,umask=0x20/, l1d_cache_refill, a|b\n");
+    fprintf(stderr, "  -l  list the PMUs, format terms and event aliases in sysfs\n");
+    fprintf(stderr, "  -T  one row per thread every second, not just the totals\n");
+    fprintf(stderr, "Example: %s $(pgrep aes_victim)\n", prog);
+    fprintf(stderr, "         %s -r aes -o trace.csv   (with: aes_victim -r aes)\n", prog);
+}
+
+// ============================================================================
+// Counter groups
+// ============================================================================
+
+typedef struct {
+    int fds[SR_MAX_COUNTERS];
+    const char *names[SR_MAX_COUNTERS];
+    int n;
+    int scaled;
+} counter_group_t;
+
+// All counters in one group, so a single read() returns them together.
+// Only the spy_events whose bit is set in `events` are tried; returns the
+// mask of the ones that opened, 0 when none did
+static unsigned open_counter_group(counter_group_t *g, pid_t pid, unsigned events, int flags) {
+    __u64 read_format = PERF_FORMAT_GROUP;
+    unsigned opened = 0;
+
+    if (flags & SPY_SCALED) {
+        read_format |= PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    }
+    g->n = 0;
+    g->scaled = (flags & SPY_SCALED) != 0;
+    for (int e = 0; e < spy_nevents; e++) {
+        if (!spy_ok[e] || !(events & (1u << e))) continue;
+        int fd = setup_perf_counter(pid, &spy_resolved[e], spy_events[e].name,
+                                    g->n ? g->fds[0] : -1, read_format, flags);
+        if (fd >= 0) {
+            g->fds[g->n] = fd;
+            g->names[g->n] = spy_events[e].name;
+            g->n++;
+            opened |= 1u << e;
+        }
+    }
+    if (g->n == 0) return 0;
+    ioctl(g->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return opened;
+}
+
+static int read_counter_group(const counter_group_t *g, uint64_t *values) {
+    uint64_t buf[3 + SR_MAX_COUNTERS];
+    int skip = g->scaled ? 3 : 1;   // nr [, time_enabled, time_running]
+    ssize_t want = (ssize_t)((skip + g->n) * sizeof(uint64_t));
+    if (read(g->fds[0], buf, want) != want || buf[0] != (uint64_t)g->n) {
+        return -1;
+    }
+    for (int i = 0; i < g->n; i++) {
+        values[i] = buf[skip + i];
+        if (g->scaled && buf[2] > 0 && buf[2] < buf[1]) {
+            values[i] = (uint64_t)((double)values[i] * buf[1] / buf[2]);
+        }
+    }
+    return 0;
+}
+
+static void close_counter_group(counter_group_t *g) {
+    for (int i = g->n - 1; i >= 0; i--) {
+        close(g->fds[i]);
+    }
+    g->n = 0;
+}
+
+// ============================================================================
+// Per-second mode
+// ============================================================================
+//
+// Every thread listed when we attach becomes a root: an inherited counter
+// group on it also counts every thread (and process) it creates
+// afterwards, so the roots sum to exact totals. The list is read in full
+// before the first root opens. A thread that appears later may already
+// be counted by its creator's root, and making it a root too would count
+// it twice, so it only gets a row. For the per-TID rows each
+// thread gets its own non-inherited group, opened when a /proc/PID/task
+// rescan (every SCAN_INTERVAL) first sees it; a thread missing from a
+// rescan has exited. Whatever the rows miss (threads shorter than a
+// rescan, the moments before a new thread's group is opened, child
+// processes) shows up as "(other)".
+//
+// perf can report thread creation itself (attr.task FORK/EXIT records),
+// but the kernel refuses to mmap an inherited per-task event, and per-CPU
+// buffers would cost threads x CPUs file descriptors.
+
+typedef struct {
+    pid_t tid;
+    counter_group_t total;          // Inherited
+} spy_root_t;
+
+typedef struct {
+    pid_t tid;
+    char comm[16];
+    int alive;
+    int seen;                       // Present in the latest rescan
+    counter_group_t own;            // n == 0 if it could not be opened
+    uint64_t prev[SR_MAX_COUNTERS];
+    uint64_t now[SR_MAX_COUNTERS];
+} spy_thread_t;
+
+typedef struct {
+    pid_t pid;
+    unsigned events;                // spy_events that opened on the first thread
+    int ncounters;
+    const char *names[SR_MAX_COUNTERS];
+    spy_root_t *roots;
+    int nroots;
+    spy_thread_t *threads;
+    int nthreads, cap;
+    int created, exited;
+    int dropped;                    // Threads left without counters (not because they exited)
+    int drop_errno;                 // Why, for the warning
+} spy_target_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void read_comm(pid_t pid, pid_t tid, char *comm) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/comm", pid, tid);
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+    if (fgets(comm, 16, f)) comm[strcspn(comm, "\n")] = '\0';
+    fclose(f);
+}
+
+static spy_thread_t *find_thread(spy_target_t *t, pid_t tid) {
+    for (int i = 0; i < t->nthreads; i++) {
+        if (t->threads[i].tid == tid && t->threads[i].alive) return &t->threads[i];
+    }
+    return NULL;
+}
+
+static spy_thread_t *add_thread(spy_target_t *t, pid_t tid) {
+    if (t->nthreads == t->cap) {
+        int cap = t->cap ? t->cap * 2 : 64;
+        spy_thread_t *grown = realloc(t->threads, cap * sizeof(spy_thread_t));
+        if (!grown) return NULL;
+        t->threads = grown;
+        t->cap = cap;
+    }
+    spy_thread_t *th = &t->threads[t->nthreads++];
+    memset(th, 0, sizeof(*th));
+    th->tid = tid;
+    th->alive = 1;
+    snprintf(th->comm, sizeof(th->comm), "?");
+    read_comm(t->pid, tid, th->comm);
+    // A thread that exits before this opens just never gets its own row
+    if (!open_counter_group(&th->own, tid, t->events, SPY_QUIET | SPY_SCALED) && errno != ESRCH) {
+        t->drop_errno = errno;
+        t->dropped++;
+    }
+    return th;
+}
+
+static void thread_exited(spy_target_t *t, spy_thread_t *th) {
+    if (th->own.n) {
+        read_counter_group(&th->own, th->now);
+        close_counter_group(&th->own);
+    }
+    th->alive = 0;
+    t->exited++;
+}
+
+// Opens the inherited total group on a thread
+static int add_root(spy_target_t *t, pid_t tid, int flags) {
+    spy_root_t *grown = realloc(t->roots, (t->nroots + 1) * sizeof(spy_root_t));
+    if (!grown) return -1;
+    t->roots = grown;
+    spy_root_t *r = &t->roots[t->nroots];
+    unsigned opened = open_counter_group(&r->total, tid, t->events, SPY_INHERIT | SPY_SCALED | flags);
+    if (!opened || (t->events != ~0u && opened != t->events)) {
+        close_counter_group(&r->total);
+        return -1;
+    }
+    if (t->events == ~0u) {
+        t->events = opened;
+        t->ncounters = r->total.n;
+        memcpy(t->names, r->total.names, sizeof(t->names));
+    }
+    r->tid = tid;
+    t->nroots++;
+    return 0;
+}
+
+static int is_tid_dir(const struct dirent *d, pid_t *tid) {
+    char *end;
+    long v = strtol(d->d_name, &end, 10);
+    if (*end || v <= 0) return 0;
+    *tid = (pid_t)v;
+    return 1;
+}
+
+// Adds every thread in /proc/PID/task we have not seen (with as_roots they
+// also become roots) and retires the ones that are gone. The directory is
+// read in full first, so no thread listed was created by a root opened in
+// the same pass. Returns the number added, -1 if PID is gone
+static int scan_tasks(spy_target_t *t, int as_roots) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", t->pid);
+    DIR *dir = opendir(path);
+    if (!dir) return -1;
+
+    struct dirent *d;
+    pid_t tid, *tids = NULL;
+    int ntids = 0, cap = 0, added = 0;
+    while ((d = readdir(dir)) != NULL) {
+        if (!is_tid_dir(d, &tid)) continue;
+        if (ntids == cap) {
+            pid_t *grown = realloc(tids, (cap = cap ? cap * 2 : 64) * sizeof(pid_t));
+            if (!grown) break;
+            tids = grown;
+        }
+        tids[ntids++] = tid;
+    }
+    closedir(dir);
+
+    for (int i = 0; i < t->nthreads; i++) t->threads[i].seen = 0;
+    for (int i = 0; i < ntids; i++) {
+        spy_thread_t *th = find_thread(t, tids[i]);
+        if (th) {
+            th->seen = 1;
+            continue;
+        }
+        if (as_roots && add_root(t, tids[i], t->nroots ? SPY_QUIET : 0) != 0) {
+            if (t->nroots == 0) break;      // Nothing opens on the main thread
+            if (errno != ESRCH) {           // Missing from Total, not just exited
+                t->drop_errno = errno;
+                t->dropped++;
+            }
+            continue;
+        }
+        th = add_thread(t, tids[i]);
+        if (!th) continue;
+        th->seen = 1;
+        added++;
+        if (!as_roots) {
+            printf("+ thread %d (%s) started%s\n", th->tid, th->comm, th->own.n ? "" : ", no counters");
+            t->created++;
+        }
+    }
+    free(tids);
+
+    for (int i = 0; i < t->nthreads; i++) {
+        spy_thread_t *th = &t->threads[i];
+        if (th->alive && !th->seen) {
+            printf("- thread %d (%s) exited\n", th->tid, th->comm);
+            thread_exited(t, th);
+        }
+    }
+    return added;
+}
+
+// Sleeps until `deadline`, rescanning threads as it goes; returns -1 once
+// the process is gone
+static int wait_rescanning(spy_target_t *t, double deadline) {
+    while (!stop_requested) {
+        double left = deadline - now_seconds();
+        if (left <= 0) break;
+        if (left > SCAN_INTERVAL) left = SCAN_INTERVAL;
+        struct timespec ts = { 0, (long)(left * 1e9) };
+        nanosleep(&ts, NULL);
+        if (scan_tasks(t, 0) < 0) return -1;
+        fflush(stdout);
+    }
+    return 0;
+}
+
+static void read_totals(spy_target_t *t, uint64_t *totals) {
+    uint64_t values[SR_MAX_COUNTERS];
+    memset(totals, 0, sizeof(uint64_t) * SR_MAX_COUNTERS);
+    for (int i = 0; i < t->nroots; i++) {
+        if (read_counter_group(&t->roots[i].total, values) != 0) continue;
+        for (int c = 0; c < t->ncounters; c++) totals[c] += values[c];
+    }
+}
+
+static void print_counter_row(const char *tid, const char *name, const uint64_t *values, int n) {
+    printf("%-8s %-16s ", tid, name);
+    for (int c = 0; c < n; c++) printf("%-20llu ", (unsigned long long)values[c]);
+    printf("\n");
+}
+
+// One row per thread (deltas when `delta`, else cumulative), then
+// (other) and Total
+static void print_thread_table(spy_target_t *t, const uint64_t *total, int delta) {
+    uint64_t rows[SR_MAX_COUNTERS] = {0}, values[SR_MAX_COUNTERS];
+    char tid[16];
+
+    printf("%-8s %-16s ", "TID", "Thread");
+    for (int c = 0; c < t->ncounters; c++) printf("%-20s ", t->names[c]);
+    printf("\n");
+    for (int i = 0; i < t->nthreads; i++) {
+        spy_thread_t *th = &t->threads[i];
+        if (delta && !th->alive && !memcmp(th->now, th->prev, sizeof(th->now))) continue;
+        for (int c = 0; c < t->ncounters; c++) {
+            values[c] = delta ? th->now[c] - th->prev[c] : th->now[c];
+            rows[c] += values[c];
+        }
+        snprintf(tid, sizeof(tid), "%d", th->tid);
+        print_counter_row(tid, th->comm, values, t->ncounters);
+    }
+    for (int c = 0; c < t->ncounters; c++) {
+        values[c] = total[c] > rows[c] ? total[c] - rows[c] : 0;
+    }
+    print_counter_row("(other)", "", values, t->ncounters);
+    print_counter_row("Total", "", total, t->ncounters);
+}
+
+static int monitor_per_second(pid_t target_pid, int per_thread, double duration) {
+    spy_target_t t = { .pid = target_pid, .events = ~0u };
+    struct rlimit rl = { 0, 0 };
+
+    // Two groups per thread (inherited total and own row) of up to
+    // SR_MAX_COUNTERS fds each: the default soft limit of 1024 runs out
+    // at ~128 threads
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
     printf("=== Perf Spy Process ===\n");
-    printf("Monitoring PID: %d\n", target_pid);
+    printf("Monitoring PID: %d (all threads)\n", target_pid);
     printf("Setting up performance counters...\n\n");
-    
-    // Setup multiple cache-related performance counters
-    perf_counter_t counters[4];
-    int num_counters = 0;
-    
-    // L1 data cache misses
-    counters[num_counters].fd = setup_perf_counter(target_pid, 
-        PERF_TYPE_HW_CACHE,
-        (PERF_COUNT_HW_CACHE_L1D) | 
-        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
-        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        "L1D Cache Misses");
-    counters[num_counters].name = "L1D Cache Misses";
-    if (counters[num_counters].fd >= 0) num_counters++;
-    
-    // L1 instruction cache misses
-    counters[num_counters].fd = setup_perf_counter(target_pid,
-        PERF_TYPE_HW_CACHE,
-        (PERF_COUNT_HW_CACHE_L1I) |
-        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
-        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        "L1I Cache Misses");
-    counters[num_counters].name = "L1I Cache Misses";
-    if (counters[num_counters].fd >= 0) num_counters++;
-    
-    // LLC (Last Level Cache) misses
-    counters[num_counters].fd = setup_perf_counter(target_pid,
-        PERF_TYPE_HW_CACHE,
-        (PERF_COUNT_HW_CACHE_LL) |
-        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
-        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        "LLC Cache Misses");
-    counters[num_counters].name = "LLC Cache Misses";
-    if (counters[num_counters].fd >= 0) num_counters++;
-    
-    // Cache references
-    counters[num_counters].fd = setup_perf_counter(target_pid,
-        PERF_TYPE_HARDWARE,
-        PERF_COUNT_HW_CACHE_REFERENCES,
-        "Cache References");
-    counters[num_counters].name = "Cache References";
-    if (counters[num_counters].fd >= 0) num_counters++;
-    
-    if (num_counters == 0) {
-        fprintf(stderr, "Failed to setup any performance counters\n");
-        fprintf(stderr, "Make sure you have root privileges and perf events are enabled\n");
-        fprintf(stderr, "Try: echo -1 | sudo tee /proc/sys/kernel/perf_event_paranoid\n");
+
+    // One pass: threads started while it attaches are picked up by the
+    // rescans as plain rows
+    int added = scan_tasks(&t, 1);
+    if (added < 0 || t.nroots == 0) {
+        if (added < 0) fprintf(stderr, "No such process: %d\n", target_pid);
+        else print_setup_help();
         return 1;
     }
-    
-    printf("Successfully configured %d counters\n", num_counters);
+
+    printf("Successfully configured %d counters on %d threads (inherited by new ones)\n",
+           t.ncounters, t.nroots);
+    if (t.dropped) {
+        fprintf(stderr, "Warning: %d thread(s) not attached (%s, open file limit %llu); "
+                "they are missing from the rows and possibly from Total\n",
+                t.dropped, strerror(t.drop_errno), (unsigned long long)rl.rlim_cur);
+    }
     printf("Starting monitoring...\n\n");
-    
-    // Enable all counters
-    for (int i = 0; i < num_counters; i++) {
-        ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
-        ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
-    }
-    
-    // Monitor loop
-    printf("%-20s ", "Time");
-    for (int i = 0; i < num_counters; i++) {
-        printf("%-20s ", counters[i].name);
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    if (!per_thread) {
+        printf("%-20s ", "Time");
+        for (int c = 0; c < t.ncounters; c++) printf("%-20s ", t.names[c]);
+        printf("%s\n", "Threads");
+        printf("%s\n", "================================================================================");
     }
-    printf("\n");
-    printf("%s\n", "================================================================================");
-    
-    long long prev_counts[4] = {0};
+
+    uint64_t prev_total[SR_MAX_COUNTERS] = {0}, total[SR_MAX_COUNTERS];
+    double start = now_seconds(), tick = start;
     int sample = 0;
-    
-    while (1) {
-        sleep(1);
-        
-        printf("%-20d ", sample++);
-        
-        for (int i = 0; i < num_counters; i++) {
-            long long count;
-            if (read(counters[i].fd, &count, sizeof(long long)) == sizeof(long long)) {
-                long long delta = count - prev_counts[i];
-                prev_counts[i] = count;
-                printf("%-20lld ", delta);
-            } else {
-                printf("%-20s ", "ERROR");
+
+    while (!stop_requested && (duration <= 0 || tick - start < duration)) {
+        tick += 1.0;
+        int alive = wait_rescanning(&t, tick) == 0;
+        if (stop_requested) break;
+
+        read_totals(&t, total);
+        int threads = 0;
+        for (int i = 0; i < t.nthreads; i++) {
+            spy_thread_t *th = &t.threads[i];
+            if (!th->alive) continue;
+            if (!alive) {
+                thread_exited(&t, th);
+                continue;
+            }
+            if (th->own.n) read_counter_group(&th->own, th->now);
+            read_comm(target_pid, th->tid, th->comm);   // Names are often set after start
+            threads++;
+        }
+
+        if (per_thread) {
+            uint64_t delta[SR_MAX_COUNTERS];
+            for (int c = 0; c < t.ncounters; c++) delta[c] = total[c] - prev_total[c];
+            printf("--- %d s, %d threads ---\n", ++sample, threads);
+            print_thread_table(&t, delta, 1);
+            printf("\n");
+        } else {
+            printf("%-20d ", sample++);
+            for (int c = 0; c < t.ncounters; c++) {
+                printf("%-20llu ", (unsigned long long)(total[c] - prev_total[c]));
             }
+            printf("%d\n", threads);
         }
-        printf("\n");
         fflush(stdout);
+        memcpy(prev_total, total, sizeof(total));
+        for (int i = 0; i < t.nthreads; i++) {
+            memcpy(t.threads[i].prev, t.threads[i].now, sizeof(t.threads[i].now));
+        }
+        if (!alive) {
+            printf("Process %d exited\n", target_pid);
+            break;
+        }
+    }
+
+    // Exited threads keep their final counts; live ones are read once more
+    read_totals(&t, total);
+    for (int i = 0; i < t.nthreads; i++) {
+        if (t.threads[i].alive && t.threads[i].own.n) {
+            read_counter_group(&t.threads[i].own, t.threads[i].now);
+        }
+    }
+    printf("\n=== Per-thread totals over %.1f s ===\n", now_seconds() - start);
+    print_thread_table(&t, total, 0);
+    printf("\nThreads: %d at attach, %d created, %d exited while monitoring\n",
+           t.nroots, t.created, t.exited);
+    if (t.dropped) {
+        printf("Warning: %d thread(s) could not be attached (%s); raise the open file limit "
+               "(ulimit -Hn)\n", t.dropped, strerror(t.drop_errno));
     }
-    
+
     // Cleanup
-    for (int i = 0; i < num_counters; i++) {
-        close(counters[i].fd);
+    for (int i = 0; i < t.nthreads; i++) close_counter_group(&t.threads[i].own);
+    for (int i = 0; i < t.nroots; i++) close_counter_group(&t.roots[i].total);
+    free(t.threads);
+    free(t.roots);
+    return 0;
+}
+
+// ============================================================================
+// Ring mode: one counter read per batch of new encryptions
+// ============================================================================
+
+static int monitor_ring(const char *ring_name, const char *trace_path, double duration,
+                        unsigned long capacity) {
+    sample_ring_t victim, spy;
+    counter_group_t group;
+    char spy_name[SR_NAME_MAX];
+    static sr_victim_rec_t batch[RING_BATCH];
+    uint64_t prev[SR_MAX_COUNTERS], now[SR_MAX_COUNTERS];
+    FILE *trace = NULL;
+
+    printf("=== Perf Spy Process (ring mode) ===\n");
+    if (sr_attach(&victim, ring_name, sizeof(sr_victim_rec_t)) != 0) {
+        fprintf(stderr, "Start the victim first: aes_victim -r %s\n", ring_name);
+        return 1;
+    }
+    pid_t target_pid = victim.hdr->producer_pid;
+    printf("Victim ring: /dev/shm%s, PID %d\n", victim.name, target_pid);
+
+    if (!open_counter_group(&group, target_pid, ~0u, 0)) {
+        print_setup_help();
+        sr_close(&victim);
+        return 1;
+    }
+    snprintf(spy_name, sizeof(spy_name), "%.*s.spy", SR_NAME_MAX - 5, victim.name);
+    if (sr_create(&spy, spy_name, sizeof(sr_spy_rec_t), capacity) != 0) {
+        close_counter_group(&group);
+        sr_close(&victim);
+        return 1;
+    }
+    printf("Spy ring:    /dev/shm%s\n", spy.name);
+    printf("Counters:   ");
+    for (int i = 0; i < group.n; i++) {
+        printf(" %s%s", group.names[i], i + 1 < group.n ? "," : "\n");
+    }
+
+    if (trace_path) {
+        trace = fopen(trace_path, "w");
+        if (!trace) {
+            perror(trace_path);
+            sr_close(&spy);
+            close_counter_group(&group);
+            sr_close(&victim);
+            return 1;
+        }
+        fprintf(trace, "seq_first,seq_last,victim_t_begin,victim_t_end,spy_timestamp,plaintext");
+        for (int i = 0; i < group.n; i++) {
+            fprintf(trace, ",%s", group.names[i]);
+        }
+        fprintf(trace, "\n");
+    }
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    // Counter deltas are charged to every victim record published since
+    // the previous read, including any the ring overwrote before we got there
+    uint64_t next_seq = victim.cursor;
+    uint64_t reads = 0, single = 0, covered = 0, lost_total = 0;
+    uint64_t deadline = duration > 0 ? cc_timestamp() + (uint64_t)(duration * cc_timestamp_hz()) : 0;
+    unsigned spins = 0;
+    read_counter_group(&group, prev);
+
+    while (!stop_requested) {
+        if (sr_head(&victim) == victim.cursor) {
+            if (sr_producer_closed(&victim) || (deadline && cc_timestamp() > deadline)) break;
+            sr_idle(&spins);
+            continue;
+        }
+        spins = 0;
+        if (read_counter_group(&group, now) != 0) {
+            fprintf(stderr, "Counter read failed (victim exited?)\n");
+            break;
+        }
+        uint64_t timestamp = cc_timestamp();
+
+        // Everything published before the counter read belongs to it;
+        // drain up to that head even if it takes several batches
+        uint64_t head = sr_head(&victim), lost = 0;
+        uint64_t t_begin = 0, t_end = 0;
+        uint8_t first_pt[16] = {0};
+        int have_first = 0;
+        while (victim.cursor < head) {
+            uint64_t want = head - victim.cursor;
+            size_t n = sr_read(&victim, batch, want < RING_BATCH ? want : RING_BATCH, &lost);
+            if (n == 0) continue;
+            if (!have_first) {
+                t_begin = batch[0].t_begin;
+                memcpy(first_pt, batch[0].plaintext, sizeof(first_pt));
+                have_first = 1;
+            }
+            t_end = batch[n - 1].t_end;
+        }
+
+        uint64_t seq_last = head - 1;
+        sr_spy_rec_t *rec = sr_claim(&spy);
+        rec->seq_first = next_seq;
+        rec->seq_last = seq_last;
+        rec->timestamp = timestamp;
+        rec->ncounters = group.n;
+        rec->lost = lost > UINT32_MAX ? UINT32_MAX : (uint32_t)lost;
+        for (int i = 0; i < group.n; i++) {
+            rec->delta[i] = now[i] - prev[i];
+            prev[i] = now[i];
+        }
+        sr_publish(&spy);
+
+        if (trace && have_first) {
+            fprintf(trace, "%lu,%lu,%lu,%lu,%lu,", (unsigned long)rec->seq_first,
+                    (unsigned long)rec->seq_last, (unsigned long)t_begin,
+                    (unsigned long)t_end, (unsigned long)rec->timestamp);
+            // Only meaningful when the first record of the range survived
+            for (int b = 0; b < 16 && lost == 0; b++) fprintf(trace, "%02x", first_pt[b]);
+            for (int i = 0; i < group.n; i++) fprintf(trace, ",%lu", (unsigned long)rec->delta[i]);
+            fprintf(trace, "\n");
+        }
+
+        reads++;
+        covered += seq_last + 1 - next_seq;
+        single += seq_last == next_seq;
+        lost_total += lost;
+        next_seq = seq_last + 1;
+    }
+
+    printf("\nCounter reads:       %lu\n", (unsigned long)reads);
+    printf("Encryptions covered: %lu (%.2f per read)\n", (unsigned long)covered,
+           reads ? (double)covered / reads : 0.0);
+    printf("Single-encryption:   %lu reads (%.1f%%)\n", (unsigned long)single,
+           reads ? 100.0 * single / reads : 0.0);
+    printf("Lost (overwritten):  %lu\n", (unsigned long)lost_total);
+    if (trace) {
+        fclose(trace);
+        printf("Trace written to %s\n", trace_path);
     }
-    
+
+    sr_close(&spy);
+    close_counter_group(&group);
+    sr_close(&victim);
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    const char *ring_name = NULL;
+    const char *trace_path = NULL;
+    double duration = 0;
+    int per_thread = 0;
+    unsigned long capacity = SR_DEFAULT_CAPACITY;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:o:t:C:Te:lh")) != -1) {
+        switch (opt) {
+        case 'r': ring_name = optarg; break;
+        case 'o': trace_path = optarg; break;
+        case 't': duration = atof(optarg); break;
+        case 'C': capacity = strtoul(optarg, NULL, 10); break;
+        case 'T': per_thread = 1; break;
+        case 'e':
+            if (spy_nevents == SR_MAX_COUNTERS) {
+                fprintf(stderr, "At most %d events\n", SR_MAX_COUNTERS);
+                return 1;
+            }
+            spy_events[spy_nevents++] = (spy_event_t){ optarg, optarg };
+            break;
+        case 'l':
+            pmu_list(stdout);
+            return 0;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (spy_nevents == 0) {
+        memcpy(spy_events, default_events, sizeof(default_events));
+        spy_nevents = SR_MAX_COUNTERS;
+    }
+    if (ring_name || optind == argc - 1) {
+        resolve_spy_events();
+    }
+
+    if (ring_name) {
+        if (capacity == 0 || capacity > (1ul << 30)) {
+            fprintf(stderr, "Ring capacity must be between 1 and 2^30 records\n");
+            return 1;
+        }
+        return monitor_ring(ring_name, trace_path, duration, capacity);
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    return monitor_per_second(atoi(argv[optind]), per_thread, duration);
+}
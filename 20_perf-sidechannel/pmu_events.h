@@ -0,0 +1,434 @@
+/**
+ * pmu_events.h
+ *
+ * Resolves symbolic perf event specs to perf_event_attr type/config using the
+ * PMU descriptions the kernel exports under /sys/bus/event_source/devices:
+ * each <pmu> directory has its perf type, format/<term> (which config bits a
+ * term sets) and events/<name> (aliases made of terms). The tools then need
+ * no per-CPU config bit-fiddling.
+ *
+ * Accepted specs (perf-tool syntax):
+ *   cycles, branch-misses, task-clock, ...   generic hardware/software events
+ *   L1-dcache-load-misses, dTLB-loads, ...   generic cache events
+ *   cpu/event=0xd1,umask=0x20/               PMU terms, placed by format/<term>
+ *   msr/tsc/, cpu/cache-misses/              PMU event aliases (events/<name>)
+ *   l1d_cache_refill                         alias searched in every PMU
+ *   r01d1                                    raw config for the core PMU
+ * each optionally followed by a :u (user only) or :k (kernel only) modifier.
+ *
+ * "a|b|c" lists alternatives. pmu_resolve() returns the first one that
+ * parses and that the kernel accepts, which is how callers pick the best
+ * event per architecture: the generic name first, then Intel or ARM
+ * aliases for CPUs whose driver does not map it.
+ */
+
+#ifndef PMU_EVENTS_H
+#define PMU_EVENTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PMU_SYSFS "/sys/bus/event_source/devices"
+#define PMU_SPEC_MAX 128
+
+typedef struct {
+    char spec[PMU_SPEC_MAX];    // The alternative that resolved
+    uint32_t type;
+    uint64_t config, config1, config2;
+    int exclude_user, exclude_kernel;
+    int exclude_hv;             // Cleared by pmu_probe() for PMUs that reject it (msr)
+    double scale;               // events/<alias>.scale, else 1
+    char unit[16];              // events/<alias>.unit, else ""
+} pmu_event_t;
+
+// ============================================================================
+// sysfs helpers
+// ============================================================================
+
+// First line of a sysfs file without the newline; -1 if unreadable
+static inline int pmu_read_line(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int ok = fgets(buf, (int)len, f) != NULL;
+    fclose(f);
+    if (!ok) return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+static inline int pmu_read_attr(const char *pmu, const char *dir, const char *name,
+                                char *buf, size_t len) {
+    char path[512];
+    if (snprintf(path, sizeof(path), PMU_SYSFS "/%s/%s%s%s", pmu, dir, *dir ? "/" : "", name) >= (int)sizeof(path)) {
+        return -1;
+    }
+    return pmu_read_line(path, buf, len);
+}
+
+static inline int pmu_type(const char *pmu, uint32_t *type) {
+    char buf[32];
+    if (pmu_read_attr(pmu, "", "type", buf, sizeof(buf)) != 0) return -1;
+    *type = (uint32_t)strtoul(buf, NULL, 10);
+    return 0;
+}
+
+// Core PMU name: "cpu" on x86, "armv8_pmuv3_0" / "armv8_cortex_a72" etc. on ARM
+static inline int pmu_core_name(char *name, size_t len) {
+    static const char *const prefixes[] = {"cpu", "cpu_core", "armv8", "armv7"};
+    for (size_t p = 0; p < sizeof(prefixes) / sizeof(prefixes[0]); p++) {
+        DIR *dir = opendir(PMU_SYSFS);
+        struct dirent *d;
+        if (!dir) return -1;
+        while ((d = readdir(dir)) != NULL) {
+            int match = p < 2 ? !strcmp(d->d_name, prefixes[p])
+                              : !strncmp(d->d_name, prefixes[p], strlen(prefixes[p]));
+            if (match) {
+                snprintf(name, len, "%.*s", (int)len - 1, d->d_name);
+                closedir(dir);
+                return 0;
+            }
+        }
+        closedir(dir);
+    }
+    return -1;
+}
+
+// ============================================================================
+// Terms
+// ============================================================================
+
+// Spreads value over the bit ranges of a format ("config:0-7,21",
+// "config1:0-63"), low value bits into the first range
+static inline int pmu_place(pmu_event_t *ev, const char *format, uint64_t value) {
+    uint64_t *dst;
+    int bit = 0;
+
+    if (!strncmp(format, "config:", 7)) {
+        dst = &ev->config;
+        format += 7;
+    } else if (!strncmp(format, "config1:", 8)) {
+        dst = &ev->config1;
+        format += 8;
+    } else if (!strncmp(format, "config2:", 8)) {
+        dst = &ev->config2;
+        format += 8;
+    } else {
+        return -1;
+    }
+    while (*format) {
+        char *end;
+        long lo = strtol(format, &end, 10), hi = lo;
+        if (end == format) return -1;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long b = lo; b <= hi && b < 64; b++, bit++) {
+            uint64_t mask = 1ULL << b;
+            *dst = (bit < 64 && ((value >> bit) & 1)) ? (*dst | mask) : (*dst & ~mask);
+        }
+        format = *end == ',' ? end + 1 : end;
+        if (*end != ',') break;
+    }
+    return (bit < 64 && (value >> bit)) ? -2 : 0;
+}
+
+static inline int pmu_apply_terms(pmu_event_t *ev, const char *pmu, const char *terms,
+                                  char *err, size_t errlen, int depth) {
+    char buf[512], *save = NULL;
+
+    snprintf(buf, sizeof(buf), "%s", terms);
+    for (char *term = strtok_r(buf, ",", &save); term; term = strtok_r(NULL, ",", &save)) {
+        while (*term == ' ') term++;
+        if (!*term) continue;
+        char *val = strchr(term, '=');
+        uint64_t value = 1;         // A bare flag term such as "edge" or "inv"
+        char format[128], alias[256];
+
+        if (val) {
+            *val++ = '\0';
+            char *end;
+            if (!strcmp(val, "?")) {
+                snprintf(err, errlen, "%s/%s/ needs a value for %s", pmu, terms, term);
+                return -1;
+            }
+            value = strtoull(val, &end, 0);
+            if (end == val || *end) {
+                snprintf(err, errlen, "bad value '%s' for %s", val, term);
+                return -1;
+            }
+        } else if (depth == 0 && pmu_read_attr(pmu, "events", term, alias, sizeof(alias)) == 0) {
+            char name[160], extra[32];
+            if (pmu_apply_terms(ev, pmu, alias, err, errlen, 1) != 0) return -1;
+            snprintf(name, sizeof(name), "%s.scale", term);
+            if (pmu_read_attr(pmu, "events", name, extra, sizeof(extra)) == 0) ev->scale = atof(extra);
+            snprintf(name, sizeof(name), "%s.unit", term);
+            if (pmu_read_attr(pmu, "events", name, extra, sizeof(extra)) == 0) {
+                snprintf(ev->unit, sizeof(ev->unit), "%.15s", extra);
+            }
+            continue;
+        }
+
+        if (pmu_read_attr(pmu, "format", term, format, sizeof(format)) != 0) {
+            // PMUs without a format directory still take the raw fields
+            if (!strcmp(term, "config")) { ev->config = value; continue; }
+            if (!strcmp(term, "config1")) { ev->config1 = value; continue; }
+            if (!strcmp(term, "config2")) { ev->config2 = value; continue; }
+            snprintf(err, errlen, "%s has no term or event '%s'", pmu, term);
+            return -1;
+        }
+        int rc = pmu_place(ev, format, value);
+        if (rc == -2) {
+            snprintf(err, errlen, "%s=0x%llx does not fit %s", term, (unsigned long long)value, format);
+            return -1;
+        } else if (rc != 0) {
+            snprintf(err, errlen, "%s: bad format %s", term, format);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// Generic events
+// ============================================================================
+
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} pmu_generic_t;
+
+static const pmu_generic_t pmu_generic_events[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"cpu-cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"bus-cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES},
+    {"stalled-cycles-frontend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+    {"stalled-cycles-backend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+    {"ref-cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES},
+    {"cpu-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK},
+    {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cs", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {"migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {"minor-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN},
+    {"major-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ},
+    {"alignment-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_ALIGNMENT_FAULTS},
+    {"emulation-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_EMULATION_FAULTS},
+    {"dummy", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_DUMMY},
+};
+
+// <cache>-<op>s or <cache>-<op>-misses, e.g. "LLC-load-misses"
+static inline int pmu_generic_cache(const char *name, uint64_t *config) {
+    static const struct { const char *name; uint64_t id; } caches[] = {
+        {"L1-dcache", PERF_COUNT_HW_CACHE_L1D}, {"L1-icache", PERF_COUNT_HW_CACHE_L1I},
+        {"LLC", PERF_COUNT_HW_CACHE_LL}, {"dTLB", PERF_COUNT_HW_CACHE_DTLB},
+        {"iTLB", PERF_COUNT_HW_CACHE_ITLB}, {"branch", PERF_COUNT_HW_CACHE_BPU},
+        {"node", PERF_COUNT_HW_CACHE_NODE},
+    };
+    static const struct { const char *name; uint64_t id; } ops[] = {
+        {"load", PERF_COUNT_HW_CACHE_OP_READ}, {"store", PERF_COUNT_HW_CACHE_OP_WRITE},
+        {"prefetch", PERF_COUNT_HW_CACHE_OP_PREFETCH},
+    };
+
+    for (size_t c = 0; c < sizeof(caches) / sizeof(caches[0]); c++) {
+        size_t n = strlen(caches[c].name);
+        if (strncasecmp(name, caches[c].name, n) || name[n] != '-') continue;
+        const char *rest = name + n + 1;
+        for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+            char access[32], miss[32];
+            snprintf(access, sizeof(access), o == 2 ? "%ses" : "%ss", ops[o].name);
+            snprintf(miss, sizeof(miss), "%s-misses", ops[o].name);
+            int is_miss = !strcmp(rest, miss);
+            if (!is_miss && strcmp(rest, access)) continue;
+            *config = caches[c].id | (ops[o].id << 8) |
+                      ((is_miss ? PERF_COUNT_HW_CACHE_RESULT_MISS : PERF_COUNT_HW_CACHE_RESULT_ACCESS) << 16);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// ============================================================================
+// Parsing and resolution
+// ============================================================================
+
+// Parses one spec (no '|'); does not check that the kernel accepts it
+static inline int pmu_parse(const char *spec, pmu_event_t *ev, char *err, size_t errlen) {
+    char buf[PMU_SPEC_MAX], pmu[64];
+    const char *mods = "";
+
+    memset(ev, 0, sizeof(*ev));
+    ev->exclude_hv = 1;
+    ev->scale = 1.0;
+    snprintf(ev->spec, sizeof(ev->spec), "%s", spec);
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    // Modifiers: "name:u", "pmu/terms/u" or "pmu/terms/:u"
+    char *slash = strchr(buf, '/');
+    char *tail = slash ? strrchr(buf, '/') : strrchr(buf, ':');
+    if (slash && tail != slash) {
+        mods = tail + 1 + (tail[1] == ':');
+        *tail = '\0';
+    } else if (!slash && tail) {
+        mods = tail + 1;
+        *tail = '\0';
+    }
+    for (const char *m = mods; *m; m++) {
+        if (*m == 'u') ev->exclude_kernel = 1;
+        else if (*m == 'k') ev->exclude_user = 1;
+        else {
+            snprintf(err, errlen, "unknown modifier '%c'", *m);
+            return -1;
+        }
+    }
+    if (ev->exclude_kernel && ev->exclude_user) ev->exclude_kernel = ev->exclude_user = 0;
+
+    if (slash) {                                        // pmu/terms/
+        *slash = '\0';
+        if (pmu_type(buf, &ev->type) != 0) {
+            snprintf(err, errlen, "no PMU '%.48s' in " PMU_SYSFS, buf);
+            return -1;
+        }
+        return pmu_apply_terms(ev, buf, slash + 1, err, errlen, 0);
+    }
+
+    for (size_t i = 0; i < sizeof(pmu_generic_events) / sizeof(pmu_generic_events[0]); i++) {
+        if (!strcmp(buf, pmu_generic_events[i].name)) {
+            ev->type = pmu_generic_events[i].type;
+            ev->config = pmu_generic_events[i].config;
+            return 0;
+        }
+    }
+    if (pmu_generic_cache(buf, &ev->config) == 0) {
+        ev->type = PERF_TYPE_HW_CACHE;
+        return 0;
+    }
+    if (buf[0] == 'r' && buf[1] && strspn(buf + 1, "0123456789abcdefABCDEF") == strlen(buf + 1)) {
+        ev->type = PERF_TYPE_RAW;
+        ev->config = strtoull(buf + 1, NULL, 16);
+        return 0;
+    }
+
+    // An alias: the core PMU first, then every other PMU
+    char alias[256];
+    if (pmu_core_name(pmu, sizeof(pmu)) == 0 &&
+        pmu_read_attr(pmu, "events", buf, alias, sizeof(alias)) == 0) {
+        pmu_type(pmu, &ev->type);
+        return pmu_apply_terms(ev, pmu, buf, err, errlen, 0);
+    }
+    DIR *dir = opendir(PMU_SYSFS);
+    struct dirent *d;
+    while (dir && (d = readdir(dir)) != NULL) {
+        if (d->d_name[0] == '.' ||
+            pmu_read_attr(d->d_name, "events", buf, alias, sizeof(alias)) != 0) continue;
+        snprintf(pmu, sizeof(pmu), "%.63s", d->d_name);
+        closedir(dir);
+        pmu_type(pmu, &ev->type);
+        return pmu_apply_terms(ev, pmu, buf, err, errlen, 0);
+    }
+    if (dir) closedir(dir);
+    snprintf(err, errlen, "unknown event '%s'", buf);
+    return -1;
+}
+
+// Fills the event and privilege fields of a zeroed perf_event_attr
+static inline void pmu_attr(const pmu_event_t *ev, struct perf_event_attr *pe) {
+    pe->type = ev->type;
+    pe->size = sizeof(struct perf_event_attr);
+    pe->config = ev->config;
+    pe->config1 = ev->config1;
+    pe->config2 = ev->config2;
+    pe->exclude_user = ev->exclude_user;
+    pe->exclude_kernel = ev->exclude_kernel;
+    pe->exclude_hv = ev->exclude_hv;
+}
+
+// 0 if the kernel accepts the event for this process, else -errno. Like
+// perf, retries without exclude_hv, which uncore-style PMUs refuse
+static inline int pmu_probe(pmu_event_t *ev) {
+    for (;;) {
+        struct perf_event_attr pe;
+        memset(&pe, 0, sizeof(pe));
+        pmu_attr(ev, &pe);
+        pe.disabled = 1;
+
+        int fd = (int)syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0);
+        if (fd >= 0) {
+            close(fd);
+            return 0;
+        }
+        if (errno != EINVAL || !ev->exclude_hv) return -errno;
+        ev->exclude_hv = 0;
+    }
+}
+
+// First alternative of "a|b|c" that parses and opens. On failure err
+// lists why each one was rejected
+static inline int pmu_resolve(const char *alternatives, pmu_event_t *ev, char *err, size_t errlen) {
+    char buf[4 * PMU_SPEC_MAX], *save = NULL;
+    size_t used = 0;
+
+    int several = strchr(alternatives, '|') != NULL;
+
+    snprintf(buf, sizeof(buf), "%s", alternatives);
+    if (errlen) err[0] = '\0';
+    for (char *spec = strtok_r(buf, "|", &save); spec; spec = strtok_r(NULL, "|", &save)) {
+        char why[160];
+        int rc = pmu_parse(spec, ev, why, sizeof(why));
+        if (rc == 0 && (rc = pmu_probe(ev)) == 0) return 0;
+        if (rc < -1) snprintf(why, sizeof(why), "%s", strerror(-rc));
+        if (used < errlen) {
+            used += several ? snprintf(err + used, errlen - used, "%s%s: %s", used ? "; " : "", spec, why)
+                            : snprintf(err + used, errlen - used, "%s", why);
+        }
+    }
+    return -1;
+}
+
+// Lists every PMU with its type, format terms and event aliases
+static inline void pmu_list(FILE *out) {
+    DIR *dir = opendir(PMU_SYSFS);
+    struct dirent *d;
+
+    if (!dir) {
+        fprintf(out, "Cannot open " PMU_SYSFS ": %s\n", strerror(errno));
+        return;
+    }
+    while ((d = readdir(dir)) != NULL) {
+        uint32_t type;
+        if (d->d_name[0] == '.' || pmu_type(d->d_name, &type) != 0) continue;
+        fprintf(out, "%s (type %u)\n", d->d_name, type);
+
+        const char *sub[] = {"format", "events"};
+        for (int s = 0; s < 2; s++) {
+            char path[512], value[256];
+            snprintf(path, sizeof(path), PMU_SYSFS "/%s/%s", d->d_name, sub[s]);
+            DIR *sd = opendir(path);
+            struct dirent *e;
+            while (sd && (e = readdir(sd)) != NULL) {
+                if (e->d_name[0] == '.' || strchr(e->d_name, '.')) continue;   // .scale, .unit
+                if (pmu_read_attr(d->d_name, sub[s], e->d_name, value, sizeof(value)) != 0) continue;
+                fprintf(out, "  %-7s %-32s %s\n", s ? "event" : "term", e->d_name, value);
+            }
+            if (sd) closedir(sd);
+        }
+    }
+    closedir(dir);
+}
+
+#endif // PMU_EVENTS_H
@@ -0,0 +1,263 @@
+/*
+ * Shared-Memory Sample Rings
+ * Single-producer rings in POSIX shared memory (/dev/shm) used to line up
+ * what the victim did with what the spy observed, one encryption at a time:
+ *
+ *   <name>       victim ring: one sr_victim_rec_t per encryption
+ *                (sequence number, start/end timestamp, plaintext, ciphertext)
+ *   <name>.spy   spy ring: one sr_spy_rec_t per counter read, covering the
+ *                victim sequence numbers [seq_first, seq_last]
+ *
+ * The producer never waits for readers. It fills the slot at head, then
+ * publishes head + 1 with a release store. The slot at head shares its
+ * index with record head - capacity, so a reader sees at most capacity - 1
+ * published records; one that falls further behind loses the overwritten
+ * ones and is told how many.
+ * Records are one cache line, so a producer at millions of records per
+ * second touches one line per record plus the head.
+ *
+ * Timestamps are cc_timestamp() ticks (cache_ctl.h). Both processes read
+ * the same invariant TSC / generic timer, so victim and spy records can be
+ * merged on time as well as on sequence number.
+ */
+
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SR_MAGIC 0x474e4952u   // "RING"
+#define SR_VERSION 1
+#define SR_NAME_MAX 64
+#define SR_DEFAULT_CAPACITY (1u << 20)
+#define SR_MAX_COUNTERS 4
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;             // Records, power of two
+    int32_t producer_pid;
+    uint32_t closed;               // Set by the producer on exit
+    uint8_t pad0[40];
+    uint64_t head;                 // Records published (atomic), own cache line
+    uint8_t pad1[56];
+} sr_header_t;
+
+// Victim ring record: one encryption
+typedef struct {
+    uint64_t seq;
+    uint64_t t_begin;
+    uint64_t t_end;
+    uint8_t plaintext[16];
+    uint8_t ciphertext[16];
+    uint8_t pad[8];
+} sr_victim_rec_t;
+
+// Spy ring record: counter deltas over the victim records seq_first..seq_last
+typedef struct {
+    uint64_t seq_first;
+    uint64_t seq_last;
+    uint64_t timestamp;
+    uint32_t ncounters;
+    uint32_t lost;                 // Victim records overwritten before this read
+    uint64_t delta[SR_MAX_COUNTERS];
+} sr_spy_rec_t;
+
+_Static_assert(sizeof(sr_header_t) == 128, "ring header layout");
+_Static_assert(sizeof(sr_victim_rec_t) == 64, "victim record is one cache line");
+_Static_assert(sizeof(sr_spy_rec_t) == 64, "spy record is one cache line");
+
+typedef struct {
+    sr_header_t *hdr;
+    uint8_t *records;
+    size_t map_size;
+    uint32_t mask;
+    int owner;                     // Created (and will unlink) the segment
+    uint64_t cursor;               // Reader: next record to consume
+    char name[SR_NAME_MAX];
+} sample_ring_t;
+
+static inline void sr_shm_name(char *out, const char *name) {
+    snprintf(out, SR_NAME_MAX, "/%.*s", SR_NAME_MAX - 2, name[0] == '/' ? name + 1 : name);
+}
+
+// Create (or replace) a ring. capacity is rounded up to a power of two.
+// Returns 0 on success, -1 on error.
+static inline int sr_create(sample_ring_t *r, const char *name, uint32_t record_size, uint32_t capacity) {
+    uint32_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+
+    memset(r, 0, sizeof(*r));
+    sr_shm_name(r->name, name);
+    r->map_size = sizeof(sr_header_t) + (size_t)cap * record_size;
+
+    shm_unlink(r->name);
+    int fd = shm_open(r->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "shm_open %s: %s\n", r->name, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, r->map_size) != 0) {
+        fprintf(stderr, "ftruncate %s: %s\n", r->name, strerror(errno));
+        close(fd);
+        shm_unlink(r->name);
+        return -1;
+    }
+    void *p = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "mmap %s: %s\n", r->name, strerror(errno));
+        shm_unlink(r->name);
+        return -1;
+    }
+
+    r->hdr = p;
+    r->records = (uint8_t *)p + sizeof(sr_header_t);
+    r->mask = cap - 1;
+    r->owner = 1;
+    r->hdr->version = SR_VERSION;
+    r->hdr->record_size = record_size;
+    r->hdr->capacity = cap;
+    r->hdr->producer_pid = getpid();
+    // Readers check the magic last, so publish it after the rest
+    __atomic_store_n(&r->hdr->magic, SR_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Attach to an existing ring read-only, starting at its current head.
+// Returns 0 on success, -1 on error.
+static inline int sr_attach(sample_ring_t *r, const char *name, uint32_t record_size) {
+    struct stat st;
+
+    memset(r, 0, sizeof(*r));
+    sr_shm_name(r->name, name);
+    int fd = shm_open(r->name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "shm_open %s: %s\n", r->name, strerror(errno));
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(sr_header_t)) {
+        fprintf(stderr, "%s: not a sample ring\n", r->name);
+        close(fd);
+        return -1;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "mmap %s: %s\n", r->name, strerror(errno));
+        return -1;
+    }
+
+    r->hdr = p;
+    r->map_size = st.st_size;
+    if (__atomic_load_n(&r->hdr->magic, __ATOMIC_ACQUIRE) != SR_MAGIC ||
+        r->hdr->version != SR_VERSION || r->hdr->record_size != record_size ||
+        (r->hdr->capacity & (r->hdr->capacity - 1)) != 0 ||
+        sizeof(sr_header_t) + (size_t)r->hdr->capacity * record_size > r->map_size) {
+        fprintf(stderr, "%s: incompatible sample ring\n", r->name);
+        munmap(p, r->map_size);
+        r->hdr = NULL;
+        return -1;
+    }
+    r->records = (uint8_t *)p + sizeof(sr_header_t);
+    r->mask = r->hdr->capacity - 1;
+    r->cursor = __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+// Unmap; the creator also removes the segment name
+static inline void sr_close(sample_ring_t *r) {
+    if (!r->hdr) return;
+    if (r->owner) {
+        __atomic_store_n(&r->hdr->closed, 1, __ATOMIC_RELEASE);
+        shm_unlink(r->name);
+    }
+    munmap(r->hdr, r->map_size);
+    r->hdr = NULL;
+}
+
+// ============================================================================
+// Producer
+// ============================================================================
+
+// Slot for the next record; fill it, then sr_publish()
+static inline void *sr_claim(sample_ring_t *r) {
+    uint64_t head = __atomic_load_n(&r->hdr->head, __ATOMIC_RELAXED);
+    return r->records + (size_t)(head & r->mask) * r->hdr->record_size;
+}
+
+static inline void sr_publish(sample_ring_t *r) {
+    uint64_t head = __atomic_load_n(&r->hdr->head, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->hdr->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// ============================================================================
+// Consumer
+// ============================================================================
+
+static inline uint64_t sr_head(const sample_ring_t *r) {
+    return __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+}
+
+// Back off while polling an empty ring: spin briefly, then give the CPU
+// away so a producer sharing the core can run. Reset *spins after data.
+static inline void sr_idle(unsigned *spins) {
+    if (++*spins < 1024) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        __asm__ volatile("yield");
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+static inline int sr_producer_closed(const sample_ring_t *r) {
+    return __atomic_load_n(&r->hdr->closed, __ATOMIC_ACQUIRE);
+}
+
+// Copy up to max records from the cursor into out. Returns the number
+// copied and adds records lost to overwriting to *lost (may be NULL).
+static inline size_t sr_read(sample_ring_t *r, void *out, size_t max, uint64_t *lost) {
+    uint32_t rs = r->hdr->record_size, cap = r->hdr->capacity;
+    uint64_t head = sr_head(r);
+    uint64_t skipped = 0;
+
+    // The producer may already be filling the slot at head, which holds
+    // record head - cap: the oldest safe record is head - cap + 1
+    if (head - r->cursor >= cap) {
+        skipped = head - r->cursor - cap + 1;
+        r->cursor = head - cap + 1;
+    }
+    size_t n = head - r->cursor < max ? (size_t)(head - r->cursor) : max;
+    for (size_t i = 0; i < n; i++) {
+        memcpy((uint8_t *)out + i * rs, r->records + (size_t)((r->cursor + i) & r->mask) * rs, rs);
+    }
+
+    // Anything the producer lapped while we copied may be torn: drop it,
+    // including the record in the slot it may be filling now
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t now = sr_head(r);
+    size_t valid = n;
+    if (now - r->cursor >= cap) {
+        uint64_t overwritten = now - r->cursor - cap + 1;
+        valid = overwritten >= n ? 0 : n - overwritten;
+        memmove(out, (uint8_t *)out + (n - valid) * rs, valid * rs);
+        skipped += n - valid;
+    }
+    r->cursor += n;
+    if (lost) *lost += skipped;
+    return valid;
+}
+
+#endif // SAMPLE_RING_H
@@ -8,6 +8,7 @@
 #define SIMPLE_AES_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define AES_BLOCK_SIZE 16
 #define AES_KEY_SIZE 16
@@ -40,6 +41,10 @@ static const uint8_t rcon[10] = {
 typedef struct {
     uint8_t round_keys[11][AES_BLOCK_SIZE];
     int rounds;
+    // Table the encryption looks up (and leaks through). Key expansion
+    // points it at sbox; a caller may substitute an identical private copy
+    // so its flushes do not disturb other threads using the shared table.
+    const uint8_t *sbox;
 } SimpleAES_CTX;
 
 // Key expansion for 128-bit key (10 rounds)
@@ -48,6 +53,7 @@ void simple_aes_key_expansion(SimpleAES_CTX *ctx, const uint8_t *key) {
     uint8_t temp[4];
     
     ctx->rounds = 10;
+    ctx->sbox = sbox;
     
     // First round key is the key itself
     for (i = 0; i < AES_KEY_SIZE; i++) {
@@ -81,12 +87,12 @@ void simple_aes_key_expansion(SimpleAES_CTX *ctx, const uint8_t *key) {
 }
 
 // SubBytes transformation - VULNERABLE to cache timing!
-static void sub_bytes(uint8_t *state) {
+static void sub_bytes(uint8_t *state, const uint8_t *table) {
     int i;
     for (i = 0; i < AES_BLOCK_SIZE; i++) {
         // Introduce artificial delay based on S-box value to amplify timing
         // This simulates cache miss penalty in a more exaggerated way
-        uint8_t val = sbox[state[i]];  // Cache timing leak here!
+        uint8_t val = table[state[i]];  // Cache timing leak here!
         
         // Add CPU-bound delay proportional to value to amplify differences
         volatile int dummy = 0;
@@ -186,14 +192,14 @@ void simple_aes_encrypt(SimpleAES_CTX *ctx, const uint8_t *plaintext, uint8_t *c
     
     // Main rounds (9 rounds for AES-128)
     for (round = 1; round < ctx->rounds; round++) {
-        sub_bytes(state);      // VULNERABLE: Cache timing leak!
+        sub_bytes(state, ctx->sbox);   // VULNERABLE: Cache timing leak!
         shift_rows(state);
         mix_columns(state);
         add_round_key(state, ctx->round_keys[round]);
     }
     
     // Final round (no MixColumns)
-    sub_bytes(state);          // VULNERABLE: Cache timing leak!
+    sub_bytes(state, ctx->sbox);       // VULNERABLE: Cache timing leak!
     shift_rows(state);
     add_round_key(state, ctx->round_keys[ctx->rounds]);
     
@@ -203,4 +209,111 @@ void simple_aes_encrypt(SimpleAES_CTX *ctx, const uint8_t *plaintext, uint8_t *c
     }
 }
 
+// ============================================================================
+// Multi-block (bulk) encryption
+// ============================================================================
+
+// Number of independent blocks processed in lockstep by the bulk APIs.
+// Each transformation is applied to all lanes before moving on, so the
+// dependency chains of different blocks overlap in the CPU pipeline.
+#define SIMPLE_AES_LANES 4
+
+// SubBytes over SIMPLE_AES_LANES states, byte-major so that the lookups
+// (and the artificial delay loops) of different blocks are independent
+static void sub_bytes_lanes(uint8_t state[][AES_BLOCK_SIZE], const uint8_t *table) {
+    int i, l;
+    for (i = 0; i < AES_BLOCK_SIZE; i++) {
+        for (l = 0; l < SIMPLE_AES_LANES; l++) {
+            uint8_t val = table[state[l][i]];  // Cache timing leak here!
+
+            volatile int dummy = 0;
+            for (int j = 0; j < (val & 0x0F); j++) {
+                dummy += j;
+            }
+
+            state[l][i] = val;
+        }
+    }
+}
+
+// Encrypt SIMPLE_AES_LANES consecutive blocks (same leak model as
+// simple_aes_encrypt, identical ciphertext)
+static void simple_aes_encrypt_lanes(SimpleAES_CTX *ctx, const uint8_t *plaintext, uint8_t *ciphertext) {
+    uint8_t state[SIMPLE_AES_LANES][AES_BLOCK_SIZE];
+    int i, l, round;
+
+    for (l = 0; l < SIMPLE_AES_LANES; l++) {
+        for (i = 0; i < AES_BLOCK_SIZE; i++) {
+            state[l][i] = plaintext[l * AES_BLOCK_SIZE + i];
+        }
+        add_round_key(state[l], ctx->round_keys[0]);
+    }
+
+    for (round = 1; round < ctx->rounds; round++) {
+        sub_bytes_lanes(state, ctx->sbox);
+        for (l = 0; l < SIMPLE_AES_LANES; l++) {
+            shift_rows(state[l]);
+            mix_columns(state[l]);
+            add_round_key(state[l], ctx->round_keys[round]);
+        }
+    }
+
+    sub_bytes_lanes(state, ctx->sbox);
+    for (l = 0; l < SIMPLE_AES_LANES; l++) {
+        shift_rows(state[l]);
+        add_round_key(state[l], ctx->round_keys[ctx->rounds]);
+        for (i = 0; i < AES_BLOCK_SIZE; i++) {
+            ciphertext[l * AES_BLOCK_SIZE + i] = state[l][i];
+        }
+    }
+}
+
+// ECB mode: encrypt nblocks consecutive 16-byte blocks
+void simple_aes_encrypt_ecb(SimpleAES_CTX *ctx, const uint8_t *in, uint8_t *out, size_t nblocks) {
+    size_t b = 0;
+
+    for (; b + SIMPLE_AES_LANES <= nblocks; b += SIMPLE_AES_LANES) {
+        simple_aes_encrypt_lanes(ctx, in + b * AES_BLOCK_SIZE, out + b * AES_BLOCK_SIZE);
+    }
+    for (; b < nblocks; b++) {
+        simple_aes_encrypt(ctx, in + b * AES_BLOCK_SIZE, out + b * AES_BLOCK_SIZE);
+    }
+}
+
+// Counter block for block index n: iv + n as a 128-bit big-endian integer
+static void simple_aes_ctr_block(const uint8_t *iv, uint64_t n, uint8_t *counter) {
+    unsigned carry = 0;
+    int i;
+
+    for (i = AES_BLOCK_SIZE - 1; i >= 0; i--) {
+        unsigned sum = iv[i] + (unsigned)(n & 0xFF) + carry;
+        counter[i] = (uint8_t)sum;
+        carry = sum >> 8;
+        n >>= 8;
+    }
+}
+
+// CTR mode: out = in XOR E(iv + n) for block n, starting at block index
+// 'first' so callers can split one stream into independent ranges
+void simple_aes_encrypt_ctr(SimpleAES_CTX *ctx, const uint8_t *iv, uint64_t first,
+                            const uint8_t *in, uint8_t *out, size_t nblocks) {
+    uint8_t counters[SIMPLE_AES_LANES * AES_BLOCK_SIZE];
+    uint8_t keystream[SIMPLE_AES_LANES * AES_BLOCK_SIZE];
+    size_t b = 0;
+    int i, l;
+
+    for (; b < nblocks; b += SIMPLE_AES_LANES) {
+        int lanes = (nblocks - b < SIMPLE_AES_LANES) ? (int)(nblocks - b) : SIMPLE_AES_LANES;
+
+        for (l = 0; l < SIMPLE_AES_LANES; l++) {
+            simple_aes_ctr_block(iv, first + b + l, counters + l * AES_BLOCK_SIZE);
+        }
+        simple_aes_encrypt_lanes(ctx, counters, keystream);
+
+        for (i = 0; i < lanes * AES_BLOCK_SIZE; i++) {
+            out[b * AES_BLOCK_SIZE + i] = in[b * AES_BLOCK_SIZE + i] ^ keystream[i];
+        }
+    }
+}
+
 #endif // SIMPLE_AES_H
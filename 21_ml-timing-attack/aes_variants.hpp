@@ -0,0 +1,280 @@
+/*
+ * Compile-Time AES Variants
+ * One AES-128 core specialised at compile time along three axes:
+ *
+ *   Access  how SubBytes reads the S-box
+ *     TableSbox      sbox[x] (cache-timing leak, as in the C headers)
+ *     ScanSbox       constant-time: reads all 256 entries, masks one out
+ *     BitslicedSbox  constant-time: all 16 state bytes at once as 8 bit
+ *                    planes, GF(2^8) inverse (x^254) + affine in boolean ops
+ *   Leak    artificial delay after each S-box output
+ *     NoLeak         nothing
+ *     Low3Leak       0-7 iterations (value & 0x07), vulnerable_aes.h
+ *     Low4Leak       0-15 iterations (value & 0x0F), simple_aes.h
+ *   Rounds  1..10 (reduced-round variants for experiments)
+ *
+ * Every Aes<Access, Leak, Rounds> is a distinct type with everything
+ * inlined: no function pointers, no runtime switches, and NoLeak compiles
+ * to nothing. The S-box table itself is computed at compile time.
+ */
+
+#ifndef AES_VARIANTS_HPP
+#define AES_VARIANTS_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace aesv {
+
+#define AESV_INLINE inline __attribute__((always_inline))
+
+constexpr int kBlockSize = 16;
+constexpr int kKeySize = 16;
+
+// ============================================================================
+// GF(2^8) and the S-box, evaluated at compile time
+// ============================================================================
+
+constexpr uint8_t gf_mul_const(uint8_t a, uint8_t b) {
+    uint8_t p = 0;
+    for (int i = 0; i < 8; i++) {
+        if (b & 1) p ^= a;
+        bool hi = a & 0x80;
+        a = static_cast<uint8_t>(a << 1);
+        if (hi) a ^= 0x1b;
+        b >>= 1;
+    }
+    return p;
+}
+
+constexpr uint8_t rotl8(uint8_t x, int n) {
+    return static_cast<uint8_t>((x << n) | (x >> (8 - n)));
+}
+
+constexpr std::array<uint8_t, 256> make_sbox() {
+    std::array<uint8_t, 256> s{};
+    for (int x = 0; x < 256; x++) {
+        // x^254 = x^-1 (0 maps to 0)
+        uint8_t inv = 1, base = static_cast<uint8_t>(x);
+        for (int e = 254; e; e >>= 1) {
+            if (e & 1) inv = gf_mul_const(inv, base);
+            base = gf_mul_const(base, base);
+        }
+        if (x == 0) inv = 0;
+        s[x] = inv ^ rotl8(inv, 1) ^ rotl8(inv, 2) ^ rotl8(inv, 3) ^ rotl8(inv, 4) ^ 0x63;
+    }
+    return s;
+}
+
+alignas(64) inline constexpr std::array<uint8_t, 256> kSbox = make_sbox();
+inline constexpr uint8_t kRcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+static_assert(kSbox[0x00] == 0x63 && kSbox[0x53] == 0xed && kSbox[0xff] == 0x16,
+              "compile-time S-box does not match FIPS-197");
+
+// ============================================================================
+// Leak models
+// ============================================================================
+
+struct NoLeak {
+    static constexpr const char *name = "none";
+    static AESV_INLINE void apply(uint8_t) {}
+};
+
+// Busy loop of (value & Mask) iterations, like the C demo headers
+template <unsigned Mask>
+struct DelayLeak {
+    static constexpr const char *name = Mask == 0x07 ? "delay&7" : Mask == 0x0F ? "delay&15" : "delay";
+    static AESV_INLINE void apply(uint8_t value) {
+        volatile int delay = 0;
+        for (unsigned i = 0; i < (value & Mask); i++) {
+            delay += i * i;
+        }
+    }
+};
+
+using Low3Leak = DelayLeak<0x07>;
+using Low4Leak = DelayLeak<0x0F>;
+
+// ============================================================================
+// S-box access strategies: sub() for single bytes (key schedule),
+// sub_state() for the 16-byte state
+// ============================================================================
+
+struct TableSbox {
+    static constexpr const char *name = "table";
+    static AESV_INLINE uint8_t sub(uint8_t x) { return kSbox[x]; }
+    static AESV_INLINE void sub_state(uint8_t *s) {
+        for (int i = 0; i < kBlockSize; i++) s[i] = kSbox[s[i]];
+    }
+};
+
+struct ScanSbox {
+    static constexpr const char *name = "scan";
+    static AESV_INLINE uint8_t sub(uint8_t x) {
+        uint32_t r = 0;
+        for (uint32_t i = 0; i < 256; i++) {
+            // mask = 0xff..ff when i == x, else 0, without a branch
+            uint32_t mask = ((i ^ x) - 1) >> 8;
+            r |= kSbox[i] & mask;
+        }
+        return static_cast<uint8_t>(r);
+    }
+    static AESV_INLINE void sub_state(uint8_t *s) {
+        for (int i = 0; i < kBlockSize; i++) s[i] = sub(s[i]);
+    }
+};
+
+struct BitslicedSbox {
+    static constexpr const char *name = "bitsliced";
+
+    // Bit plane b holds bit b of every state byte (byte i at bit i)
+    using Planes = std::array<uint32_t, 8>;
+
+    static AESV_INLINE Planes gf_mul(const Planes &a, const Planes &b) {
+        uint32_t t[15] = {};
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 8; j++) t[i + j] ^= a[i] & b[j];
+        }
+        // Reduce by x^8 = x^4 + x^3 + x + 1
+        for (int k = 14; k >= 8; k--) {
+            t[k - 4] ^= t[k];
+            t[k - 5] ^= t[k];
+            t[k - 7] ^= t[k];
+            t[k - 8] ^= t[k];
+        }
+        Planes r;
+        for (int i = 0; i < 8; i++) r[i] = t[i];
+        return r;
+    }
+
+    static AESV_INLINE void sub_planes(Planes &p) {
+        // x^254 = x^2 * x^4 * ... * x^128
+        Planes sq = gf_mul(p, p);
+        Planes inv = sq;
+        for (int k = 2; k < 8; k++) {
+            sq = gf_mul(sq, sq);
+            inv = gf_mul(inv, sq);
+        }
+        // Affine transform, constant 0x63
+        for (int i = 0; i < 8; i++) {
+            uint32_t c = (0x63 >> i) & 1 ? 0xffffffffu : 0;
+            p[i] = inv[i] ^ inv[(i + 4) & 7] ^ inv[(i + 5) & 7] ^ inv[(i + 6) & 7] ^
+                   inv[(i + 7) & 7] ^ c;
+        }
+    }
+
+    static AESV_INLINE void sub_state(uint8_t *s) {
+        Planes p{};
+        for (int i = 0; i < kBlockSize; i++) {
+            for (int b = 0; b < 8; b++) p[b] |= static_cast<uint32_t>((s[i] >> b) & 1) << i;
+        }
+        sub_planes(p);
+        for (int i = 0; i < kBlockSize; i++) {
+            uint8_t v = 0;
+            for (int b = 0; b < 8; b++) v |= static_cast<uint8_t>(((p[b] >> i) & 1) << b);
+            s[i] = v;
+        }
+    }
+
+    static AESV_INLINE uint8_t sub(uint8_t x) {
+        Planes p;
+        for (int b = 0; b < 8; b++) p[b] = (x >> b) & 1;
+        sub_planes(p);
+        uint8_t v = 0;
+        for (int b = 0; b < 8; b++) v |= static_cast<uint8_t>((p[b] & 1) << b);
+        return v;
+    }
+};
+
+// ============================================================================
+// The AES core
+// ============================================================================
+
+template <class Access, class Leak, int Rounds = 10>
+class Aes {
+    static_assert(Rounds >= 1 && Rounds <= 10, "AES-128 key schedule supports 1..10 rounds");
+
+public:
+    static constexpr int kRounds = Rounds;
+
+    static std::string name() {
+        return std::string(Access::name) + "/" + Leak::name + "/r" + std::to_string(Rounds);
+    }
+
+    AESV_INLINE void set_key(const uint8_t *key) {
+        std::memcpy(rk_[0], key, kKeySize);
+        for (int i = 1; i <= Rounds; i++) {
+            const uint8_t *prev = rk_[i - 1];
+            uint8_t temp[4] = { sub(prev[13]), sub(prev[14]), sub(prev[15]), sub(prev[12]) };
+            temp[0] ^= kRcon[i - 1];
+            for (int j = 0; j < 4; j++) rk_[i][j] = prev[j] ^ temp[j];
+            for (int j = 4; j < kKeySize; j++) rk_[i][j] = prev[j] ^ rk_[i][j - 4];
+        }
+    }
+
+    AESV_INLINE void encrypt(const uint8_t *in, uint8_t *out) const {
+        uint8_t s[kBlockSize];
+        std::memcpy(s, in, kBlockSize);
+        add_round_key(s, rk_[0]);
+        for (int round = 1; round < Rounds; round++) {
+            sub_bytes(s);
+            shift_rows(s);
+            mix_columns(s);
+            add_round_key(s, rk_[round]);
+        }
+        sub_bytes(s);
+        shift_rows(s);
+        add_round_key(s, rk_[Rounds]);
+        std::memcpy(out, s, kBlockSize);
+    }
+
+private:
+    uint8_t rk_[Rounds + 1][kBlockSize];
+
+    static AESV_INLINE uint8_t sub(uint8_t x) {
+        uint8_t v = Access::sub(x);
+        Leak::apply(v);
+        return v;
+    }
+
+    static AESV_INLINE void sub_bytes(uint8_t *s) {
+        Access::sub_state(s);
+        for (int i = 0; i < kBlockSize; i++) Leak::apply(s[i]);
+    }
+
+    static AESV_INLINE void shift_rows(uint8_t *s) {
+        uint8_t t;
+        t = s[1]; s[1] = s[5]; s[5] = s[9]; s[9] = s[13]; s[13] = t;
+        t = s[2]; s[2] = s[10]; s[10] = t;
+        t = s[6]; s[6] = s[14]; s[14] = t;
+        t = s[15]; s[15] = s[11]; s[11] = s[7]; s[7] = s[3]; s[3] = t;
+    }
+
+    // Branch-free multiply by x
+    static AESV_INLINE uint8_t xtime(uint8_t a) {
+        return static_cast<uint8_t>((a << 1) ^ (0x1b & -(a >> 7)));
+    }
+
+    static AESV_INLINE void mix_columns(uint8_t *s) {
+        for (int c = 0; c < 4; c++) {
+            uint8_t *col = s + 4 * c;
+            uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+            uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+            col[0] ^= all ^ xtime(a0 ^ a1);
+            col[1] ^= all ^ xtime(a1 ^ a2);
+            col[2] ^= all ^ xtime(a2 ^ a3);
+            col[3] ^= all ^ xtime(a3 ^ a0);
+        }
+    }
+
+    static AESV_INLINE void add_round_key(uint8_t *s, const uint8_t *rk) {
+        for (int i = 0; i < kBlockSize; i++) s[i] ^= rk[i];
+    }
+};
+
+} // namespace aesv
+
+#endif // AES_VARIANTS_HPP
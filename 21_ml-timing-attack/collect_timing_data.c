@@ -1,14 +1,31 @@
 /*
  * Timing Data Collector for ML-based AES Key Recovery
  * Collects encryption timing measurements for different key guesses
+ *
+ * Timings come from timing_harness.h: serialized cycle-counter reads with
+ * the measurement overhead subtracted, converted to microseconds, on a
+ * pinned CPU. With -k K each sample is the mean of K back-to-back
+ * encryptions of the same plaintext.
+ *
+ * An output name ending in .tbin selects the binary columnar format of
+ * timing_format.h (-z: zlib-compressed chunks) instead of CSV.
+ *
+ * With -s samples are streamed to stdout as tf_stream_record_t for
+ * online_scorer.py. Every round times one sample per key guess, so all
+ * candidates advance together; the collector stops when the reader closes
+ * the pipe (or after -n rounds).
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
 #include "vulnerable_aes.h"
+#include "timing_harness.h"
+#include "timing_format.h"
 
 #define NUM_SAMPLES 5000      // Samples per key byte guess
 #define NUM_PLAINTEXTS 10     // Different plaintexts to test
@@ -19,84 +36,189 @@ static uint8_t secret_key[AES_KEY_SIZE] = {
     0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
 };
 
-// Measure encryption time in microseconds
-double measure_timing(VulnerableAES_CTX *ctx, const uint8_t *plaintext) {
+static timing_harness_t harness;
+
+// Measure encryption time in microseconds (mean over 'batch' encryptions)
+double measure_timing(VulnerableAES_CTX *ctx, const uint8_t *plaintext, int batch) {
     uint8_t ciphertext[AES_BLOCK_SIZE];
-    struct timeval start, end;
-    
-    gettimeofday(&start, NULL);
-    vulnerable_aes_encrypt(ctx, plaintext, ciphertext);
-    gettimeofday(&end, NULL);
-    
-    return (end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec);
+
+    uint64_t start = th_begin(&harness);
+    for (int i = 0; i < batch; i++) {
+        vulnerable_aes_encrypt(ctx, plaintext, ciphertext);
+    }
+    uint64_t end = th_end(&harness);
+
+    return th_ticks_to_us(&harness, (double)th_elapsed(&harness, start, end)) / batch;
 }
 
 // Generate training data for first key byte
-void generate_training_data(const char *output_file) {
-    FILE *fp = fopen(output_file, "w");
-    if (!fp) {
+int generate_training_data(const char *output_file, int batch, int compress) {
+    tf_sink_t out;
+    if (tf_sink_open(&out, output_file, "key_byte_guess", "plaintext", compress) != 0) {
         perror("Failed to open output file");
-        return;
+        return -1;
     }
-    
-    // CSV header
-    fprintf(fp, "key_byte_guess,plaintext,timing_us,is_correct\n");
-    
+
     printf("Generating training data for ML model...\n");
     printf("Collecting %d samples for each of 256 key byte values...\n\n", NUM_SAMPLES);
-    
+
     uint8_t test_key[AES_KEY_SIZE];
     uint8_t plaintext[AES_BLOCK_SIZE];
     VulnerableAES_CTX ctx;
-    
+
     // Test all 256 possible values for first key byte
     for (int key_guess = 0; key_guess < 256; key_guess++) {
         // Setup test key with guessed first byte
         memcpy(test_key, secret_key, AES_KEY_SIZE);
         test_key[0] = key_guess;
-        
+
         vulnerable_aes_key_expansion(&ctx, test_key);
-        
+
         // Collect samples with different plaintexts
         for (int sample = 0; sample < NUM_SAMPLES; sample++) {
             // Generate varied plaintext
             for (int i = 0; i < AES_BLOCK_SIZE; i++) {
                 plaintext[i] = (sample * 17 + i * 23 + key_guess) & 0xFF;
             }
-            
-            double timing = measure_timing(&ctx, plaintext);
+
+            double timing = measure_timing(&ctx, plaintext, batch);
             int is_correct = (key_guess == secret_key[0]) ? 1 : 0;
-            
+
             // Output: key_guess, plaintext_first_byte, timing, is_correct
-            fprintf(fp, "%d,%d,%.6f,%d\n", key_guess, plaintext[0], timing, is_correct);
+            if (tf_sink_write(&out, key_guess, plaintext[0], timing, is_correct) != 0) {
+                tf_sink_close(&out);
+                return -1;
+            }
         }
-        
+
         if (key_guess % 32 == 0) {
             printf("Progress: %d/256 key values tested\n", key_guess);
         }
     }
-    
-    fclose(fp);
+
+    if (tf_sink_close(&out) != 0) {
+        perror("Failed to write output file");
+        return -1;
+    }
     printf("\nTraining data saved to %s\n", output_file);
     printf("Total samples: %d\n", 256 * NUM_SAMPLES);
+    return 0;
+}
+
+// Stream samples round-robin over all key guesses until the reader goes
+// away or max_rounds (0 = unlimited) is reached
+int stream_samples(int batch, long max_rounds) {
+    static VulnerableAES_CTX ctx[256];
+    tf_stream_record_t rec[256];
+    uint8_t test_key[AES_KEY_SIZE];
+    uint8_t plaintext[AES_BLOCK_SIZE];
+    long round;
+
+    // Expand all 256 candidate keys once up front
+    for (int key_guess = 0; key_guess < 256; key_guess++) {
+        memcpy(test_key, secret_key, AES_KEY_SIZE);
+        test_key[0] = key_guess;
+        vulnerable_aes_key_expansion(&ctx[key_guess], test_key);
+    }
+
+    // A closed pipe shows up as EPIPE from write() instead of killing us
+    signal(SIGPIPE, SIG_IGN);
+    memset(rec, 0, sizeof(rec));
+
+    for (round = 0; max_rounds == 0 || round < max_rounds; round++) {
+        for (int key_guess = 0; key_guess < 256; key_guess++) {
+            for (int i = 0; i < AES_BLOCK_SIZE; i++) {
+                plaintext[i] = (round * 17 + i * 23 + key_guess) & 0xFF;
+            }
+            rec[key_guess].guess = key_guess;
+            rec[key_guess].plaintext = plaintext[0];
+            rec[key_guess].is_correct = key_guess == secret_key[0];
+            rec[key_guess].timing_us = measure_timing(&ctx[key_guess], plaintext, batch);
+        }
+
+        // One write per round keeps the consumer live
+        if (tf_write_all(STDOUT_FILENO, rec, sizeof(rec)) != 0) {
+            if (errno == EPIPE) break;
+            perror("stream write");
+            return -1;
+        }
+    }
+
+    fprintf(stderr, "Streamed %ld rounds (%ld samples)\n", round, round * 256);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-k batch] [-c cpu] [-z] [output_file]\n", prog);
+    fprintf(stderr, "       %s -s [-n rounds] [-k batch] [-c cpu] | python3 online_scorer.py\n", prog);
+    fprintf(stderr, "  -k  Encryptions per sample, timing is their mean (default 1)\n");
+    fprintf(stderr, "  -c  CPU to pin to; -1 = current CPU (default), -2 = no pinning\n");
+    fprintf(stderr, "  -z  Compress chunks of .tbin output with zlib\n");
+    fprintf(stderr, "  -s  Stream binary samples to stdout until the reader exits\n");
+    fprintf(stderr, "  -n  Stop streaming after this many rounds of 256 samples (default: no limit)\n");
+    fprintf(stderr, "Output ending in .tbin is written in the binary columnar format\n");
 }
 
 int main(int argc, char *argv[]) {
     const char *output_file = "timing_data.csv";
-    
-    if (argc > 1) {
-        output_file = argv[1];
+    int batch = 1;
+    int cpu = -1;
+    int compress = 0;
+    int stream = 0;
+    long max_rounds = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:c:zsn:h")) != -1) {
+        switch (opt) {
+        case 'k': batch = atoi(optarg); break;
+        case 'c': cpu = atoi(optarg); break;
+        case 'z': compress = 1; break;
+        case 's': stream = 1; break;
+        case 'n': max_rounds = atol(optarg); break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        output_file = argv[optind];
     }
-    
-    printf("=== ML-Based AES Timing Attack - Data Collector ===\n");
-    printf("Target key first byte: 0x%02x\n", secret_key[0]);
-    printf("Output file: %s\n\n", output_file);
-    
-    generate_training_data(output_file);
-    
+    if (batch < 1 || cpu < -2 || max_rounds < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (th_init(&harness, cpu) != 0) {
+        fprintf(stderr, "Timing harness calibration failed\n");
+        return 1;
+    }
+
+    // stdout carries the samples in stream mode
+    FILE *log = stream ? stderr : stdout;
+
+    fprintf(log, "=== ML-Based AES Timing Attack - Data Collector ===\n");
+    fprintf(log, "Target key first byte: 0x%02x\n", secret_key[0]);
+    fprintf(log, "Output: %s\n", stream ? "stdout (sample stream)" : output_file);
+    fprintf(log, "Timer: %s, %.1f ticks/us, overhead %lu ticks subtracted\n",
+            th_counter_name(&harness), harness.ticks_per_us, (unsigned long)harness.overhead);
+    if (harness.cpu >= 0) {
+        fprintf(log, "Pinned to CPU %d\n", harness.cpu);
+    }
+    fprintf(log, "Encryptions per sample: %d\n\n", batch);
+
+    if (stream) {
+        if (isatty(STDOUT_FILENO)) {
+            fprintf(stderr, "Refusing to stream binary samples to a terminal\n");
+            return 1;
+        }
+        return stream_samples(batch, max_rounds) == 0 ? 0 : 1;
+    }
+
+    if (generate_training_data(output_file, batch, compress) != 0) {
+        return 1;
+    }
+
     printf("\nNext steps:\n");
     printf("1. Run: python3 ml_key_recovery.py %s\n", output_file);
     printf("2. The ML model will analyze timing patterns to recover the key byte\n");
-    
+
     return 0;
 }
@@ -0,0 +1,267 @@
+/*
+ * Native Forest Inference
+ * Evaluates the Random Forest / Gradient Boosting models trained by
+ * predict_with_model.py (exported with --export-forest) without Python.
+ *
+ * File layout (little-endian):
+ *   header   "FRST", u32 version, u32 nfeatures, u32 nmodels
+ *   scaler   f64 mean[nfeatures], f64 scale[nfeatures]   (StandardScaler)
+ *   models   repeated nmodels times:
+ *              u32 kind, u32 ntrees, u32 max_depth, u32 nnodes,
+ *              f64 bias, f64 weight, char name[32],
+ *              u32 root[ntrees],
+ *              i32 feature[nnodes], f32 threshold[nnodes],
+ *              i32 left[nnodes], i32 right[nnodes], f32 value[nnodes],
+ *              padding to an 8-byte boundary
+ *
+ * Nodes are stored structure-of-arrays. Leaves point to themselves
+ * (left == right == self), so every tree is walked for exactly max_depth
+ * steps with no data-dependent branches, and a batch of samples walks a
+ * tree in lockstep: 8 lanes per step with AVX2 gathers/compares, or a
+ * scalar select loop elsewhere.
+ *
+ * Thresholds are rounded down to float so that float32 feature values
+ * compare exactly as scikit-learn compares them (x <= threshold).
+ */
+
+#ifndef FOREST_INFER_H
+#define FOREST_INFER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FI_HAVE_AVX2 1
+#else
+#define FI_HAVE_AVX2 0
+#endif
+
+#define FI_MAGIC "FRST"
+#define FI_VERSION 1
+#define FI_MAX_MODELS 4
+#define FI_MAX_FEATURES 64
+#define FI_LANES 8
+
+typedef enum {
+    FI_RANDOM_FOREST = 0,      // Mean of leaf probabilities
+    FI_GRADIENT_BOOSTING = 1   // sigmoid(bias + weight * sum of leaf values)
+} fi_kind_t;
+
+typedef struct {
+    fi_kind_t kind;
+    int ntrees;
+    int max_depth;
+    int nnodes;
+    double bias;
+    double weight;
+    char name[32];
+    const uint32_t *root;
+    const int32_t *feature;
+    const float *threshold;
+    const int32_t *left;
+    const int32_t *right;
+    const float *value;
+} fi_model_t;
+
+typedef struct {
+    int nfeatures;
+    const double *mean;
+    const double *scale;
+    int nmodels;
+    fi_model_t models[FI_MAX_MODELS];
+    uint8_t *blob;
+} fi_forest_t;
+
+static inline int fi_take(const uint8_t **p, const uint8_t *end, size_t len, const void **out) {
+    if ((size_t)(end - *p) < len) return -1;
+    *out = *p;
+    *p += len;
+    return 0;
+}
+
+// Load an exported forest. Returns 0 on success, -1 on error.
+static inline int fi_load(fi_forest_t *f, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    long size;
+
+    memset(f, 0, sizeof(*f));
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+
+    f->blob = malloc(size > 0 ? size : 1);
+    if (!f->blob || fread(f->blob, 1, size, fp) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(fp);
+        free(f->blob);
+        f->blob = NULL;
+        return -1;
+    }
+    fclose(fp);
+
+    const uint8_t *p = f->blob, *end = f->blob + size;
+    const uint32_t *hdr;
+    if (fi_take(&p, end, 16, (const void **)&hdr) != 0 || memcmp(hdr, FI_MAGIC, 4) != 0 ||
+        hdr[1] != FI_VERSION || hdr[2] == 0 || hdr[2] > FI_MAX_FEATURES ||
+        hdr[3] == 0 || hdr[3] > FI_MAX_MODELS) {
+        goto bad;
+    }
+    f->nfeatures = hdr[2];
+    f->nmodels = hdr[3];
+    if (fi_take(&p, end, f->nfeatures * sizeof(double), (const void **)&f->mean) != 0 ||
+        fi_take(&p, end, f->nfeatures * sizeof(double), (const void **)&f->scale) != 0) {
+        goto bad;
+    }
+
+    for (int m = 0; m < f->nmodels; m++) {
+        fi_model_t *md = &f->models[m];
+        const uint32_t *mh;
+        const double *coef;
+        const char *name;
+        size_t n;
+
+        if (fi_take(&p, end, 16, (const void **)&mh) != 0 ||
+            fi_take(&p, end, 16, (const void **)&coef) != 0 ||
+            fi_take(&p, end, 32, (const void **)&name) != 0) {
+            goto bad;
+        }
+        md->kind = (fi_kind_t)mh[0];
+        md->ntrees = mh[1];
+        md->max_depth = mh[2];
+        md->nnodes = mh[3];
+        md->bias = coef[0];
+        md->weight = coef[1];
+        memcpy(md->name, name, sizeof(md->name) - 1);
+
+        n = md->nnodes;
+        if (md->kind > FI_GRADIENT_BOOSTING || md->ntrees == 0 || n == 0 ||
+            fi_take(&p, end, md->ntrees * sizeof(uint32_t), (const void **)&md->root) != 0 ||
+            fi_take(&p, end, n * sizeof(int32_t), (const void **)&md->feature) != 0 ||
+            fi_take(&p, end, n * sizeof(float), (const void **)&md->threshold) != 0 ||
+            fi_take(&p, end, n * sizeof(int32_t), (const void **)&md->left) != 0 ||
+            fi_take(&p, end, n * sizeof(int32_t), (const void **)&md->right) != 0 ||
+            fi_take(&p, end, n * sizeof(float), (const void **)&md->value) != 0) {
+            goto bad;
+        }
+        // Reject out-of-range indices once so traversal needs no checks
+        for (size_t i = 0; i < n; i++) {
+            if (md->feature[i] < 0 || md->feature[i] >= f->nfeatures ||
+                md->left[i] < 0 || (size_t)md->left[i] >= n ||
+                md->right[i] < 0 || (size_t)md->right[i] >= n) {
+                goto bad;
+            }
+        }
+        for (int t = 0; t < md->ntrees; t++) {
+            if (md->root[t] >= n) goto bad;
+        }
+        p += (8 - (p - f->blob) % 8) % 8;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "%s: not a valid forest file\n", path);
+    free(f->blob);
+    f->blob = NULL;
+    return -1;
+}
+
+static inline void fi_free(fi_forest_t *f) {
+    free(f->blob);
+    f->blob = NULL;
+}
+
+// Standardize row-major double samples into the feature-major float layout
+// the traversal reads: x_soa[feature * n + sample]
+static inline void fi_scale(const fi_forest_t *f, const double *rows, int n, float *x_soa) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < f->nfeatures; j++) {
+            x_soa[(size_t)j * n + i] = (float)((rows[(size_t)i * f->nfeatures + j] - f->mean[j]) / f->scale[j]);
+        }
+    }
+}
+
+// Leaf value of one tree for samples [i0, i0 + FI_LANES), scalar
+static inline void fi_tree_scalar(const fi_model_t *md, int t, const float *x, int n, int i0,
+                                  int lanes, double *acc) {
+    for (int l = 0; l < lanes; l++) {
+        int32_t node = md->root[t];
+        for (int d = 0; d < md->max_depth; d++) {
+            float v = x[(size_t)md->feature[node] * n + i0 + l];
+            node = v <= md->threshold[node] ? md->left[node] : md->right[node];
+        }
+        acc[l] += md->value[node];
+    }
+}
+
+#if FI_HAVE_AVX2
+__attribute__((target("avx2")))
+static inline void fi_tree_avx2(const fi_model_t *md, int t, const float *x, int n, int i0,
+                                double *acc) {
+    __m256i node = _mm256_set1_epi32(md->root[t]);
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i base = _mm256_add_epi32(_mm256_set1_epi32(i0), lane);
+    __m256i stride = _mm256_set1_epi32(n);
+
+    for (int d = 0; d < md->max_depth; d++) {
+        __m256i feat = _mm256_i32gather_epi32(md->feature, node, 4);
+        __m256 thr = _mm256_i32gather_ps(md->threshold, node, 4);
+        __m256i idx = _mm256_add_epi32(_mm256_mullo_epi32(feat, stride), base);
+        __m256 v = _mm256_i32gather_ps(x, idx, 4);
+        __m256i left = _mm256_i32gather_epi32(md->left, node, 4);
+        __m256i right = _mm256_i32gather_epi32(md->right, node, 4);
+        __m256 go_left = _mm256_cmp_ps(v, thr, _CMP_LE_OQ);
+        node = _mm256_blendv_epi8(right, left, _mm256_castps_si256(go_left));
+    }
+    __m256 leaf = _mm256_i32gather_ps(md->value, node, 4);
+    __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(leaf));
+    __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(leaf, 1));
+    _mm256_storeu_pd(acc, _mm256_add_pd(_mm256_loadu_pd(acc), lo));
+    _mm256_storeu_pd(acc + 4, _mm256_add_pd(_mm256_loadu_pd(acc + 4), hi));
+}
+
+static inline int fi_avx2_available(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2");
+    }
+    return cached;
+}
+#endif
+
+// Probability of class 1 for n samples laid out by fi_scale()
+static inline void fi_predict(const fi_model_t *md, const float *x_soa, int n, double *out) {
+#if FI_HAVE_AVX2
+    int avx2 = fi_avx2_available() && (size_t)n * FI_MAX_FEATURES < INT32_MAX;
+#endif
+
+    for (int i0 = 0; i0 < n; i0 += FI_LANES) {
+        int lanes = n - i0 < FI_LANES ? n - i0 : FI_LANES;
+        double acc[FI_LANES] = {0};
+
+        for (int t = 0; t < md->ntrees; t++) {
+#if FI_HAVE_AVX2
+            if (avx2 && lanes == FI_LANES) {
+                fi_tree_avx2(md, t, x_soa, n, i0, acc);
+                continue;
+            }
+#endif
+            fi_tree_scalar(md, t, x_soa, n, i0, lanes, acc);
+        }
+
+        for (int l = 0; l < lanes; l++) {
+            double raw = md->bias + md->weight * acc[l];
+            out[i0 + l] = md->kind == FI_GRADIENT_BOOSTING ? 1.0 / (1.0 + exp(-raw)) : raw;
+        }
+    }
+}
+
+#endif // FOREST_INFER_H
@@ -13,47 +13,32 @@ from sklearn.metrics import accuracy_score, classification_report, confusion_mat
 import matplotlib.pyplot as plt
 import seaborn as sns
 import sys
+from streaming_features import accumulate
 
 def load_data(filename):
-    """Load timing data from CSV file"""
-    print(f"Loading data from {filename}...")
-    df = pd.read_csv(filename)
-    print(f"Loaded {len(df)} samples")
-    print(f"Columns: {df.columns.tolist()}")
-    return df
+    """Stream timing data from a CSV or .tbin file into per-guess statistics"""
+    print(f"Streaming data from {filename}...")
+    acc = accumulate(filename)
+    print(f"Accumulated {int(acc.count.sum())} samples for {len(acc.guesses())} key byte values")
+    return acc
 
-def extract_features(df):
-    """Extract features from timing data"""
+def extract_features(acc):
+    """Extract features from the accumulated timing statistics"""
     print("\nExtracting features...")
     
-    # Group by key_byte_guess to calculate statistics
-    features_list = []
-    
-    for key_guess in range(256):
-        subset = df[df['key_byte_guess'] == key_guess]
-        
-        if len(subset) == 0:
-            continue
-            
-        timings = subset['timing_us'].values
-        
-        # Statistical features
-        features = {
-            'key_byte_guess': key_guess,
-            'mean_timing': np.mean(timings),
-            'std_timing': np.std(timings),
-            'min_timing': np.min(timings),
-            'max_timing': np.max(timings),
-            'median_timing': np.median(timings),
-            'q25_timing': np.percentile(timings, 25),
-            'q75_timing': np.percentile(timings, 75),
-            'range_timing': np.max(timings) - np.min(timings),
-            'is_correct': subset['is_correct'].iloc[0]
-        }
-        
-        features_list.append(features)
-    
-    features_df = pd.DataFrame(features_list)
+    f = acc.features(ddof=0)
+    features_df = pd.DataFrame({
+        'key_byte_guess': f['guess'],
+        'mean_timing': f['mean'],
+        'std_timing': f['std'],
+        'min_timing': f['min'],
+        'max_timing': f['max'],
+        'median_timing': f['median'],
+        'q25_timing': f['q25'],
+        'q75_timing': f['q75'],
+        'range_timing': f['range'],
+        'is_correct': f['is_correct']
+    })
     print(f"Extracted features for {len(features_df)} key byte values")
     
     return features_df
@@ -110,14 +95,17 @@ def train_model(features_df):
     
     return results
 
-def analyze_timing_patterns(df):
+def analyze_timing_patterns(acc):
     """Analyze timing patterns to identify correct key"""
     print("\n" + "="*60)
     print("TIMING PATTERN ANALYSIS")
     print("="*60)
     
     # Calculate average timing for each key guess
-    timing_stats = df.groupby('key_byte_guess')['timing_us'].agg(['mean', 'std', 'min', 'max'])
+    g = acc.guesses()
+    timing_stats = pd.DataFrame({
+        'mean': acc.mean[g], 'std': acc.std(ddof=1)[g], 'min': acc.min[g], 'max': acc.max[g]
+    }, index=pd.Index(g, name='key_byte_guess'))
     timing_stats = timing_stats.sort_values('mean')
     
     print("\nTop 10 fastest key byte guesses (most likely candidates):")
@@ -127,7 +115,7 @@ def analyze_timing_patterns(df):
     print(timing_stats.tail(10))
     
     # Find correct key
-    correct_key = df[df['is_correct'] == 1]['key_byte_guess'].iloc[0]
+    correct_key = acc.correct_guess()
     correct_timing = timing_stats.loc[correct_key, 'mean']
     correct_rank = (timing_stats.index.tolist().index(correct_key) + 1)
     
@@ -176,7 +164,7 @@ def predict_key_byte(features_df, results):
     
     return features_df
 
-def visualize_results(df, features_df):
+def visualize_results(acc, features_df):
     """Create visualizations of timing patterns"""
     print("\nGenerating visualizations...")
     
@@ -184,9 +172,9 @@ def visualize_results(df, features_df):
     
     # 1. Timing distribution for all key guesses
     ax1 = axes[0, 0]
-    correct_key = df[df['is_correct'] == 1]['key_byte_guess'].iloc[0]
+    correct_key = acc.correct_guess()
     
-    timing_by_key = df.groupby('key_byte_guess')['timing_us'].mean().sort_values()
+    timing_by_key = pd.Series(acc.mean[acc.guesses()], index=acc.guesses()).sort_values()
     colors = ['red' if k == correct_key else 'blue' for k in timing_by_key.index]
     
     ax1.bar(range(len(timing_by_key)), timing_by_key.values, color=colors, alpha=0.6)
@@ -197,11 +185,11 @@ def visualize_results(df, features_df):
     
     # 2. Timing distribution comparison: correct vs incorrect
     ax2 = axes[0, 1]
-    correct_timings = df[df['is_correct'] == 1]['timing_us']
-    incorrect_timings = df[df['is_correct'] == 0]['timing_us']
-    
-    ax2.hist(correct_timings, bins=50, alpha=0.7, label='Correct Key', color='green')
-    ax2.hist(incorrect_timings, bins=50, alpha=0.5, label='Incorrect Keys', color='red')
+    # Histograms come from the quantile sketch (log-spaced bins)
+    edges, counts = acc.histogram(correct=True)
+    ax2.hist(edges[:-1], bins=edges, weights=counts, alpha=0.7, label='Correct Key', color='green')
+    edges, counts = acc.histogram(correct=False)
+    ax2.hist(edges[:-1], bins=edges, weights=counts, alpha=0.5, label='Incorrect Keys', color='red')
     ax2.set_xlabel('Timing (us)')
     ax2.set_ylabel('Frequency')
     ax2.set_title('Timing Distribution: Correct vs Incorrect Key')
@@ -246,7 +234,7 @@ def visualize_results(df, features_df):
 
 def main():
     if len(sys.argv) < 2:
-        print("Usage: python3 ml_key_recovery.py <timing_data.csv>")
+        print("Usage: python3 ml_key_recovery.py <timing_data.csv|timing_data.tbin>")
         sys.exit(1)
     
     data_file = sys.argv[1]
@@ -255,14 +243,14 @@ def main():
     print("ML-BASED AES KEY RECOVERY USING TIMING ANALYSIS")
     print("="*60)
     
-    # Load data
-    df = load_data(data_file)
+    # Stream data into per-guess statistics
+    acc = load_data(data_file)
     
     # Analyze timing patterns
-    timing_stats, correct_key = analyze_timing_patterns(df)
+    timing_stats, correct_key = analyze_timing_patterns(acc)
     
     # Extract features
-    features_df = extract_features(df)
+    features_df = extract_features(acc)
     
     # Train models (no train/test split due to single positive sample)
     results = train_model(features_df)
@@ -271,7 +259,7 @@ def main():
     features_df = predict_key_byte(features_df, results)
     
     # Visualize
-    visualize_results(df, features_df)
+    visualize_results(acc, features_df)
     
     print("\n" + "="*60)
     print("ANALYSIS COMPLETE")
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""
+model_store.py
+
+Versioned persistence for the timing-attack models of predict_with_model.py.
+
+A model file (joblib) holds one dict:
+  format_version    FORMAT_VERSION; other versions are refused
+  sklearn_version   version that pickled the estimators (warned on mismatch)
+  feature_columns   feature order the models were trained on
+  scaler            fitted StandardScaler
+  rf, gb            RandomForestClassifier, GradientBoostingClassifier
+  X, y              accumulated per-guess training features (256 rows per set)
+  sources           [{path, size, mtime_ns}] of every training set folded in
+
+Keeping the feature rows (not the raw samples) lets new batches be added
+with warm_start: the forest grows extra trees and boosting continues for
+extra stages over old + new rows, without re-reading any old data.
+The scaler stays fixed after the first fit; trees split on thresholds in
+scaled units, so refitting it would silently invalidate existing trees.
+"""
+
+import os
+import warnings
+
+import joblib
+import numpy as np
+import sklearn
+
+FORMAT_VERSION = 1
+
+
+def file_signature(path):
+    st = os.stat(path)
+    return {'path': os.path.abspath(path), 'size': st.st_size, 'mtime_ns': st.st_mtime_ns}
+
+
+def save_models(path, store):
+    store = dict(store, format_version=FORMAT_VERSION, sklearn_version=sklearn.__version__)
+    tmp = f"{path}.tmp"
+    joblib.dump(store, tmp, compress=3)
+    os.replace(tmp, path)
+    print(f"Saved models to {path} ({len(store['sources'])} training sets, "
+          f"{store['rf'].n_estimators} RF trees, {store['gb'].n_estimators} GB stages)")
+
+
+def load_models(path, feature_columns):
+    """Load a model file, or return None if it is missing or unusable"""
+    if not os.path.exists(path):
+        return None
+    try:
+        store = joblib.load(path)
+    except Exception as e:
+        print(f"Ignoring unreadable model file {path}: {e}")
+        return None
+
+    if not isinstance(store, dict) or store.get('format_version') != FORMAT_VERSION:
+        print(f"Ignoring {path}: unsupported model format version")
+        return None
+    if list(store['feature_columns']) != list(feature_columns):
+        print(f"Ignoring {path}: trained on different features")
+        return None
+    if store['sklearn_version'] != sklearn.__version__:
+        warnings.warn(f"{path} was written by scikit-learn {store['sklearn_version']}, "
+                      f"running {sklearn.__version__}")
+    return store
+
+
+def is_current(store, training_file):
+    """Was the store trained on exactly this training file (same size and mtime)?"""
+    return bool(store['sources']) and store['sources'][0] == file_signature(training_file)
+
+
+def has_source(store, data_file):
+    sig = file_signature(data_file)
+    return any(src == sig for src in store['sources'])
+
+
+def add_training_set(store, features, labels, source, add_trees):
+    """Fold a new batch of per-guess features into the models with warm_start"""
+    X_new = store['scaler'].transform(features)
+    store['X'] = np.vstack([store['X'], X_new])
+    store['y'] = np.concatenate([store['y'], np.asarray(labels)])
+
+    rf, gb = store['rf'], store['gb']
+    rf.set_params(warm_start=True, n_estimators=rf.n_estimators + add_trees)
+    rf.fit(store['X'], store['y'])
+    gb.set_params(warm_start=True, n_estimators=gb.n_estimators + add_trees)
+    gb.fit(store['X'], store['y'])
+
+    store['sources'].append(source)
+    return store
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+online_scorer.py
+
+Live key recovery: consumes the sample stream of `collect_timing_data -s`
+while collection is still running, updates per-candidate timing statistics
+and reports the current best guess with its confidence.
+
+As in the batch analysis the fastest candidate is the most likely key
+byte. Confidence is the probability that the leader's true mean is below
+every other candidate's, with each candidate's mean modelled as a normal
+distribution around its sample mean (standard error std / sqrt(n)). Once
+it crosses the threshold the scorer exits, the pipe closes, and the
+collector stops on EPIPE.
+
+Usage:
+    ./collect_timing_data -s | python3 online_scorer.py [--threshold 0.99]
+"""
+
+import argparse
+import math
+import os
+import sys
+import time
+
+import numpy as np
+
+from streaming_features import TimingAccumulator
+
+RECORD = np.dtype([('guess', 'u1'), ('plaintext', 'u1'), ('is_correct', 'u1'),
+                   ('reserved', 'V5'), ('timing_us', '<f8')])   # tf_stream_record_t
+READ_SIZE = 1 << 16
+
+
+_erfc = np.vectorize(math.erfc, otypes=[float])
+
+# Nodes for integrating over the leader's mean: +-8 standard errors
+GRID = np.linspace(-8.0, 8.0, 321)
+GRID_WEIGHTS = np.exp(-0.5 * GRID ** 2)
+GRID_WEIGHTS /= GRID_WEIGHTS.sum()
+
+
+def leader_confidence(acc, min_samples):
+    """Return (leader, runner-up, confidence) over the candidates seen so far"""
+    g = acc.guesses()
+    if len(g) < 2 or acc.count[g].min() < min_samples:
+        return None, None, 0.0
+
+    mean = acc.mean[g]
+    se = acc.std(ddof=1)[g] / np.sqrt(acc.count[g])
+    order = np.argsort(mean)
+    best = order[0]
+
+    # P(leader < every rival) = E_x[prod_j P(rival_j > x)] with x drawn from
+    # the leader's distribution. A union (Bonferroni) bound instead sums
+    # the pairwise p-values, which with 255 rivals stays above 1, and the
+    # confidence at 0, long after the leader has separated
+    rivals = order[1:]
+    x = mean[best] + se[best] * GRID
+    z = (mean[rivals, None] - x[None, :]) / (np.sqrt(2.0) * np.maximum(se[rivals, None], 1e-300))
+    log_above = np.log(np.maximum(0.5 * _erfc(-z), 1e-300)).sum(axis=0)
+    confidence = float(np.dot(GRID_WEIGHTS, np.exp(log_above)))
+    return int(g[best]), int(g[order[1]]), min(confidence, 1.0)
+
+
+def read_records(fd, pending):
+    """Read whatever is available; returns (records, leftover bytes) or (None, ...) at EOF"""
+    data = os.read(fd, READ_SIZE)
+    if not data:
+        return None, pending
+    data = pending + data
+    usable = len(data) - len(data) % RECORD.itemsize
+    return np.frombuffer(data[:usable], dtype=RECORD), data[usable:]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Online key recovery from a live sample stream")
+    parser.add_argument('--threshold', type=float, default=0.99,
+                        help="stop once the leader's confidence reaches this (default 0.99)")
+    parser.add_argument('--min-samples', type=int, default=100,
+                        help="samples per candidate before scoring starts (default 100)")
+    parser.add_argument('--max-samples', type=int, default=0,
+                        help="give up after this many samples in total (default: no limit)")
+    parser.add_argument('--interval', type=float, default=0.5,
+                        help="seconds between status lines (default 0.5)")
+    args = parser.parse_args()
+
+    if sys.stdin.isatty():
+        parser.error("pipe the output of 'collect_timing_data -s' into this script")
+
+    print("=== Online Key Recovery ===")
+    print(f"Stopping at confidence >= {args.threshold}\n")
+
+    acc = TimingAccumulator(sketch=False)
+    fd = sys.stdin.fileno()
+    pending = b''
+    correct = None
+    leader, runner_up, confidence = None, None, 0.0
+    start = last_report = time.monotonic()
+
+    while True:
+        records, pending = read_records(fd, pending)
+        if records is None:
+            print("\nStream ended before reaching the threshold")
+            break
+        if len(records) == 0:
+            continue
+
+        acc.update(records['guess'], records['timing_us'], records['is_correct'])
+        if correct is None:
+            correct = acc.correct_guess()
+        total = int(acc.count.sum())
+
+        now = time.monotonic()
+        if now - last_report < args.interval and not (args.max_samples and total >= args.max_samples):
+            continue
+        last_report = now
+
+        leader, runner_up, confidence = leader_confidence(acc, args.min_samples)
+        if leader is None:
+            print(f"\r  {total:>10,} samples  (warming up)", end='', flush=True)
+        else:
+            print(f"\r  {total:>10,} samples  best 0x{leader:02x} ({acc.mean[leader]:.4f} us)"
+                  f"  runner-up 0x{runner_up:02x} ({acc.mean[runner_up]:.4f} us)"
+                  f"  confidence {confidence:.4f}", end='', flush=True)
+
+        if confidence >= args.threshold:
+            print("\n\nConfidence threshold reached")
+            break
+        if args.max_samples and total >= args.max_samples:
+            print("\n\nSample budget exhausted")
+            break
+
+    # The last status line may predate the final reads; rank once more
+    leader, runner_up, confidence = leader_confidence(acc, args.min_samples)
+    elapsed = time.monotonic() - start
+    total = int(acc.count.sum())
+    print(f"Samples consumed: {total:,} in {elapsed:.1f} s "
+          f"({total / len(acc.guesses()) if len(acc.guesses()) else 0:.0f} per candidate)")
+    if leader is not None:
+        print(f"Best guess: 0x{leader:02x} (confidence {confidence:.4f})")
+    if correct is not None:
+        print(f"Actual key byte: 0x{correct:02x}")
+        if leader is not None:
+            print(f"Result: {'SUCCESS ✓' if leader == correct else 'FAILED ✗'}")
+
+
+if __name__ == '__main__':
+    main()
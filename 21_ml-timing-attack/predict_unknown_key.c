@@ -9,14 +9,32 @@
  * 
  * The program collects timing data for a NEW secret key and saves it
  * for prediction by the trained ML models.
+ *
+ * Each key guess is expanded once, plaintexts come from a counter-based
+ * PRNG (splitmix64 of guess/sample index, so the data does not depend on
+ * thread scheduling), and guesses are spread over -j pinned threads. Every
+ * thread fills its own buffer; the buffers are merged in guess order once
+ * collection is done.
+ *
+ * Usage: predict_unknown_key [-j threads] [-z] [-m forest.bin] [output_file]
+ * An output name ending in .tbin selects the binary columnar format.
+ * With -m the models exported by `predict_with_model.py --export-forest`
+ * are evaluated natively (forest_infer.h) right after collection.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <time.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "vulnerable_aes.h"
+#include "timing_harness.h"
+#include "timing_format.h"
+#include "forest_infer.h"
 
 // NEW UNKNOWN SECRET KEY (attacker doesn't know this)
 static const uint8_t UNKNOWN_SECRET_KEY[16] = {
@@ -26,109 +44,397 @@ static const uint8_t UNKNOWN_SECRET_KEY[16] = {
 
 #define SAMPLES_PER_KEY 5000
 #define NUM_KEY_GUESSES 256
+#define NUM_FEATURES 8      // Order of FEATURE_COLUMNS in predict_with_model.py
+#define MAX_THREADS 64
+
+typedef struct {
+    pthread_t thread;
+    int id;
+    int nthreads;
+    int cpu;                    // -1 = not pinned
+    timing_harness_t harness;
+    double *timings;            // SAMPLES_PER_KEY per guess handled by this thread
+    uint8_t *pt_bytes;          // plaintext[0] of each sample
+} collector_t;
+
+static atomic_int guesses_done;
 
 /**
  * Measure encryption timing in microseconds
  */
-static double measure_encryption_time(const uint8_t *key, const uint8_t *plaintext, uint8_t *ciphertext) {
-    struct timespec start, end;
+static double measure_encryption_time(const timing_harness_t *th, VulnerableAES_CTX *ctx,
+                                      const uint8_t *plaintext, uint8_t *ciphertext) {
+    uint64_t start = th_begin(th);
+    vulnerable_aes_encrypt(ctx, plaintext, ciphertext);
+    uint64_t end = th_end(th);
+    
+    return th_ticks_to_us(th, (double)th_elapsed(th, start, end));
+}
+
+/**
+ * Thread t handles guesses t, t + nthreads, ... into its own buffers
+ */
+static void *collect_worker(void *arg) {
+    collector_t *c = arg;
+    uint8_t test_key[16];
+    uint8_t plaintext[16];
+    uint8_t ciphertext[16];
     VulnerableAES_CTX ctx;
+    size_t slot = 0;
     
-    // Expand key
-    vulnerable_aes_key_expansion(&ctx, key);
+    for (int key_guess = c->id; key_guess < NUM_KEY_GUESSES; key_guess += c->nthreads, slot++) {
+        // Construct and expand the test key once per guess
+        memcpy(test_key, UNKNOWN_SECRET_KEY, 16);
+        test_key[0] = key_guess;
+        vulnerable_aes_key_expansion(&ctx, test_key);
+        
+        double *t = c->timings + slot * SAMPLES_PER_KEY;
+        uint8_t *pt = c->pt_bytes + slot * SAMPLES_PER_KEY;
+        for (int sample = 0; sample < SAMPLES_PER_KEY; sample++) {
+            th_random_block(plaintext, (uint64_t)key_guess * SAMPLES_PER_KEY + sample);
+            t[sample] = measure_encryption_time(&c->harness, &ctx, plaintext, ciphertext);
+            pt[sample] = plaintext[0];
+        }
+        
+        // Progress bar
+        if (atomic_fetch_add(&guesses_done, 1) % 16 == 0) {
+            printf("=");
+            fflush(stdout);
+        }
+    }
+    return NULL;
+}
+
+// Quantile sketch of streaming_features.TimingAccumulator (same defaults), so
+// native features match the ones the models were trained on
+#define SKETCH_REL_ACCURACY 0.0025
+#define SKETCH_MIN_VALUE 1e-4
+#define SKETCH_MAX_VALUE 1e5
+
+typedef struct {
+    double gamma, log_gamma;
+    int num_bins;
+    uint32_t *hist;
+} sketch_t;
+
+static int sketch_init(sketch_t *s) {
+    s->gamma = (1 + SKETCH_REL_ACCURACY) / (1 - SKETCH_REL_ACCURACY);
+    s->log_gamma = log(s->gamma);
+    s->num_bins = (int)ceil(log(SKETCH_MAX_VALUE / SKETCH_MIN_VALUE) / s->log_gamma) + 2;
+    s->hist = calloc(s->num_bins, sizeof(uint32_t));
+    return s->hist ? 0 : -1;
+}
+
+// Bin 0 holds values below the minimum, the last bin everything above the maximum
+static int sketch_bin(const sketch_t *s, double t) {
+    if (t < SKETCH_MIN_VALUE) return 0;
+    long idx = (long)floor(log(t / SKETCH_MIN_VALUE) / s->log_gamma) + 1;
+    return idx < s->num_bins - 1 ? (int)idx : s->num_bins - 1;
+}
+
+static double sketch_bin_value(const sketch_t *s, int idx) {
+    if (idx == 0) return 0.0;
+    double lower = SKETCH_MIN_VALUE * pow(s->gamma, idx - 1);
+    return 2 * lower * s->gamma / (s->gamma + 1);
+}
+
+// Value of order statistic k, clamped to the seen range
+static double sketch_order_stat(const sketch_t *s, long k, double min, double max) {
+    long cum = 0;
+    int idx = 0;
     
-    // Measure encryption time
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    vulnerable_aes_encrypt(&ctx, plaintext, ciphertext);
-    clock_gettime(CLOCK_MONOTONIC, &end);
+    while (idx < s->num_bins - 1 && (cum += s->hist[idx]) <= k) idx++;
+    double v = sketch_bin_value(s, idx);
+    return v < min ? min : v > max ? max : v;
+}
+
+// Linear-interpolated quantile (pandas default) of n sketched samples
+static double sketch_quantile(const sketch_t *s, int n, double q, double min, double max) {
+    double rank = q * (n - 1);
+    long lo = (long)floor(rank);
+    long hi = lo + 1 < n ? lo + 1 : lo;
+    double v_lo = sketch_order_stat(s, lo, min, max);
+    double v_hi = sketch_order_stat(s, hi, min, max);
+    return v_lo + (v_hi - v_lo) * (rank - lo);
+}
+
+/**
+ * Per-guess features: mean, std (ddof=1), min, max, median, q25, q75, range
+ */
+static void compute_features(sketch_t *s, const double *t, int n, double *out) {
+    double sum = 0.0, ss = 0.0;
+    double min = t[0], max = t[0];
+    
+    memset(s->hist, 0, s->num_bins * sizeof(uint32_t));
+    for (int i = 0; i < n; i++) {
+        sum += t[i];
+        if (t[i] < min) min = t[i];
+        if (t[i] > max) max = t[i];
+        s->hist[sketch_bin(s, t[i])]++;
+    }
+    double mean = sum / n;
+    for (int i = 0; i < n; i++) ss += (t[i] - mean) * (t[i] - mean);
     
-    // Calculate elapsed time in microseconds
-    double elapsed = (end.tv_sec - start.tv_sec) * 1000000.0 +
-                    (end.tv_nsec - start.tv_nsec) / 1000.0;
+    out[0] = mean;
+    out[1] = n > 1 ? sqrt(ss / (n - 1)) : 0.0;
+    out[2] = min;
+    out[3] = max;
+    out[4] = sketch_quantile(s, n, 0.5, min, max);
+    out[5] = sketch_quantile(s, n, 0.25, min, max);
+    out[6] = sketch_quantile(s, n, 0.75, min, max);
+    out[7] = max - min;
+}
+
+static void print_top(const double *prob, int actual) {
+    int order[NUM_KEY_GUESSES];
     
-    return elapsed;
+    for (int i = 0; i < NUM_KEY_GUESSES; i++) order[i] = i;
+    // Selection of the 5 most likely guesses
+    for (int i = 0; i < 5; i++) {
+        for (int j = i + 1; j < NUM_KEY_GUESSES; j++) {
+            if (prob[order[j]] > prob[order[i]]) {
+                int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+            }
+        }
+        printf("  %d. Key 0x%02x: %6.2f%% confidence%s\n", i + 1, order[i], prob[order[i]] * 100,
+               order[i] == actual ? " *** CORRECT ***" : "");
+    }
 }
 
 /**
- * Generate varied plaintext to avoid cache effects
+ * Score all key guesses with the exported forests
  */
-static void generate_plaintext(uint8_t *plaintext, uint32_t seed) {
-    srand(seed);
-    for (int i = 0; i < 16; i++) {
-        plaintext[i] = rand() & 0xFF;
+static int native_predict(const char *model_file, double *timings) {
+    fi_forest_t forest;
+    sketch_t sketch;
+    double rows[NUM_KEY_GUESSES * NUM_FEATURES];
+    float x[NUM_KEY_GUESSES * NUM_FEATURES];
+    double prob[FI_MAX_MODELS][NUM_KEY_GUESSES];
+    double consensus[NUM_KEY_GUESSES] = {0};
+    int actual = UNKNOWN_SECRET_KEY[0];
+    
+    if (fi_load(&forest, model_file) != 0) {
+        return -1;
+    }
+    if (forest.nfeatures != NUM_FEATURES) {
+        fprintf(stderr, "%s: expected %d features, found %d\n", model_file, NUM_FEATURES, forest.nfeatures);
+        fi_free(&forest);
+        return -1;
+    }
+    
+    if (sketch_init(&sketch) != 0) {
+        perror("calloc");
+        fi_free(&forest);
+        return -1;
+    }
+    
+    printf("\n=== Native Inference (%s) ===\n", model_file);
+    for (int g = 0; g < NUM_KEY_GUESSES; g++) {
+        compute_features(&sketch, timings + (size_t)g * SAMPLES_PER_KEY, SAMPLES_PER_KEY,
+                         rows + g * NUM_FEATURES);
+    }
+    free(sketch.hist);
+    
+    uint64_t start = th_clock_ns();
+    fi_scale(&forest, rows, NUM_KEY_GUESSES, x);
+    for (int m = 0; m < forest.nmodels; m++) {
+        fi_predict(&forest.models[m], x, NUM_KEY_GUESSES, prob[m]);
+    }
+    uint64_t elapsed = th_clock_ns() - start;
+    
+    for (int m = 0; m < forest.nmodels; m++) {
+        printf("\n--- %s (%d trees, depth %d) ---\n", forest.models[m].name,
+               forest.models[m].ntrees, forest.models[m].max_depth);
+        print_top(prob[m], actual);
+        for (int g = 0; g < NUM_KEY_GUESSES; g++) {
+            consensus[g] += prob[m][g] / forest.nmodels;
+        }
     }
+    
+    printf("\n--- Consensus ---\n");
+    print_top(consensus, actual);
+    
+    int best = 0;
+    for (int g = 1; g < NUM_KEY_GUESSES; g++) {
+        if (consensus[g] > consensus[best]) best = g;
+    }
+    printf("\nPredicted key byte: 0x%02x, actual: 0x%02x -> %s\n", best, actual,
+           best == actual ? "SUCCESS" : "FAILED");
+    printf("Inference time: %.1f us for %d guesses x %d models (%s)\n", elapsed / 1000.0,
+           NUM_KEY_GUESSES, forest.nmodels,
+#if FI_HAVE_AVX2
+           fi_avx2_available() ? "AVX2" : "scalar"
+#else
+           "scalar"
+#endif
+           );
+    
+    fi_free(&forest);
+    return 0;
 }
 
-int main() {
-    FILE *fp;
-    uint8_t test_key[16];
-    uint8_t plaintext[16];
-    uint8_t ciphertext[16];
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j threads] [-z] [-m forest.bin] [output_file]\n", prog);
+    fprintf(stderr, "  -j  Collection threads, pinned one per CPU; 0 = all CPUs (default 1)\n");
+    fprintf(stderr, "  -z  Compress chunks of .tbin output with zlib\n");
+    fprintf(stderr, "  -m  Score the collected data with a forest exported by predict_with_model.py\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *output_file = "unknown_key_data.csv";
+    const char *model_file = NULL;
+    static collector_t workers[MAX_THREADS];
+    int cpus[MAX_THREADS];
+    int nthreads = 1;
+    int compress = 0;
+    int opt;
+    int rc = 1;
+    tf_sink_t out;
     uint32_t total_samples = 0;
     
-    printf("=== ML-Based AES Key Recovery - PREDICTION MODE ===\n\n");
-    printf("Unknown Secret Key (first byte): 0x%02x\n", UNKNOWN_SECRET_KEY[0]);
-    printf("Target: Predict the first key byte using trained ML models\n\n");
+    while ((opt = getopt(argc, argv, "j:zm:h")) != -1) {
+        switch (opt) {
+        case 'j': nthreads = atoi(optarg); break;
+        case 'z': compress = 1; break;
+        case 'm': model_file = optarg; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        output_file = argv[optind];
+    }
     
-    // Open output file
-    fp = fopen("unknown_key_data.csv", "w");
-    if (!fp) {
-        perror("Failed to open output file");
+    int ncpus = th_select_cpus(cpus, MAX_THREADS);
+    if (nthreads == 0) {
+        nthreads = ncpus > 0 ? ncpus : 1;
+    }
+    if (nthreads < 1 || nthreads > MAX_THREADS) {
+        usage(argv[0]);
         return 1;
     }
+    if (nthreads > NUM_KEY_GUESSES) {
+        nthreads = NUM_KEY_GUESSES;
+    }
+    
+    // Merged per-guess timings, filled from the worker buffers at the end
+    double *timings = malloc((size_t)NUM_KEY_GUESSES * SAMPLES_PER_KEY * sizeof(double));
+    if (!timings) {
+        perror("malloc");
+        return 1;
+    }
+    
+    cpu_set_t main_affinity;
+    sched_getaffinity(0, sizeof(main_affinity), &main_affinity);
+    
+    for (int i = 0; i < nthreads; i++) {
+        collector_t *c = &workers[i];
+        size_t nguesses = (NUM_KEY_GUESSES - i + nthreads - 1) / nthreads;
+        
+        c->id = i;
+        c->nthreads = nthreads;
+        c->cpu = ncpus > 0 ? cpus[i % ncpus] : -1;
+        c->timings = malloc(nguesses * SAMPLES_PER_KEY * sizeof(double));
+        c->pt_bytes = malloc(nguesses * SAMPLES_PER_KEY);
+        if (!c->timings || !c->pt_bytes) {
+            perror("malloc");
+            goto out_free;
+        }
+        // Calibrate on the worker's CPU (this thread hops there briefly);
+        // the worker itself is created with that affinity below
+        if (th_init(&c->harness, c->cpu >= 0 ? c->cpu : -2) != 0) {
+            fprintf(stderr, "Timing harness calibration failed\n");
+            goto out_free;
+        }
+    }
+    sched_setaffinity(0, sizeof(main_affinity), &main_affinity);
     
-    // Write CSV header
-    fprintf(fp, "key_guess,plaintext_byte,timing_us,is_correct\n");
+    printf("=== ML-Based AES Key Recovery - PREDICTION MODE ===\n\n");
+    printf("Timer: %s, %.1f ticks/us, overhead %lu ticks subtracted\n",
+           th_counter_name(&workers[0].harness), workers[0].harness.ticks_per_us,
+           (unsigned long)workers[0].harness.overhead);
+    printf("Threads: %d (CPUs", nthreads);
+    for (int i = 0; i < nthreads; i++) printf(" %d", workers[i].cpu);
+    printf(")\n");
+    printf("Unknown Secret Key (first byte): 0x%02x\n", UNKNOWN_SECRET_KEY[0]);
+    printf("Target: Predict the first key byte using trained ML models\n\n");
     
     printf("Phase 1: Collecting timing data for unknown key...\n");
     printf("Progress: [");
     fflush(stdout);
     
-    // Test each possible first key byte
-    for (int key_guess = 0; key_guess < NUM_KEY_GUESSES; key_guess++) {
-        // Progress bar
-        if (key_guess % 16 == 0) {
-            printf("=");
-            fflush(stdout);
-        }
+    uint64_t start = th_clock_ns();
+    for (int i = 0; i < nthreads; i++) {
+        pthread_attr_t attr;
+        cpu_set_t set;
         
-        // Construct test key with guessed first byte
-        test_key[0] = key_guess;
-        for (int i = 1; i < 16; i++) {
-            test_key[i] = UNKNOWN_SECRET_KEY[i];
+        pthread_attr_init(&attr);
+        if (workers[i].cpu >= 0) {
+            CPU_ZERO(&set);
+            CPU_SET(workers[i].cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        if (pthread_create(&workers[i].thread, &attr, collect_worker, &workers[i]) != 0) {
+            perror("pthread_create");
+            pthread_attr_destroy(&attr);
+            for (int j = 0; j < i; j++) pthread_join(workers[j].thread, NULL);
+            goto out_free;
         }
+        pthread_attr_destroy(&attr);
+    }
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    double seconds = (th_clock_ns() - start) / 1e9;
+    printf("]\n\n");
+    
+    // Merge the per-thread buffers in guess order
+    if (tf_sink_open(&out, output_file, "key_guess", "plaintext_byte", compress) != 0) {
+        perror("Failed to open output file");
+        goto out_free;
+    }
+    for (int key_guess = 0; key_guess < NUM_KEY_GUESSES; key_guess++) {
+        collector_t *c = &workers[key_guess % nthreads];
+        size_t slot = (size_t)(key_guess / nthreads) * SAMPLES_PER_KEY;
+        int is_correct = (key_guess == UNKNOWN_SECRET_KEY[0]) ? 1 : 0;
         
-        // Collect samples for this key guess
+        memcpy(timings + (size_t)key_guess * SAMPLES_PER_KEY, c->timings + slot,
+               SAMPLES_PER_KEY * sizeof(double));
         for (int sample = 0; sample < SAMPLES_PER_KEY; sample++) {
-            // Generate varied plaintext
-            generate_plaintext(plaintext, key_guess * SAMPLES_PER_KEY + sample);
-            
-            // Measure encryption timing
-            double timing = measure_encryption_time(test_key, plaintext, ciphertext);
-            
-            // Record: is this the correct key byte?
-            int is_correct = (key_guess == UNKNOWN_SECRET_KEY[0]) ? 1 : 0;
-            
-            // Write to CSV
-            fprintf(fp, "%d,%d,%.6f,%d\n", 
-                   key_guess, plaintext[0], timing, is_correct);
-            
+            if (tf_sink_write(&out, key_guess, c->pt_bytes[slot + sample],
+                              c->timings[slot + sample], is_correct) != 0) {
+                perror("Failed to write output file");
+                tf_sink_close(&out);
+                goto out_free;
+            }
             total_samples++;
         }
     }
-    
-    printf("]\n\n");
-    fclose(fp);
+    if (tf_sink_close(&out) != 0) {
+        perror("Failed to write output file");
+        goto out_free;
+    }
     
     printf("Phase 2: Data collection complete!\n");
     printf("  Total samples: %u\n", total_samples);
-    printf("  Output file: unknown_key_data.csv\n");
-    printf("  File size: %.2f MB\n", total_samples * 30.0 / 1024.0 / 1024.0);
+    printf("  Collection time: %.2f s (%.0f samples/s)\n", seconds, total_samples / seconds);
+    printf("  Output file: %s\n", output_file);
+    
+    if (model_file) {
+        rc = native_predict(model_file, timings) == 0 ? 0 : 1;
+        goto out_free;
+    }
     
     printf("\n=== Next Step ===\n");
     printf("Run the trained ML models to predict the unknown key:\n");
-    printf("  python predict_with_model.py unknown_key_data.csv\n\n");
+    printf("  python predict_with_model.py %s\n\n", output_file);
     printf("The model will analyze timing patterns and predict: 0x%02x\n", UNKNOWN_SECRET_KEY[0]);
+    rc = 0;
     
-    return 0;
+out_free:
+    for (int i = 0; i < nthreads; i++) {
+        free(workers[i].timings);
+        free(workers[i].pt_bytes);
+    }
+    free(timings);
+    return rc;
 }
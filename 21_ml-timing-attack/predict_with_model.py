@@ -9,9 +9,23 @@ This demonstrates the practical attack scenario:
 3. Predict the unknown key byte
 
 Usage:
-    python predict_with_model.py unknown_key_data.csv
+    python predict_with_model.py unknown_key_data.csv [timing_data.csv]
+                                 [--model timing_models.joblib] [--retrain]
+                                 [--update new_data.csv ...] [--export-forest forest.bin]
+
+Both files may also be in the binary .tbin format (see timing_io.py).
+Trained models are saved to --model (model_store.py) and reused while the
+training data is unchanged, so a new target costs one feature pass instead
+of a retrain. --update folds further labelled datasets into the saved
+models with warm_start.
+
+--export-forest also writes the scaler and both trained ensembles in the
+flat format of forest_infer.h, for native inference in predict_unknown_key.
 """
 
+import argparse
+import os
+import struct
 import sys
 import pandas as pd
 import numpy as np
@@ -19,28 +33,89 @@ from sklearn.ensemble import RandomForestClassifier, GradientBoostingClassifier
 from sklearn.preprocessing import StandardScaler
 import matplotlib.pyplot as plt
 import seaborn as sns
+from streaming_features import accumulate
+import model_store
 
-def extract_features(df):
-    """Extract statistical features from timing data"""
-    features = df.groupby('key_guess')['timing_us'].agg([
-        'mean', 'std', 'min', 'max', 'median',
-        ('q25', lambda x: x.quantile(0.25)),
-        ('q75', lambda x: x.quantile(0.75)),
-    ]).reset_index()
-    
-    features['range'] = features['max'] - features['min']
-    features['is_correct'] = df.groupby('key_guess')['is_correct'].first().values
+def extract_features(data_file):
+    """Stream timing data and extract per-guess statistical features"""
+    acc = accumulate(data_file)
+    f = acc.features(ddof=1)
+    features = pd.DataFrame({'key_guess': f['guess']})
+    for name in FEATURE_COLUMNS:
+        features[name] = f[name]
+    features['is_correct'] = f['is_correct']
     
     return features
 
+FEATURE_COLUMNS = ['mean', 'std', 'min', 'max', 'median', 'q25', 'q75', 'range']
+
+def _flatten_trees(trees, leaf_values):
+    """Concatenate sklearn trees into SoA node arrays with self-looping leaves"""
+    roots, feature, threshold, left, right, value = [], [], [], [], [], []
+    offset = 0
+    for tree, leaf in zip(trees, leaf_values):
+        n = tree.node_count
+        idx = np.arange(n, dtype=np.int32) + offset
+        is_leaf = tree.children_left == -1
+        
+        # Round thresholds down to float32: for float32 x, x <= t exactly
+        # when x <= the largest float32 not above t
+        thr = tree.threshold.astype(np.float32)
+        thr = np.where(thr > tree.threshold, np.nextafter(thr, np.float32(-np.inf)), thr)
+        
+        roots.append(offset)
+        feature.append(np.where(is_leaf, 0, tree.feature).astype(np.int32))
+        threshold.append(np.where(is_leaf, 0, thr).astype(np.float32))
+        left.append(np.where(is_leaf, idx, tree.children_left + offset).astype(np.int32))
+        right.append(np.where(is_leaf, idx, tree.children_right + offset).astype(np.int32))
+        value.append(np.where(is_leaf, leaf, 0).astype(np.float32))
+        offset += n
+    
+    return (np.array(roots, dtype=np.uint32), np.concatenate(feature), np.concatenate(threshold),
+            np.concatenate(left), np.concatenate(right), np.concatenate(value))
+
+def export_forest(path, scaler, models):
+    """Write the scaler and tree ensembles in the forest_infer.h format"""
+    nfeatures = len(scaler.mean_)
+    out = [b'FRST', struct.pack('<III', 1, nfeatures, len(models)),
+           scaler.mean_.astype('<f8').tobytes(), scaler.scale_.astype('<f8').tobytes()]
+    
+    for name, model in models:
+        if isinstance(model, RandomForestClassifier):
+            # Mean over trees of the normalized class-1 leaf fraction
+            positive = list(model.classes_).index(1)
+            trees = [est.tree_ for est in model.estimators_]
+            leaves = [t.value[:, 0, positive] / t.value[:, 0, :].sum(axis=1) for t in trees]
+            kind, bias, weight = 0, 0.0, 1.0 / len(trees)
+        else:
+            # sigmoid(init + learning_rate * sum of leaf values); the init
+            # term is recovered from the decision function at any point
+            trees = [est.tree_ for est in model.estimators_[:, 0]]
+            leaves = [t.value[:, 0, 0] for t in trees]
+            kind, weight = 1, model.learning_rate
+            x0 = np.zeros((1, nfeatures))
+            bias = model.decision_function(x0)[0] - weight * sum(
+                est.predict(x0)[0] for est in model.estimators_[:, 0])
+        
+        roots, feature, threshold, left, right, value = _flatten_trees(trees, leaves)
+        max_depth = max(t.max_depth for t in trees)
+        section = [struct.pack('<IIIIdd32s', kind, len(trees), max_depth, len(feature),
+                               bias, weight, name.encode()[:31]),
+                   roots.tobytes(), feature.tobytes(), threshold.tobytes(),
+                   left.tobytes(), right.tobytes(), value.tobytes()]
+        size = sum(len(b) for b in section)
+        section.append(b'\0' * (-size % 8))
+        out.extend(section)
+    
+    with open(path, 'wb') as f:
+        f.write(b''.join(out))
+    print(f"Exported {len(models)} models to {path}")
+
 def train_models(training_data_file):
     """Train models on the original training data"""
-    print("Loading training data...")
-    df_train = pd.read_csv(training_data_file)
-    
-    # Extract features
-    features_train = extract_features(df_train)
-    X_train = features_train.drop(['key_guess', 'is_correct'], axis=1)
+    print("Streaming training data...")
+    features_train = extract_features(training_data_file)
+    X_train = features_train[FEATURE_COLUMNS]
     y_train = features_train['is_correct']
     
     # Standardize features
@@ -55,27 +130,57 @@ def train_models(training_data_file):
     gb_model = GradientBoostingClassifier(n_estimators=100, random_state=42)
     gb_model.fit(X_train_scaled, y_train)
     
-    return rf_model, gb_model, scaler
+    return {
+        'feature_columns': FEATURE_COLUMNS,
+        'scaler': scaler,
+        'rf': rf_model,
+        'gb': gb_model,
+        'X': X_train_scaled,
+        'y': y_train.to_numpy(),
+        'sources': [model_store.file_signature(training_data_file)],
+    }
+
+def load_or_train(training_data_file, model_file, retrain):
+    """Reuse saved models while they match the training data, else retrain"""
+    if model_file and not retrain:
+        store = model_store.load_models(model_file, FEATURE_COLUMNS)
+        if store is not None and (not os.path.exists(training_data_file) or
+                                  model_store.is_current(store, training_data_file)):
+            print(f"Loaded models from {model_file} "
+                  f"({len(store['sources'])} training sets, no retraining needed)")
+            return store, False
+        if store is not None:
+            print(f"{model_file} was trained on a different {training_data_file}, retraining")
+    return train_models(training_data_file), True
+
+def update_models(store, data_files, add_trees):
+    """Warm-start the saved models on additional labelled datasets"""
+    changed = False
+    for data_file in data_files:
+        if model_store.has_source(store, data_file):
+            print(f"{data_file} is already part of the models, skipping")
+            continue
+        print(f"Adding {data_file} ({add_trees} more trees per model)...")
+        features = extract_features(data_file)
+        model_store.add_training_set(store, features[FEATURE_COLUMNS], features['is_correct'],
+                                     model_store.file_signature(data_file), add_trees)
+        changed = True
+    return changed
 
 def predict_unknown_key(rf_model, gb_model, scaler, unknown_data_file):
     """Predict the unknown key from timing data"""
     print("\n=== PREDICTING UNKNOWN KEY ===\n")
     
     # Load unknown key timing data
-    print(f"Loading unknown key data from {unknown_data_file}...")
-    df_unknown = pd.read_csv(unknown_data_file)
-    print(f"Loaded {len(df_unknown):,} samples")
-    
-    # Extract features
-    print("Extracting features...")
-    features_unknown = extract_features(df_unknown)
+    print(f"Streaming unknown key data from {unknown_data_file}...")
+    features_unknown = extract_features(unknown_data_file)
     
     # Get the actual unknown key (for verification)
     actual_key = features_unknown[features_unknown['is_correct'] == 1]['key_guess'].values[0]
     print(f"\nActual unknown key byte: 0x{actual_key:02x}")
     
     # Prepare features for prediction
-    X_unknown = features_unknown.drop(['key_guess', 'is_correct'], axis=1)
+    X_unknown = features_unknown[FEATURE_COLUMNS]
     X_unknown_scaled = scaler.transform(X_unknown)
     
     # Predict with both models
@@ -221,19 +326,39 @@ def create_prediction_visualization(features, actual_key, predicted_key):
     print("Saved visualization: unknown_key_prediction.png")
 
 def main():
-    if len(sys.argv) != 2:
-        print("Usage: python predict_with_model.py <unknown_key_data.csv>")
-        sys.exit(1)
-    
-    unknown_data_file = sys.argv[1]
-    training_data_file = "timing_data.csv"  # Original training data
+    parser = argparse.ArgumentParser(description="Predict an unknown key byte from timing data")
+    parser.add_argument('unknown_data_file')
+    parser.add_argument('training_data_file', nargs='?', default="timing_data.csv",
+                        help="original training data (default timing_data.csv)")
+    parser.add_argument('--model', default="timing_models.joblib", metavar='PATH',
+                        help="saved models to reuse/update (default timing_models.joblib, '' = none)")
+    parser.add_argument('--retrain', action='store_true',
+                        help="ignore the saved models and train from scratch")
+    parser.add_argument('--update', nargs='+', default=[], metavar='DATA',
+                        help="labelled datasets to fold into the models with warm_start")
+    parser.add_argument('--add-trees', type=int, default=50,
+                        help="trees/stages added per model for each --update dataset (default 50)")
+    parser.add_argument('--export-forest', metavar='PATH',
+                        help="also export the trained models for native inference")
+    args = parser.parse_args()
+    
+    unknown_data_file = args.unknown_data_file
+    training_data_file = args.training_data_file
     
     print("=== ML-Based Key Recovery - PREDICTION MODE ===\n")
     
     # Check if training data exists
     try:
-        # Train models on original data
-        rf_model, gb_model, scaler = train_models(training_data_file)
+        # Load saved models, or train on the original data
+        store, changed = load_or_train(training_data_file, args.model, args.retrain)
+        changed |= update_models(store, args.update, args.add_trees)
+        if changed and args.model:
+            model_store.save_models(args.model, store)
+        rf_model, gb_model, scaler = store['rf'], store['gb'], store['scaler']
+        
+        if args.export_forest:
+            export_forest(args.export_forest, scaler,
+                          [('Random Forest', rf_model), ('Gradient Boosting', gb_model)])
         
         # Predict unknown key
         success = predict_unknown_key(rf_model, gb_model, scaler, unknown_data_file)
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""
+streaming_features.py
+
+Bounded-memory feature extraction for timing data of any size.
+
+Samples are read chunk by chunk (timing_io.iter_chunks) and folded into
+per-key-guess running statistics:
+  - count, mean and variance (chunk moments merged with Chan's formula)
+  - min / max
+  - a log-binned histogram per guess (relative-error quantile sketch,
+    as in DDSketch) for median, q25 and q75
+
+Memory is the current chunk plus 256 histograms, independent of how many
+samples were collected. A quantile is read as in pandas ('linear'): the two
+order statistics around rank q * (n - 1) are interpolated. The sketch
+knows each order statistic to within its relative accuracy (0.25% by
+default). The interpolation is a weighted mean of the two, so its error
+stays within that bound for timings between min_value and max_value. Only
+the interpolated estimate is bounded. Reading one bin without
+interpolating can be further off, by up to the gap to the neighbouring
+sample.
+
+predict_unknown_key.c computes its native features with the same sketch
+(same parameters, same interpolation). The models therefore see identical
+inputs in training and inference.
+"""
+
+import math
+import sys
+
+import numpy as np
+import pandas as pd
+
+from timing_io import iter_chunks
+
+NUM_GUESSES = 256
+GUESS_COLUMNS = ('key_byte_guess', 'key_guess')
+
+
+class TimingAccumulator:
+    """Running per-guess timing statistics over streamed samples"""
+
+    def __init__(self, num_guesses=NUM_GUESSES, rel_accuracy=0.0025,
+                 min_value=1e-4, max_value=1e5, sketch=True):
+        self.num_guesses = num_guesses
+        self.count = np.zeros(num_guesses, dtype=np.int64)
+        self.mean = np.zeros(num_guesses)
+        self.m2 = np.zeros(num_guesses)
+        self.min = np.full(num_guesses, np.inf)
+        self.max = np.full(num_guesses, -np.inf)
+        self.correct = np.zeros(num_guesses, dtype=bool)
+
+        # Bin 0 holds values below min_value (the harness clamps to 0),
+        # the last bin everything above max_value
+        self.gamma = (1 + rel_accuracy) / (1 - rel_accuracy)
+        self.log_gamma = math.log(self.gamma)
+        self.min_value = min_value
+        self.num_bins = int(math.ceil(math.log(max_value / min_value) / self.log_gamma)) + 2
+        # Without the sketch only moments and min/max are kept (quantile()
+        # and histogram() are unavailable), which keeps small updates cheap
+        self.hist = np.zeros((num_guesses, self.num_bins), dtype=np.int64) if sketch else None
+
+    def _bins(self, timings):
+        scaled = np.maximum(timings, self.min_value) / self.min_value
+        idx = np.floor(np.log(scaled) / self.log_gamma).astype(np.int64) + 1
+        idx[timings < self.min_value] = 0
+        return np.minimum(idx, self.num_bins - 1)
+
+    def _bin_value(self, idx):
+        """Representative value of each bin (minimizes relative error)"""
+        idx = np.asarray(idx)
+        lower = self.min_value * self.gamma ** (idx - 1)
+        return np.where(idx == 0, 0.0, 2 * lower * self.gamma / (self.gamma + 1))
+
+    def update(self, guesses, timings, is_correct):
+        """Fold one chunk of samples into the running statistics"""
+        guesses = np.asarray(guesses, dtype=np.int64)
+        timings = np.asarray(timings, dtype=np.float64)
+        n_g = self.num_guesses
+
+        n = np.bincount(guesses, minlength=n_g)
+        present = n > 0
+        chunk_mean = np.zeros(n_g)
+        chunk_mean[present] = np.bincount(guesses, weights=timings, minlength=n_g)[present] / n[present]
+        dev = timings - chunk_mean[guesses]
+        chunk_m2 = np.bincount(guesses, weights=dev * dev, minlength=n_g)
+
+        # Chan et al. parallel merge of (count, mean, M2)
+        total = self.count + n
+        delta = chunk_mean - self.mean
+        with np.errstate(invalid='ignore', divide='ignore'):
+            self.mean = np.where(present, self.mean + delta * n / total, self.mean)
+            self.m2 = np.where(present, self.m2 + chunk_m2 + delta * delta * self.count * n / total,
+                               self.m2)
+        self.count = total
+
+        np.minimum.at(self.min, guesses, timings)
+        np.maximum.at(self.max, guesses, timings)
+        self.correct |= np.bincount(guesses, weights=np.asarray(is_correct, dtype=np.float64),
+                                    minlength=n_g) > 0
+
+        if self.hist is not None:
+            flat = guesses * self.num_bins + self._bins(timings)
+            self.hist += np.bincount(flat, minlength=n_g * self.num_bins).reshape(n_g, self.num_bins)
+
+    def guesses(self):
+        return np.nonzero(self.count)[0]
+
+    def std(self, ddof=0):
+        with np.errstate(invalid='ignore', divide='ignore'):
+            return np.sqrt(self.m2 / (self.count - ddof))
+
+    def quantile(self, q):
+        """Per-guess quantile q (pandas 'linear' convention, sketch accuracy)"""
+        out = np.full(self.num_guesses, np.nan)
+        cum = np.cumsum(self.hist, axis=1)
+        for g in self.guesses():
+            rank = q * (self.count[g] - 1)
+            lo = math.floor(rank)
+            hi = min(lo + 1, self.count[g] - 1)
+            # Bins holding order statistics lo and hi, clamped to the seen range
+            v_lo, v_hi = np.clip(self._bin_value(np.searchsorted(cum[g], [lo, hi], side='right')),
+                                 self.min[g], self.max[g])
+            out[g] = v_lo + (v_hi - v_lo) * (rank - lo)
+        return out
+
+    def features(self, ddof=0):
+        """Feature table, one row per observed guess"""
+        g = self.guesses()
+        return {
+            'guess': g,
+            'mean': self.mean[g],
+            'std': self.std(ddof)[g],
+            'min': self.min[g],
+            'max': self.max[g],
+            'median': self.quantile(0.5)[g],
+            'q25': self.quantile(0.25)[g],
+            'q75': self.quantile(0.75)[g],
+            'range': (self.max - self.min)[g],
+            'is_correct': self.correct[g].astype(np.int64),
+        }
+
+    def histogram(self, correct):
+        """Combined histogram of the correct (or all incorrect) guesses: (edges, counts)"""
+        rows = self.hist[self.correct] if correct else self.hist[~self.correct & (self.count > 0)]
+        counts = rows.sum(axis=0)
+        used = np.nonzero(counts)[0]
+        if len(used) == 0:
+            return np.array([0.0, 1.0]), np.zeros(1)
+        lo, hi = used[0], used[-1] + 1
+        edges = np.concatenate(([0.0], self.min_value * self.gamma ** np.arange(self.num_bins)))
+        return edges[lo:hi + 1], counts[lo:hi]
+
+    def correct_guess(self):
+        hits = np.nonzero(self.correct)[0]
+        return int(hits[0]) if len(hits) else None
+
+
+def guess_column(columns):
+    for name in GUESS_COLUMNS:
+        if name in columns:
+            return name
+    raise ValueError(f"no key guess column in {list(columns)}")
+
+
+def accumulate(path, chunk_rows=1 << 20, progress=True):
+    """Stream a CSV or .tbin file into a TimingAccumulator"""
+    acc = TimingAccumulator()
+    total = 0
+    for chunk in iter_chunks(path, chunk_rows):
+        col = guess_column(chunk)
+        acc.update(chunk[col], chunk['timing_us'], chunk['is_correct'])
+        total += len(chunk['timing_us'])
+        if progress:
+            print(f"\r  {total:,} samples", end='', flush=True)
+    if progress:
+        print()
+    return acc
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("Usage: python3 streaming_features.py <timing_data.csv|timing_data.tbin>")
+        sys.exit(1)
+
+    acc = accumulate(sys.argv[1])
+    df = pd.DataFrame(acc.features(ddof=1)).set_index('guess')
+    print(df.sort_values('mean').head(10))
+
+
+if __name__ == '__main__':
+    main()
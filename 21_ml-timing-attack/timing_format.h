@@ -0,0 +1,289 @@
+/*
+ * Binary Columnar Timing Format (.tbin)
+ * Replaces per-row fprintf/CSV parsing for the timing collectors.
+ *
+ * Layout (all integers little-endian):
+ *   header      64 bytes   tf_header_t
+ *   columns     32 bytes   tf_column_t per column (name + numpy dtype string)
+ *   padding     to a 64-byte boundary
+ *   chunks      repeated until EOF:
+ *                 u32 rows, u32 reserved, u64 stored_size[ncols]
+ *                 one block per column, each padded to 8 bytes
+ *
+ * Rows are buffered column-wise and every chunk goes out in a single
+ * write(). Uncompressed blocks are raw fixed-width arrays aligned to 8 bytes
+ * so the Python side can np.memmap them directly (timing_io.py); with
+ * TF_FLAG_ZLIB each block is deflated on its own.
+ */
+
+#ifndef TIMING_FORMAT_H
+#define TIMING_FORMAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define TF_MAGIC "TBIN"
+#define TF_VERSION 1
+#define TF_FLAG_ZLIB 0x1
+#define TF_DEFAULT_CHUNK_ROWS 65536
+#define TF_MAX_COLUMNS 16
+#define TF_ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t ncols;
+    uint32_t flags;
+    uint32_t chunk_rows;
+    uint64_t nrows;         // Patched on close
+    uint32_t nchunks;       // Patched on close
+    uint8_t reserved[36];
+} tf_header_t;
+
+typedef struct {
+    char name[24];
+    char dtype[8];          // numpy dtype string: "|u1", "<u2", "<u4", "<f8", ...
+} tf_column_t;
+
+typedef struct {
+    int fd;
+    tf_header_t hdr;
+    tf_column_t cols[TF_MAX_COLUMNS];
+    size_t width[TF_MAX_COLUMNS];
+    uint8_t *data[TF_MAX_COLUMNS];  // chunk_rows * width per column
+    uint32_t row;                   // Rows buffered in the current chunk
+    uint8_t *out;                   // Assembled chunk
+    size_t out_cap;
+} tf_writer_t;
+
+_Static_assert(sizeof(tf_header_t) == 64, "tf_header_t must be 64 bytes");
+_Static_assert(sizeof(tf_column_t) == 32, "tf_column_t must be 32 bytes");
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "tbin is written in host byte order");
+
+// Does the file name select the binary format?
+static inline int tf_is_binary_path(const char *path) {
+    size_t n = strlen(path);
+    return n >= 5 && strcmp(path + n - 5, ".tbin") == 0;
+}
+
+static inline size_t tf_dtype_width(const char *dtype) {
+    return (size_t)atoi(dtype + 2);
+}
+
+static inline size_t tf_data_offset(int ncols) {
+    return (sizeof(tf_header_t) + ncols * sizeof(tf_column_t) + 63) & ~(size_t)63;
+}
+
+static inline int tf_write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Emit the buffered rows as one chunk
+static inline int tf_flush_chunk(tf_writer_t *w) {
+    int ncols = w->hdr.ncols;
+    size_t pos = 8 + 8 * (size_t)ncols;
+
+    if (w->row == 0) return 0;
+
+    uint32_t rows = w->row;
+    memset(w->out, 0, pos);
+    memcpy(w->out, &rows, sizeof(rows));
+
+    for (int c = 0; c < ncols; c++) {
+        size_t raw = rows * w->width[c];
+        uint64_t stored;
+
+        if (w->hdr.flags & TF_FLAG_ZLIB) {
+            uLongf dst = w->out_cap - pos;
+            if (compress2(w->out + pos, &dst, w->data[c], raw, Z_BEST_SPEED) != Z_OK) {
+                fprintf(stderr, "tbin: compression failed\n");
+                return -1;
+            }
+            stored = dst;
+        } else {
+            memcpy(w->out + pos, w->data[c], raw);
+            stored = raw;
+        }
+        memcpy(w->out + 8 + 8 * c, &stored, sizeof(stored));
+        memset(w->out + pos + stored, 0, TF_ALIGN8(stored) - stored);
+        pos += TF_ALIGN8(stored);
+    }
+
+    if (tf_write_all(w->fd, w->out, pos) != 0) {
+        perror("tbin: write");
+        return -1;
+    }
+    w->hdr.nrows += rows;
+    w->hdr.nchunks++;
+    w->row = 0;
+    return 0;
+}
+
+// Create path with the given columns. names[i] and dtypes[i] describe
+// column i; dtypes use numpy notation ("|u1", "<u4", "<f8", ...).
+static inline tf_writer_t *tf_open(const char *path, const char *const *names,
+                                   const char *const *dtypes, int ncols,
+                                   uint32_t chunk_rows, uint32_t flags) {
+    if (ncols < 1 || ncols > TF_MAX_COLUMNS) return NULL;
+    if (chunk_rows == 0) chunk_rows = TF_DEFAULT_CHUNK_ROWS;
+
+    tf_writer_t *w = calloc(1, sizeof(*w));
+    if (!w) return NULL;
+
+    memcpy(w->hdr.magic, TF_MAGIC, 4);
+    w->hdr.version = TF_VERSION;
+    w->hdr.ncols = ncols;
+    w->hdr.flags = flags;
+    w->hdr.chunk_rows = chunk_rows;
+
+    w->out_cap = 8 + 8 * (size_t)ncols;
+    for (int c = 0; c < ncols; c++) {
+        strncpy(w->cols[c].name, names[c], sizeof(w->cols[c].name) - 1);
+        strncpy(w->cols[c].dtype, dtypes[c], sizeof(w->cols[c].dtype) - 1);
+        w->width[c] = tf_dtype_width(dtypes[c]);
+        w->data[c] = malloc(chunk_rows * w->width[c]);
+        if (w->width[c] == 0 || !w->data[c]) goto fail;
+        w->out_cap += TF_ALIGN8(compressBound(chunk_rows * w->width[c]));
+    }
+    w->out = malloc(w->out_cap);
+    if (!w->out) goto fail;
+
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) goto fail;
+
+    // Header and column table; the header is rewritten on close
+    size_t off = tf_data_offset(ncols);
+    uint8_t *head = calloc(1, off);
+    if (!head) goto fail_fd;
+    memcpy(head, &w->hdr, sizeof(w->hdr));
+    memcpy(head + sizeof(w->hdr), w->cols, ncols * sizeof(tf_column_t));
+    int rc = tf_write_all(w->fd, head, off);
+    free(head);
+    if (rc != 0) goto fail_fd;
+    return w;
+
+fail_fd:
+    close(w->fd);
+fail:
+    for (int c = 0; c < ncols; c++) free(w->data[c]);
+    free(w->out);
+    free(w);
+    return NULL;
+}
+
+// Set column values of the current row, then call tf_next_row()
+static inline void tf_set_u8(tf_writer_t *w, int col, uint8_t v) {
+    w->data[col][w->row] = v;
+}
+
+static inline void tf_set_u16(tf_writer_t *w, int col, uint16_t v) {
+    memcpy(w->data[col] + (size_t)w->row * 2, &v, 2);
+}
+
+static inline void tf_set_u32(tf_writer_t *w, int col, uint32_t v) {
+    memcpy(w->data[col] + (size_t)w->row * 4, &v, 4);
+}
+
+static inline void tf_set_f64(tf_writer_t *w, int col, double v) {
+    memcpy(w->data[col] + (size_t)w->row * 8, &v, 8);
+}
+
+static inline int tf_next_row(tf_writer_t *w) {
+    if (++w->row == w->hdr.chunk_rows) {
+        return tf_flush_chunk(w);
+    }
+    return 0;
+}
+
+// Flush the last chunk, patch row/chunk counts into the header and close
+static inline int tf_close(tf_writer_t *w) {
+    int rc = tf_flush_chunk(w);
+
+    if (pwrite(w->fd, &w->hdr, sizeof(w->hdr), 0) != (ssize_t)sizeof(w->hdr)) {
+        perror("tbin: header");
+        rc = -1;
+    }
+    if (close(w->fd) != 0) rc = -1;
+    for (int c = 0; c < w->hdr.ncols; c++) free(w->data[c]);
+    free(w->out);
+    free(w);
+    return rc;
+}
+
+// ============================================================================
+// Timing sample sink: CSV or .tbin behind one interface
+// ============================================================================
+
+// Both collectors emit (guess, plaintext byte, timing_us, is_correct) rows;
+// only the name of the first column differs
+typedef struct {
+    FILE *csv;
+    tf_writer_t *bin;
+} tf_sink_t;
+
+static inline int tf_sink_open(tf_sink_t *s, const char *path, const char *guess_col,
+                               const char *pt_col, int compress) {
+    s->csv = NULL;
+    s->bin = NULL;
+
+    if (tf_is_binary_path(path)) {
+        const char *names[] = { guess_col, pt_col, "timing_us", "is_correct" };
+        const char *dtypes[] = { "|u1", "|u1", "<f8", "|u1" };
+        s->bin = tf_open(path, names, dtypes, 4, TF_DEFAULT_CHUNK_ROWS,
+                         compress ? TF_FLAG_ZLIB : 0);
+        return s->bin ? 0 : -1;
+    }
+
+    s->csv = fopen(path, "w");
+    if (!s->csv) return -1;
+    setvbuf(s->csv, NULL, _IOFBF, 1 << 20);
+    fprintf(s->csv, "%s,%s,timing_us,is_correct\n", guess_col, pt_col);
+    return 0;
+}
+
+static inline int tf_sink_write(tf_sink_t *s, uint8_t guess, uint8_t pt, double timing_us,
+                                int is_correct) {
+    if (s->bin) {
+        tf_set_u8(s->bin, 0, guess);
+        tf_set_u8(s->bin, 1, pt);
+        tf_set_f64(s->bin, 2, timing_us);
+        tf_set_u8(s->bin, 3, (uint8_t)is_correct);
+        return tf_next_row(s->bin);
+    }
+    return fprintf(s->csv, "%d,%d,%.6f,%d\n", guess, pt, timing_us, is_correct) < 0 ? -1 : 0;
+}
+
+static inline int tf_sink_close(tf_sink_t *s) {
+    if (s->bin) return tf_close(s->bin);
+    return fclose(s->csv) == 0 ? 0 : -1;
+}
+
+// ============================================================================
+// Live sample stream (collect_timing_data -s | online_scorer.py)
+// ============================================================================
+
+// Fixed 16-byte record, host (little-endian) byte order; online_scorer.py
+// reads it as a numpy structured dtype
+typedef struct {
+    uint8_t guess;
+    uint8_t plaintext;
+    uint8_t is_correct;
+    uint8_t reserved[5];
+    double timing_us;
+} tf_stream_record_t;
+
+_Static_assert(sizeof(tf_stream_record_t) == 16, "tf_stream_record_t must be 16 bytes");
+
+#endif // TIMING_FORMAT_H
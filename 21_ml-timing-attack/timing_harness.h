@@ -0,0 +1,211 @@
+/*
+ * High-Resolution Timing Harness
+ * Cycle-accurate measurement of short operations for the timing collectors:
+ *   - serialized counter reads (lfence/rdtsc ... rdtscp/lfence on x86,
+ *     clock_gettime(CLOCK_MONOTONIC_RAW) elsewhere)
+ *   - calibrated overhead of an empty measurement, subtracted per sample
+ *   - counter frequency, to report samples in microseconds
+ *   - CPU pinning so the thread never migrates between counters
+ *   - stateless pseudo-random input blocks (splitmix64 of the sample index)
+ *
+ * Needs _GNU_SOURCE (sched_getcpu, CPU_SET) defined before any include.
+ */
+
+#ifndef TIMING_HARNESS_H
+#define TIMING_HARNESS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define TH_HAVE_TSC 1
+#else
+#define TH_HAVE_TSC 0
+#endif
+
+#define TH_CALIBRATION_ROUNDS 10000
+
+typedef struct {
+    int use_tsc;            // 1 = TSC cycles, 0 = CLOCK_MONOTONIC_RAW nanoseconds
+    double ticks_per_us;    // Counter frequency
+    uint64_t overhead;      // Ticks of an empty begin/end pair (subtracted)
+    int cpu;                // CPU the caller is pinned to, -1 if not pinned
+} timing_harness_t;
+
+static inline uint64_t th_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Start of a measured region: no earlier instruction may still be in
+// flight, and the timed code may not start before the counter is read
+static inline uint64_t th_begin(const timing_harness_t *th) {
+#if TH_HAVE_TSC
+    if (th->use_tsc) {
+        _mm_lfence();
+        uint64_t t = __rdtsc();
+        _mm_lfence();
+        return t;
+    }
+#endif
+    (void)th;
+    return th_clock_ns();
+}
+
+// End of a measured region: rdtscp waits for the timed code to retire,
+// the lfence keeps later code from leaking into the measurement
+static inline uint64_t th_end(const timing_harness_t *th) {
+#if TH_HAVE_TSC
+    if (th->use_tsc) {
+        unsigned int aux;
+        uint64_t t = __rdtscp(&aux);
+        _mm_lfence();
+        return t;
+    }
+#endif
+    (void)th;
+    return th_clock_ns();
+}
+
+// Elapsed ticks of [begin, end) minus the calibrated overhead, never negative
+static inline uint64_t th_elapsed(const timing_harness_t *th, uint64_t begin, uint64_t end) {
+    uint64_t d = end - begin;
+    return d > th->overhead ? d - th->overhead : 0;
+}
+
+static inline double th_ticks_to_us(const timing_harness_t *th, double ticks) {
+    return ticks / th->ticks_per_us;
+}
+
+// Invariant TSC: constant rate across P-states and deep C-states
+static inline int th_tsc_invariant(void) {
+#if TH_HAVE_TSC
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+        return 0;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx >> 8) & 1;
+#else
+    return 0;
+#endif
+}
+
+// Pin the calling thread to cpu (-1 = the CPU it is running on now)
+static inline int th_pin_cpu(int cpu) {
+    cpu_set_t set;
+
+    if (cpu < 0) {
+        cpu = sched_getcpu();
+        if (cpu < 0) return -1;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        return -1;
+    }
+    return cpu;
+}
+
+// CPUs to spread measurement threads over: the isolated CPUs if the kernel
+// has any (isolcpus=), otherwise the current affinity mask
+static inline int th_select_cpus(int *cpus, int max) {
+    int n = 0;
+    FILE *fp = fopen("/sys/devices/system/cpu/isolated", "r");
+
+    if (fp) {
+        char line[1024];
+        if (fgets(line, sizeof(line), fp)) {
+            char *tok = strtok(line, ",\n");
+            while (tok && n < max) {
+                int lo, hi;
+                if (sscanf(tok, "%d-%d", &lo, &hi) != 2) {
+                    hi = lo = atoi(tok);
+                }
+                for (int c = lo; c <= hi && n < max; c++) {
+                    cpus[n++] = c;
+                }
+                tok = strtok(NULL, ",\n");
+            }
+        }
+        fclose(fp);
+    }
+    if (n > 0) {
+        return n;
+    }
+
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE && n < max; c++) {
+            if (CPU_ISSET(c, &set)) cpus[n++] = c;
+        }
+    }
+    return n;
+}
+
+static inline uint64_t th_splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// 16-byte input block for sample number counter: two splitmix64 outputs of
+// the index, no shared generator state, so threads need not coordinate
+static inline void th_random_block(uint8_t *block, uint64_t counter) {
+    uint64_t lo = th_splitmix64(2 * counter);
+    uint64_t hi = th_splitmix64(2 * counter + 1);
+    memcpy(block, &lo, 8);
+    memcpy(block + 8, &hi, 8);
+}
+
+static inline int th_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Pick the counter, pin (pin_cpu >= -1; -2 = leave affinity alone), then
+// calibrate frequency and the overhead of an empty measurement (median of
+// TH_CALIBRATION_ROUNDS pairs). Returns 0 on success.
+static inline int th_init(timing_harness_t *th, int pin_cpu) {
+    th->cpu = pin_cpu >= -1 ? th_pin_cpu(pin_cpu) : -1;
+    th->use_tsc = TH_HAVE_TSC && th_tsc_invariant();
+    th->overhead = 0;
+
+    if (th->use_tsc) {
+        struct timespec pause = { 0, 50 * 1000 * 1000 };
+        uint64_t ns0 = th_clock_ns(), t0 = th_begin(th);
+        nanosleep(&pause, NULL);
+        uint64_t ns1 = th_clock_ns(), t1 = th_end(th);
+        th->ticks_per_us = (double)(t1 - t0) * 1000.0 / (double)(ns1 - ns0);
+    } else {
+        th->ticks_per_us = 1000.0;
+    }
+
+    uint64_t *samples = (uint64_t *)malloc(TH_CALIBRATION_ROUNDS * sizeof(uint64_t));
+    if (!samples) {
+        return -1;
+    }
+    for (int i = 0; i < TH_CALIBRATION_ROUNDS; i++) {
+        uint64_t b = th_begin(th);
+        uint64_t e = th_end(th);
+        samples[i] = e - b;
+    }
+    qsort(samples, TH_CALIBRATION_ROUNDS, sizeof(uint64_t), th_cmp_u64);
+    th->overhead = samples[TH_CALIBRATION_ROUNDS / 2];
+    free(samples);
+    return 0;
+}
+
+static inline const char *th_counter_name(const timing_harness_t *th) {
+    return th->use_tsc ? "TSC (rdtscp)" : "CLOCK_MONOTONIC_RAW";
+}
+
+#endif // TIMING_HARNESS_H
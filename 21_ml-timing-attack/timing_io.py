@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+timing_io.py
+
+Loaders for the timing data written by collect_timing_data and
+predict_unknown_key. Files ending in .tbin use the binary columnar format
+of timing_format.h; anything else is read as CSV.
+
+Uncompressed .tbin column blocks are mapped with np.memmap, so loading
+costs one page-cache copy per column instead of parsing text. Compressed
+files inflate each block with zlib.
+"""
+
+import os
+import struct
+import sys
+import zlib
+
+HEADER = struct.Struct('<4sHHIIQI36x')   # tf_header_t, 64 bytes
+COLUMN = struct.Struct('<24s8s')         # tf_column_t, 32 bytes
+MAGIC = b'TBIN'
+VERSION = 1
+FLAG_ZLIB = 0x1
+
+
+def is_binary_path(path):
+    return str(path).endswith('.tbin')
+
+
+def _align8(n):
+    return (n + 7) & ~7
+
+
+def read_layout(path):
+    """Parse the header and chunk table of a .tbin file.
+
+    Returns (header dict, [(name, dtype)], [(rows, [(offset, stored_size)])]).
+    """
+    file_size = os.path.getsize(path)
+    with open(path, 'rb') as f:
+        magic, version, ncols, flags, chunk_rows, nrows, nchunks = HEADER.unpack(f.read(HEADER.size))
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f"{path}: not a version {VERSION} .tbin file")
+
+        columns = []
+        for _ in range(ncols):
+            name, dtype = COLUMN.unpack(f.read(COLUMN.size))
+            columns.append((name.rstrip(b'\0').decode(), dtype.rstrip(b'\0').decode()))
+
+        pos = (HEADER.size + ncols * COLUMN.size + 63) & ~63
+        chunks = []
+        while pos < file_size:
+            f.seek(pos)
+            head = f.read(8 + 8 * ncols)
+            rows = struct.unpack_from('<I', head)[0]
+            sizes = struct.unpack_from(f'<{ncols}Q', head, 8)
+            pos += len(head)
+            blocks = []
+            for size in sizes:
+                blocks.append((pos, size))
+                pos += _align8(size)
+            chunks.append((rows, blocks))
+
+    header = {'ncols': ncols, 'flags': flags, 'chunk_rows': chunk_rows,
+              'nrows': nrows, 'nchunks': nchunks}
+    if sum(rows for rows, _ in chunks) != nrows:
+        raise ValueError(f"{path}: truncated file ({nrows} rows in header)")
+    return header, columns, chunks
+
+
+def iter_chunks(path, chunk_rows=1 << 20):
+    """Yield {column name: numpy array} chunks without loading the whole file.
+
+    .tbin files yield their stored chunks (memory-mapped when uncompressed);
+    CSV files are parsed chunk_rows lines at a time.
+    """
+    import numpy as np
+
+    if not is_binary_path(path):
+        import pandas as pd
+        for df in pd.read_csv(path, chunksize=chunk_rows):
+            yield {name: df[name].to_numpy() for name in df.columns}
+        return
+
+    header, columns, chunks = read_layout(path)
+    compressed = header['flags'] & FLAG_ZLIB
+    with open(path, 'rb') as f:
+        for rows, blocks in chunks:
+            out = {}
+            for (name, dtype), (offset, size) in zip(columns, blocks):
+                if compressed:
+                    f.seek(offset)
+                    out[name] = np.frombuffer(zlib.decompress(f.read(size)), dtype=dtype)
+                else:
+                    out[name] = np.memmap(path, dtype=dtype, mode='r', offset=offset, shape=(rows,))
+            yield out
+
+
+def load_columns(path):
+    """Load a .tbin file as {column name: numpy array}"""
+    import numpy as np
+
+    _, columns, _ = read_layout(path)
+    parts = {name: [] for name, _ in columns}
+    for chunk in iter_chunks(path):
+        for name in parts:
+            parts[name].append(chunk[name])
+
+    out = {}
+    for name, dtype in columns:
+        arrays = parts[name]
+        if len(arrays) == 1:
+            out[name] = arrays[0]
+        elif arrays:
+            out[name] = np.concatenate(arrays)
+        else:
+            out[name] = np.empty(0, dtype=dtype)
+    return out
+
+
+def load_timing_data(path):
+    """Load timing samples from CSV or .tbin into a pandas DataFrame"""
+    import pandas as pd
+
+    if is_binary_path(path):
+        return pd.DataFrame(load_columns(path))
+    return pd.read_csv(path)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("Usage: python3 timing_io.py <file.tbin>")
+        sys.exit(1)
+
+    header, columns, chunks = read_layout(sys.argv[1])
+    print(f"Rows: {header['nrows']:,} in {len(chunks)} chunks of up to {header['chunk_rows']:,}")
+    print(f"Compression: {'zlib' if header['flags'] & FLAG_ZLIB else 'none'}")
+    for i, (name, dtype) in enumerate(columns):
+        stored = sum(blocks[i][1] for _, blocks in chunks)
+        print(f"  {name:<16} {dtype:<5} {stored:>12,} bytes")
+
+
+if __name__ == '__main__':
+    main()